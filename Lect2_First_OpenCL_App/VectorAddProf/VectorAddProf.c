@@ -1,10 +1,13 @@
+#define _POSIX_C_SOURCE 200809L
 #include <CL/cl.h>
 
 #include <assert.h>
 #include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 
 
@@ -386,15 +389,684 @@ int Verify(float *a_host, float *b_host, float *c_host, int num_elem)
 	return 0;
 }
 
+/*
+ * \brief Wall clock time in us.
+ */
+double WallTime(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/*
+ * \brief Elapsed time in us from the start of e_start to the end of e_end.
+ */
+double EventSpan(cl_event e_start, cl_event e_end)
+{
+	cl_ulong t_start = 0;
+	cl_int status = clGetEventProfilingInfo(
+			e_start, 
+			CL_PROFILING_COMMAND_START, 
+			sizeof(cl_ulong), 
+			&t_start, 
+			NULL);
+	assert(status == CL_SUCCESS);
+	cl_ulong t_end = 0;
+	status = clGetEventProfilingInfo(
+			e_end, 
+			CL_PROFILING_COMMAND_END, 
+			sizeof(cl_ulong), 
+			&t_end, 
+			NULL);
+	assert(status == CL_SUCCESS);
+
+	return 1. * (t_end - t_start) / 1e3;
+}
+
+/*
+ * \brief Alignment, in elements, that a sub-buffer origin needs on both
+ * devices.
+ */
+size_t GetSubBufferAlign(cl_device_id dev_gpu, cl_device_id dev_cpu)
+{
+	cl_uint align_gpu = 0;
+	cl_int status = clGetDeviceInfo(
+			dev_gpu, 
+			CL_DEVICE_MEM_BASE_ADDR_ALIGN, 
+			sizeof(cl_uint), 
+			&align_gpu, 
+			NULL);
+	assert(status == CL_SUCCESS);
+	cl_uint align_cpu = 0;
+	status = clGetDeviceInfo(
+			dev_cpu, 
+			CL_DEVICE_MEM_BASE_ADDR_ALIGN, 
+			sizeof(cl_uint), 
+			&align_cpu, 
+			NULL);
+	assert(status == CL_SUCCESS);
+
+	// The alignment is given in bits
+	cl_uint align = align_gpu > align_cpu ? align_gpu : align_cpu;
+	size_t align_elem = align / 8 / sizeof(float);
+	return align_elem ? align_elem : 1;
+}
+
+/*
+ * \brief Create a sub-buffer of num_elem floats starting at element first.
+ */
+int CreateSubBuffer(cl_mem *sub, cl_mem parent, size_t first, size_t num_elem)
+{
+	cl_buffer_region region = {first * sizeof(float), 
+		num_elem * sizeof(float)};
+	cl_int status = 0;
+	*sub = clCreateSubBuffer(
+			parent, 
+			CL_MEM_READ_WRITE, 
+			CL_BUFFER_CREATE_TYPE_REGION, 
+			&region, 
+			&status);
+	assert(status == CL_SUCCESS);
+
+	assert(*sub);
+	return 0;
+}
+
+/*
+ * \brief One device's share of a cooperative vector add.
+ */
+typedef struct {
+	cl_command_queue cmd_q;
+	cl_kernel kernel;
+	size_t first;
+	size_t num_elem;
+	cl_mem a_sub;
+	cl_mem b_sub;
+	cl_mem c_sub;
+	cl_event e_kernel;
+	cl_event e_map;
+	void *c_map;
+} CoopPart;
+
+/*
+ * \brief Queue the kernel on the part's elements, then a map of its share
+ * of c, so the time to the end of the map covers whatever the device needs
+ * to make the result visible to the host.  Does not wait.
+ */
+int EnqueuePart(CoopPart *part, cl_mem a_dev, cl_mem b_dev, cl_mem c_dev)
+{
+	if (!part->num_elem)
+		return 0;
+
+	CreateSubBuffer(&part->a_sub, a_dev, part->first, part->num_elem);
+	CreateSubBuffer(&part->b_sub, b_dev, part->first, part->num_elem);
+	CreateSubBuffer(&part->c_sub, c_dev, part->first, part->num_elem);
+	SetKernelArg(part->kernel, part->c_sub, part->a_sub, part->b_sub, 
+			part->num_elem);
+
+	const size_t global_size[1] = {(part->num_elem + 255) / 256 * 256};
+	const size_t local_size[1] = {256};
+	cl_int status = clEnqueueNDRangeKernel(
+			part->cmd_q,
+			part->kernel,
+			1,
+			NULL,
+			global_size,
+			local_size,
+			0,
+			NULL,
+			&part->e_kernel);
+	assert(status == CL_SUCCESS);
+
+	part->c_map = clEnqueueMapBuffer(
+			part->cmd_q,
+			part->c_sub,
+			CL_FALSE,
+			CL_MAP_READ,
+			0,
+			part->num_elem * sizeof(float),
+			0,
+			NULL,
+			&part->e_map,
+			&status);
+	assert(status == CL_SUCCESS);
+
+	status = clFlush(part->cmd_q);
+	assert(status == CL_SUCCESS);
+
+	return 0;
+}
+
+/*
+ * \brief Wait for the part, unmap its result and release its sub-buffers.
+ * Returns the device time in us from kernel start to the end of the map.
+ */
+double FinishPart(CoopPart *part)
+{
+	if (!part->num_elem)
+		return 0;
+
+	cl_int status = clFinish(part->cmd_q);
+	assert(status == CL_SUCCESS);
+	double t = EventSpan(part->e_kernel, part->e_map);
+
+	status = clEnqueueUnmapMemObject(
+			part->cmd_q, 
+			part->c_sub, 
+			part->c_map, 
+			0, 
+			NULL, 
+			NULL);
+	assert(status == CL_SUCCESS);
+	status = clFinish(part->cmd_q);
+	assert(status == CL_SUCCESS);
+
+	clReleaseEvent(part->e_map);
+	clReleaseEvent(part->e_kernel);
+	clReleaseMemObject(part->c_sub);
+	clReleaseMemObject(part->b_sub);
+	clReleaseMemObject(part->a_sub);
+
+	return t;
+}
+
+/*
+ * \brief Add elements [0, split) on the GPU and [split, num_elem) on the
+ * CPU at the same time.  Returns the wall time in us, t_gpu and t_cpu
+ * receive each device's own time (0 if it had no elements).
+ */
+double RunSplit(CoopPart *gpu, CoopPart *cpu, cl_mem a_dev, cl_mem b_dev, 
+		cl_mem c_dev, size_t split, size_t num_elem, double *t_gpu, 
+		double *t_cpu)
+{
+	gpu->first = 0;
+	gpu->num_elem = split;
+	cpu->first = split;
+	cpu->num_elem = num_elem - split;
+
+	double start = WallTime();
+	EnqueuePart(gpu, a_dev, b_dev, c_dev);
+	EnqueuePart(cpu, a_dev, b_dev, c_dev);
+	*t_gpu = FinishPart(gpu);
+	*t_cpu = FinishPart(cpu);
+
+	return WallTime() - start;
+}
+
+/*
+ * \brief Split one vector add between the GPU and the CPU over num_run
+ * runs.  a, b and c live in host memory (CL_MEM_USE_HOST_PTR) and each
+ * device works on sub-buffers of them, so nothing is copied between the
+ * devices.  The split starts at half and each run moves it to where the
+ * throughput each device showed in the previous run would have made both
+ * finish together.
+ */
+int RunCooperative(cl_context ctx, cl_command_queue cq_gpu, 
+		cl_command_queue cq_cpu, cl_kernel kern_gpu, cl_kernel kern_cpu, 
+		cl_mem a_dev, cl_mem b_dev, float *a_host, float *b_host, 
+		size_t align, int num_elem, int num_run)
+{
+	float *c_host = (float *) calloc(num_elem, sizeof(float));
+	assert(c_host);
+	cl_int status = 0;
+	cl_mem c_dev = clCreateBuffer(
+			ctx, 
+			CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR,
+			num_elem * sizeof(float),
+			c_host, 
+			&status);
+	assert(status == CL_SUCCESS);
+
+	CoopPart gpu = {cq_gpu, kern_gpu};
+	CoopPart cpu = {cq_cpu, kern_cpu};
+	double t_gpu = 0, t_cpu = 0;
+
+	// Each device alone, once to warm up and once to time
+	RunSplit(&gpu, &cpu, a_dev, b_dev, c_dev, num_elem, num_elem, 
+			&t_gpu, &t_cpu);
+	double alone_gpu = RunSplit(&gpu, &cpu, a_dev, b_dev, c_dev, 
+			num_elem, num_elem, &t_gpu, &t_cpu);
+	RunSplit(&gpu, &cpu, a_dev, b_dev, c_dev, 0, num_elem, 
+			&t_gpu, &t_cpu);
+	double alone_cpu = RunSplit(&gpu, &cpu, a_dev, b_dev, c_dev, 
+			0, num_elem, &t_gpu, &t_cpu);
+
+	fprintf(stderr, "Cooperative (sub-buffer origins aligned to %zu elements)\n", 
+			align);
+	fprintf(stderr, "\tGPU alone: %8.2f us\n", alone_gpu);
+	fprintf(stderr, "\tCPU alone: %8.2f us\n", alone_cpu);
+
+	// Elements per us of each device, kept when a device gets no elements
+	double rate_gpu = 0, rate_cpu = 0;
+	double ratio = 0.5;
+	double best = 0;
+	for (int run = 0; run < num_run; ++run)
+	{
+		size_t split = (size_t)(ratio * num_elem / align + 0.5) * align;
+		if (split > (size_t)num_elem)
+			split = num_elem;
+
+		memset(c_host, 0, num_elem * sizeof(float));
+		double t = RunSplit(&gpu, &cpu, a_dev, b_dev, c_dev, split, 
+				num_elem, &t_gpu, &t_cpu);
+		fprintf(stderr, "\tRun %2d: GPU %5.1f%%  GPU %8.2f us  CPU %8.2f us"
+				"  total %8.2f us\n", run, 100. * split / num_elem, 
+				t_gpu, t_cpu, t);
+		if (!run || t < best)
+			best = t;
+
+		if (t_gpu > 0)
+			rate_gpu = split / t_gpu;
+		if (t_cpu > 0)
+			rate_cpu = (num_elem - split) / t_cpu;
+		if (rate_gpu + rate_cpu > 0)
+			ratio = rate_gpu / (rate_gpu + rate_cpu);
+	}
+
+	double alone = alone_gpu < alone_cpu ? alone_gpu : alone_cpu;
+	fprintf(stderr, "\tBest total: %8.2f us, %.2fx the faster device alone\n", 
+			best, alone / best);
+
+	// c_host holds the result of the last run
+	Verify(a_host, b_host, c_host, num_elem);
+
+	status = clReleaseMemObject(c_dev);
+	assert(status == CL_SUCCESS);
+	free(c_host);
+
+	return 0;
+}
+
+/*
+ * \brief Vector width for the grid-stride kernels on dev: 8 or 4 if the
+ * device prefers at least that many floats, else 1.
+ */
+int GetVectorWidth(cl_device_id dev)
+{
+	cl_uint width = 0;
+	cl_int status = clGetDeviceInfo(
+			dev, 
+			CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT, 
+			sizeof(cl_uint), 
+			&width, 
+			NULL);
+	assert(status == CL_SUCCESS);
+
+	return width >= 8 ? 8 : width >= 4 ? 4 : 1;
+}
+
+/*
+ * \brief Fixed global size for the grid-stride kernels: a few work-groups
+ * per compute unit, but no more work-items than vectors.
+ */
+size_t GetStrideGlobalSize(cl_device_id dev, size_t local_size, 
+		size_t num_vec)
+{
+	cl_uint num_cu = 0;
+	cl_int status = clGetDeviceInfo(
+			dev, 
+			CL_DEVICE_MAX_COMPUTE_UNITS, 
+			sizeof(cl_uint), 
+			&num_cu, 
+			NULL);
+	assert(status == CL_SUCCESS);
+
+	size_t global_size = num_cu * 8 * local_size;
+	size_t needed = (num_vec + local_size - 1) / local_size * local_size;
+	if (needed < global_size)
+		global_size = needed;
+	return global_size ? global_size : local_size;
+}
+
+/*
+ * \brief Launch kernel once on global_size work-items and wait.  Returns
+ * the kernel execution time in us.
+ */
+double RunKernelTimed(cl_command_queue cmd_q, cl_kernel kernel, 
+		size_t global_size, size_t local_size)
+{
+	cl_event e;
+	cl_int status = clEnqueueNDRangeKernel(
+			cmd_q,
+			kernel,
+			1,
+			NULL,
+			&global_size,
+			&local_size,
+			0,
+			NULL,
+			&e);
+	assert(status == CL_SUCCESS);
+
+	status = clFinish(cmd_q);
+	assert(status == CL_SUCCESS);
+
+	double t = EventSpan(e, e);
+	clReleaseEvent(e);
+	return t;
+}
+
+/*
+ * \brief Run the kernel name (grid-stride if stride, adding width floats per
+ * iteration) once to warm up and once timed, on a cleared output, and
+ * verify the result.  Returns the kernel execution time in us and the
+ * global size in *global_size.
+ */
+double RunVariant(const char *name, int width, bool stride, 
+		cl_device_id dev, cl_command_queue cmd_q, cl_program program, 
+		cl_mem a_dev, cl_mem b_dev, cl_mem c_dev, float *a_host, 
+		float *b_host, float *c_host, int num_elem, size_t *global_size)
+{
+	const size_t local_size = 256;
+	cl_int status = 0;
+	cl_kernel kernel = clCreateKernel(program, name, &status);
+	assert(status == CL_SUCCESS);
+	SetKernelArg(kernel, c_dev, a_dev, b_dev, num_elem);
+
+	*global_size = stride ? 
+		GetStrideGlobalSize(dev, local_size, num_elem / width) :
+		(num_elem + local_size - 1) / local_size * local_size;
+
+	// Clear the output so each variant is verified on its own result
+	const float zero = 0;
+	status = clEnqueueFillBuffer(cmd_q, c_dev, &zero, sizeof zero, 0, 
+			num_elem * sizeof(float), 0, NULL, NULL);
+	assert(status == CL_SUCCESS);
+
+	// The first launch warms up
+	RunKernelTimed(cmd_q, kernel, *global_size, local_size);
+	double t = RunKernelTimed(cmd_q, kernel, *global_size, local_size);
+
+	ReadFromGPU(cmd_q, c_dev, c_host, num_elem * sizeof(float));
+	Verify(a_host, b_host, c_host, num_elem);
+
+	status = clReleaseKernel(kernel);
+	assert(status == CL_SUCCESS);
+	return t;
+}
+
+/* The grid-stride kernel adding width floats per iteration */
+const char *StrideKernelName(int width)
+{
+	return width == 8 ? "VectorAddStride8" : 
+		width == 4 ? "VectorAddStride4" : "VectorAddStride";
+}
+
+/*
+ * \brief Run the grid-stride kernel of the width the device prefers, as
+ * GetVectorWidth picks it, and verify the result.
+ */
+int RunPreferred(const char *dev_name, cl_device_id dev, 
+		cl_command_queue cmd_q, cl_program program, cl_mem a_dev, 
+		cl_mem b_dev, cl_mem c_dev, float *a_host, float *b_host, 
+		float *c_host, int num_elem)
+{
+	int width = GetVectorWidth(dev);
+	size_t global_size;
+	double t = RunVariant(StrideKernelName(width), width, true, dev, 
+			cmd_q, program, a_dev, b_dev, c_dev, a_host, b_host, c_host, 
+			num_elem, &global_size);
+	fprintf(stderr, "%s: %s (vector width %d) global %zu  %8.2f us  %8.2f GB/s\n",
+			dev_name, StrideKernelName(width), width, global_size, t, 
+			3. * num_elem * sizeof(float) / t / 1e3);
+
+	return 0;
+}
+
+/*
+ * \brief Time the one-work-item-per-element kernel and each grid-stride
+ * variant on one device, and verify each result.  The variant the device's
+ * preferred vector width picks is marked.
+ */
+int RunVariants(const char *dev_name, cl_device_id dev, 
+		cl_command_queue cmd_q, cl_program program, cl_mem a_dev, 
+		cl_mem b_dev, cl_mem c_dev, float *a_host, float *b_host, 
+		float *c_host, int num_elem)
+{
+	const struct {
+		int width;
+		bool stride;
+	} variant[] = {
+		{1, false},
+		{1, true},
+		{4, true},
+		{8, true},
+	};
+	int width = GetVectorWidth(dev);
+
+	fprintf(stderr, "%s variants (vector width %d)\n", dev_name, width);
+	for (size_t v = 0; v < sizeof variant / sizeof variant[0]; ++v)
+	{
+		const char *name = variant[v].stride ? 
+			StrideKernelName(variant[v].width) : "VectorAddKernel";
+		size_t global_size;
+		double t = RunVariant(name, variant[v].width, variant[v].stride, 
+				dev, cmd_q, program, a_dev, b_dev, c_dev, a_host, b_host, 
+				c_host, num_elem, &global_size);
+		fprintf(stderr, "\t%c %-18s global %10zu  %8.2f us  %8.2f GB/s\n",
+				variant[v].stride && variant[v].width == width ? '*' : ' ',
+				name, global_size, t, 
+				3. * num_elem * sizeof(float) / t / 1e3);
+	}
+
+	return 0;
+}
+
+/*
+ * Where a, b and c live: plain device buffers filled by copies, buffers
+ * over the application's own arrays (CL_MEM_USE_HOST_PTR), or host memory
+ * the runtime allocates (CL_MEM_ALLOC_HOST_PTR).
+ */
+enum {
+	PLACE_COPY,
+	PLACE_USE_HOST,
+	PLACE_ALLOC_HOST,
+	NUM_PLACE
+};
+const char *place_name[NUM_PLACE] = {"device", "USE_HOST_PTR", 
+	"ALLOC_HOST_PTR"};
+
+/*
+ * \brief Create a buffer of size bytes with the given placement.  host is
+ * only used with PLACE_USE_HOST.
+ */
+int CreatePlacedBuffer(cl_mem *buf, cl_context ctx, int place, 
+		cl_mem_flags access, void *host, size_t size)
+{
+	cl_mem_flags flags = access;
+	if (place == PLACE_USE_HOST)
+		flags |= CL_MEM_USE_HOST_PTR;
+	else if (place == PLACE_ALLOC_HOST)
+		flags |= CL_MEM_ALLOC_HOST_PTR;
+
+	cl_int status = 0;
+	*buf = clCreateBuffer(
+			ctx, 
+			flags,
+			size,
+			place == PLACE_USE_HOST ? host : NULL, 
+			&status);
+	assert(status == CL_SUCCESS);
+
+	assert(*buf);
+	return 0;
+}
+
+/*
+ * \brief Bring size bytes at src into buf, by a blocking write or by
+ * mapping buf and copying into the mapping.  A mapping that already is src
+ * (USE_HOST_PTR with zero copy) needs no copy.
+ */
+int ToDevice(cl_command_queue cmd_q, cl_mem buf, const float *src, 
+		size_t size, bool map)
+{
+	cl_int status = 0;
+	if (!map)
+	{
+		status = clEnqueueWriteBuffer(
+				cmd_q,
+				buf,
+				CL_TRUE,
+				0,
+				size,
+				src,
+				0,
+				NULL,
+				NULL);
+		assert(status == CL_SUCCESS);
+		return 0;
+	}
+
+	void *p = clEnqueueMapBuffer(
+			cmd_q,
+			buf,
+			CL_TRUE,
+			CL_MAP_WRITE_INVALIDATE_REGION,
+			0,
+			size,
+			0,
+			NULL,
+			NULL,
+			&status);
+	assert(status == CL_SUCCESS);
+	if (p != src)
+		memcpy(p, src, size);
+	status = clEnqueueUnmapMemObject(cmd_q, buf, p, 0, NULL, NULL);
+	assert(status == CL_SUCCESS);
+
+	return 0;
+}
+
+/*
+ * \brief Bring size bytes of buf back to dst, by a blocking read or by
+ * mapping buf and copying out of the mapping.
+ */
+int FromDevice(cl_command_queue cmd_q, cl_mem buf, float *dst, size_t size, 
+		bool map)
+{
+	cl_int status = 0;
+	if (!map)
+	{
+		ReadFromGPU(cmd_q, buf, dst, size);
+		return 0;
+	}
+
+	void *p = clEnqueueMapBuffer(
+			cmd_q,
+			buf,
+			CL_TRUE,
+			CL_MAP_READ,
+			0,
+			size,
+			0,
+			NULL,
+			NULL,
+			&status);
+	assert(status == CL_SUCCESS);
+	if (p != dst)
+		memcpy(dst, p, size);
+	status = clEnqueueUnmapMemObject(cmd_q, buf, p, 0, NULL, NULL);
+	assert(status == CL_SUCCESS);
+	status = clFinish(cmd_q);
+	assert(status == CL_SUCCESS);
+
+	return 0;
+}
+
+/*
+ * \brief End-to-end vector add on one device for every placement, with
+ * read/write and with map/unmap access: inputs start and the result ends
+ * in the application's arrays.  Times are wall times in us of the second
+ * of two runs, buffer creation excluded.
+ */
+int RunPlacements(const char *dev_name, cl_context ctx, 
+		cl_command_queue cmd_q, cl_kernel kernel, const float *a_host, 
+		const float *b_host, int num_elem)
+{
+	// Page-aligned application arrays, so USE_HOST_PTR can be zero copy
+	size_t size = num_elem * sizeof(float);
+	size_t size_page = (size + 4095) / 4096 * 4096;
+	float *a_app = NULL;
+	float *b_app = NULL;
+	float *c_app = NULL;
+	int err = posix_memalign((void **)&a_app, 4096, size_page);
+	err |= posix_memalign((void **)&b_app, 4096, size_page);
+	err |= posix_memalign((void **)&c_app, 4096, size_page);
+	assert(!err);
+	memcpy(a_app, a_host, size);
+	memcpy(b_app, b_host, size);
+
+	const size_t local_size = 256;
+	const size_t global_size = (num_elem + local_size - 1) / local_size * 
+		local_size;
+
+	fprintf(stderr, "%s placement (us)\n", dev_name);
+	fprintf(stderr, "\t%-16s %-6s %10s %10s %10s %10s\n", "buffer", 
+			"access", "write", "kernel", "read", "total");
+	for (int place = 0; place < NUM_PLACE; ++place)
+		for (int map = 0; map < 2; ++map)
+		{
+			memset(c_app, 0, size);
+			cl_mem a_dev = NULL;
+			cl_mem b_dev = NULL;
+			cl_mem c_dev = NULL;
+			CreatePlacedBuffer(&a_dev, ctx, place, CL_MEM_READ_ONLY, a_app, 
+					size);
+			CreatePlacedBuffer(&b_dev, ctx, place, CL_MEM_READ_ONLY, b_app, 
+					size);
+			CreatePlacedBuffer(&c_dev, ctx, place, CL_MEM_WRITE_ONLY, c_app, 
+					size);
+			SetKernelArg(kernel, c_dev, a_dev, b_dev, num_elem);
+
+			double t_write = 0, t_kernel = 0, t_read = 0;
+			for (int run = 0; run < 2; ++run)
+			{
+				double start = WallTime();
+				ToDevice(cmd_q, a_dev, a_app, size, map);
+				ToDevice(cmd_q, b_dev, b_app, size, map);
+				double written = WallTime();
+				RunKernelTimed(cmd_q, kernel, global_size, local_size);
+				double computed = WallTime();
+				FromDevice(cmd_q, c_dev, c_app, size, map);
+				double done = WallTime();
+
+				t_write = written - start;
+				t_kernel = computed - written;
+				t_read = done - computed;
+			}
+			fprintf(stderr, "\t%-16s %-6s %10.2f %10.2f %10.2f %10.2f\n", 
+					place_name[place], map ? "map" : "rw", t_write, 
+					t_kernel, t_read, t_write + t_kernel + t_read);
+			Verify(a_app, b_app, c_app, num_elem);
+
+			clReleaseMemObject(c_dev);
+			clReleaseMemObject(b_dev);
+			clReleaseMemObject(a_dev);
+		}
+
+	free(c_app);
+	free(b_app);
+	free(a_app);
+	return 0;
+}
+
 
 int main(int argc, char *argv[])
 {
 	cl_int status;
 
 	// Allocate and initialize host buffers
-	assert(argc == 2);
+	// VectorAddProf <num_elem> [coop [num_run] | vec [all] | place]
+	assert(argc >= 2);
 	const int num_elem = atoi(argv[1]);
 	assert(num_elem > 0);
+	const bool coop = argc > 2 && !strcmp(argv[2], "coop");
+	const bool vec = argc > 2 && !strcmp(argv[2], "vec");
+	const bool place = argc > 2 && !strcmp(argv[2], "place");
+	const bool vec_all = vec && argc > 3 && !strcmp(argv[3], "all");
+	const int num_run = coop && argc > 3 ? atoi(argv[3]) : 8;
+	assert(num_run > 0);
 	float *a_host = (float *) calloc(num_elem, sizeof(float));
 	assert(a_host);
 	float *b_host = (float *) calloc(num_elem, sizeof(float));
@@ -494,6 +1166,36 @@ int main(int argc, char *argv[])
 	Verify(a_host, b_host, c_host_gpu, num_elem);
 	Verify(a_host, b_host, c_host_cpu, num_elem);
 
+	// Split the same vector add between both devices
+	if (coop)
+		RunCooperative(ctx, cq_gpu, cq_cpu, kern_gpu, kern_cpu, a_dev, 
+				b_dev, a_host, b_host, 
+				GetSubBufferAlign(dev_gpu, dev_cpu), num_elem, num_run);
+
+	// The grid-stride kernel of each device's preferred vector width, or
+	// with "all" every scalar and vector variant side by side
+	if (vec && !vec_all)
+	{
+		RunPreferred("GPU", dev_gpu, cq_gpu, prog_gpu, a_dev, b_dev, 
+				c_dev_gpu, a_host, b_host, c_host_gpu, num_elem);
+		RunPreferred("CPU", dev_cpu, cq_cpu, prog_cpu, a_dev, b_dev, 
+				c_dev_cpu, a_host, b_host, c_host_cpu, num_elem);
+	}
+	if (vec_all)
+	{
+		RunVariants("GPU", dev_gpu, cq_gpu, prog_gpu, a_dev, b_dev, 
+				c_dev_gpu, a_host, b_host, c_host_gpu, num_elem);
+		RunVariants("CPU", dev_cpu, cq_cpu, prog_cpu, a_dev, b_dev, 
+				c_dev_cpu, a_host, b_host, c_host_cpu, num_elem);
+	}
+
+	// End-to-end cost of each buffer placement on each device
+	if (place)
+	{
+		RunPlacements("GPU", ctx, cq_gpu, kern_gpu, a_host, b_host, num_elem);
+		RunPlacements("CPU", ctx, cq_cpu, kern_cpu, a_host, b_host, num_elem);
+	}
+
 	////////////////////////////////////////////////////////////////////
 	// STEP 10  Clean up the OpenCL resources
 	////////////////////////////////////////////////////////////////////
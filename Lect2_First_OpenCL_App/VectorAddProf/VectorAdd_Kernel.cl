@@ -9,3 +9,48 @@ __kernel void VectorAddKernel(__global float *c,
 		c[wid] = a[wid] + b[wid];
 }
 
+
+/*
+ * Grid-stride variants: a fixed number of work-items loops over the
+ * vector, so the launch size does not grow with n.  The vector variants
+ * add width elements per iteration and the first n % width work-items add
+ * the scalar tail.
+ */
+__kernel void VectorAddStride(__global float *c,
+		__global const float *a,
+		__global const float *b,
+		const unsigned int n)
+{
+	for (size_t i = get_global_id(0); i < n; i += get_global_size(0))
+		c[i] = a[i] + b[i];
+}
+
+__kernel void VectorAddStride4(__global float4 *c,
+		__global const float4 *a,
+		__global const float4 *b,
+		const unsigned int n)
+{
+	size_t num_vec = n / 4;
+	for (size_t i = get_global_id(0); i < num_vec; i += get_global_size(0))
+		c[i] = a[i] + b[i];
+
+	size_t t = num_vec * 4 + get_global_id(0);
+	if (t < n)
+		((__global float *)c)[t] = ((__global const float *)a)[t] +
+			((__global const float *)b)[t];
+}
+
+__kernel void VectorAddStride8(__global float8 *c,
+		__global const float8 *a,
+		__global const float8 *b,
+		const unsigned int n)
+{
+	size_t num_vec = n / 8;
+	for (size_t i = get_global_id(0); i < num_vec; i += get_global_size(0))
+		c[i] = a[i] + b[i];
+
+	size_t t = num_vec * 8 + get_global_id(0);
+	if (t < n)
+		((__global float *)c)[t] = ((__global const float *)a)[t] +
+			((__global const float *)b)[t];
+}
@@ -0,0 +1,77 @@
+/*
+ * Batched complex FFT, Stockham auto-sort formulation
+ * A length N = 2^m transform is a sequence of radix-4 passes followed by at
+ * most one radix-2 pass.  Pass p reads src and writes dst (ping-pong on the
+ * host) with Ns = product of the radices of the earlier passes.
+ * dim 0 is the butterfly (N/R of them), dim 1 is the transform in the batch.
+ * dir = -1 is the forward transform, +1 the inverse (unscaled).
+ */
+
+float2 cmul( float2 a, float2 b )
+{
+    return (float2)( a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x );
+}
+
+float2 twiddle( float2 v, float angle )
+{
+    float c;
+    float s = sincos( angle, &c );
+    return cmul( v, (float2)( c, s ) );
+}
+
+__kernel void fft_radix2( __global const float2 * src,
+                          __global float2 * dst,
+                          uint N,
+                          uint Ns,
+                          int dir ){
+
+    uint j = get_global_id(0);
+    uint batch = get_global_id(1) * N;
+
+    if( j >= N / 2 )
+        return;
+
+    uint k = j % Ns;
+    float angle = dir * 2.0f * M_PI_F * k / ( Ns * 2 );
+
+    float2 v0 = src[batch + j];
+    float2 v1 = twiddle( src[batch + j + N / 2], angle );
+
+    uint d = ( j / Ns ) * Ns * 2 + k;
+    dst[batch + d] = v0 + v1;
+    dst[batch + d + Ns] = v0 - v1;
+}
+
+__kernel void fft_radix4( __global const float2 * src,
+                          __global float2 * dst,
+                          uint N,
+                          uint Ns,
+                          int dir ){
+
+    uint j = get_global_id(0);
+    uint batch = get_global_id(1) * N;
+
+    if( j >= N / 4 )
+        return;
+
+    uint k = j % Ns;
+    float angle = dir * 2.0f * M_PI_F * k / ( Ns * 4 );
+
+    float2 v0 = src[batch + j];
+    float2 v1 = twiddle( src[batch + j + N / 4], angle );
+    float2 v2 = twiddle( src[batch + j + N / 2], 2.0f * angle );
+    float2 v3 = twiddle( src[batch + j + 3 * N / 4], 3.0f * angle );
+
+    float2 a0 = v0 + v2;
+    float2 a1 = v0 - v2;
+    float2 a2 = v1 + v3;
+    float2 a3 = v1 - v3;
+    /* multiply by -i (forward) or +i (inverse) */
+    a3 = dir < 0 ? (float2)( a3.y, -a3.x ) : (float2)( -a3.y, a3.x );
+
+    uint d = ( j / Ns ) * Ns * 4 + k;
+    dst[batch + d] = a0 + a2;
+    dst[batch + d + Ns] = a1 + a3;
+    dst[batch + d + 2 * Ns] = a0 - a2;
+    dst[batch + d + 3 * Ns] = a1 - a3;
+}
@@ -1,3 +1,4 @@
+#define _POSIX_C_SOURCE 200809L
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
@@ -5,19 +6,8 @@
 #include <CL/cl.h>
 #include <math.h>
 #include <stdbool.h>
-#define CHECK_STATUS( status, message )   \
-		if(status != CL_SUCCESS) \
-		{ \
-			printf( message); \
-			printf( "\n" ); \
-			return 1; \
-		}
-
-
-
+#include "FIR.h"
 
-/** Define custom constants*/
-#define MAX_SOURCE_SIZE (0x100000)
 
 cl_uint numTap = 0;
 cl_uint numData = 0;		
@@ -30,8 +20,6 @@ cl_float* historyInput = NULL;
 cl_event event;
 
 
-float* cpu_compute(float *input, float* coeff, unsigned int numTap, unsigned int numData);
-
 int main(int argc , char** argv) {
 
 	/** Define Custom Variables */
@@ -40,7 +28,36 @@ int main(int argc , char** argv) {
 
 	if (argc < 3)
 	{
-		printf(" Usage : ./FIR <numTaps> <numData>\n");
+		printf(" Usage : ./FIR <numTaps> <numData> [mode]\n");
+		printf("   direct                  single block, single filter (default)\n");
+		printf("   bank <numChannels> [numBlocks]\n");
+		printf("                           filter bank, one launch per block\n");
+		printf("   local                   window in local memory, taps in constant memory\n");
+		printf("   blocked [4|8|16]        outputs per work-item, sliding register window\n");
+		printf("   fft [numBlocks]         overlap-save FFT convolution\n");
+		printf("   symmetric               linear-phase taps, mirrored samples pre-added\n");
+		printf("   auto [symmetric]        direct or FFT, whichever measures faster\n");
+		printf("   resample <up> <down> [numBlocks]\n");
+		printf("                           polyphase resampling by up/down\n");
+		printf("   complex [real|complex] [interleaved|split] [numBlocks]\n");
+		printf("                           IQ samples with real or complex taps\n");
+		printf("   boxcar [numBlocks]      moving average over numTaps samples from prefix sums\n");
+		printf("   stft [frame] [hop] [numBlocks]\n");
+		printf("                           filter, then power spectra of Hann frames on the device\n");
+		printf("   packed [half|int16] [numBlocks]\n");
+		printf("                           upload 2-byte samples, error vs the float path\n");
+		printf("   fixed [q15|q15x64|q31] [numBlocks]\n");
+		printf("                           Q15 samples and taps, saturating, bit-exact check\n");
+		printf("   cpu [numThreads] [numBlocks]\n");
+		printf("                           SIMD multithreaded CPU filter, no OpenCL device\n");
+		printf("   mkfile <file> [numBlocks] [numChannels] [rate]\n");
+		printf("                           write numBlocks*numData frames of noise\n");
+		printf("   file <in> <out>         filter a binary sample file through mmap\n");
+		printf("   ring [numBlocks] [Msamples/s] [wait|drop] [device|cpu]\n");
+		printf("                           live ingestion through a lock-free ring\n");
+		printf("   multi                   split numData samples over every OpenCL device\n");
+		printf("   latency [numBlocks]     small blocks back to back, p50/p90/p99/max\n");
+		printf("   bench                   time every kernel for 8 .. numTaps taps\n");
 		exit(0);
 	}
 	if (argc > 1)
@@ -49,6 +66,133 @@ int main(int argc , char** argv) {
 		numData = atoi(argv[2]);
 	}
 
+	if (argc > 3 && !strcmp(argv[3], "cpu"))
+	{
+		int numThread = argc > 4 ? atoi(argv[4]) : 0;
+		cl_uint blocks = argc > 5 ? atoi(argv[5]) : 4;
+		return RunFIRCpu(numTap, numData, blocks, numThread);
+	}
+
+	if (argc > 4 && !strcmp(argv[3], "mkfile"))
+	{
+		cl_uint blocks = argc > 5 ? atoi(argv[5]) : 4;
+		cl_uint numChannel = argc > 6 ? atoi(argv[6]) : 1;
+		cl_uint rate = argc > 7 ? atoi(argv[7]) : 48000;
+		return FIRFileGenerate(argv[4], (cl_ulong)numData * blocks, numChannel, rate);
+	}
+
+	if (argc > 3 && !strcmp(argv[3], "multi"))
+		return RunFIRMulti(numTap, numData);
+
+	if (argc > 3 && !strcmp(argv[3], "ring"))
+	{
+		cl_uint blocks = argc > 4 ? atoi(argv[4]) : 64;
+		double rate = argc > 5 ? atof(argv[5]) : 0;
+		int drop = argc > 6 && !strcmp(argv[6], "drop");
+		int useCpu = argc > 7 && !strcmp(argv[7], "cpu");
+		FIRDevice dev;
+		if (!useCpu && FIRDeviceInit(&dev, NULL))
+			return 1;
+		int ret = RunFIRRing(useCpu ? NULL : &dev, numTap, numData, blocks, rate, drop);
+		if (!useCpu)
+			FIRDeviceRelease(&dev);
+		return ret;
+	}
+
+	if (argc > 3 && strcmp(argv[3], "direct"))
+	{
+		FIRDevice dev;
+		if (FIRDeviceInit(&dev, NULL))
+			return 1;
+
+		int ret = 1;
+		if (!strcmp(argv[3], "bank"))
+		{
+			cl_uint numChannel = argc > 4 ? atoi(argv[4]) : 16;
+			cl_uint blocks = argc > 5 ? atoi(argv[5]) : 4;
+			ret = RunFIRBank(&dev, numTap, numData, blocks, numChannel);
+		}
+		else if (!strcmp(argv[3], "local"))
+			ret = RunFIRVariant(&dev, FIR_VARIANT_LOCAL, numTap, numData, 0);
+		else if (!strcmp(argv[3], "blocked"))
+		{
+			int numOut = argc > 4 ? atoi(argv[4]) : 8;
+			FIRVariant variant = numOut <= 4 ? FIR_VARIANT_BLOCKED4 :
+				numOut <= 8 ? FIR_VARIANT_BLOCKED8 : FIR_VARIANT_BLOCKED16;
+			ret = RunFIRVariant(&dev, variant, numTap, numData, 0);
+		}
+		else if (!strcmp(argv[3], "symmetric"))
+			ret = RunFIRVariant(&dev, FIR_VARIANT_SYMMETRIC, numTap, numData, 1);
+		else if (!strcmp(argv[3], "fft"))
+		{
+			cl_uint blocks = argc > 4 ? atoi(argv[4]) : 4;
+			ret = RunFIRFFT(&dev, numTap, numData, blocks);
+		}
+		else if (!strcmp(argv[3], "auto"))
+		{
+			int symmetric = argc > 4 && !strcmp(argv[4], "symmetric");
+			ret = RunFIRVariant(&dev, FIR_VARIANT_AUTO, numTap, numData, symmetric);
+		}
+		else if (!strcmp(argv[3], "resample"))
+		{
+			cl_uint up = argc > 4 ? atoi(argv[4]) : 1;
+			cl_uint down = argc > 5 ? atoi(argv[5]) : 1;
+			cl_uint blocks = argc > 6 ? atoi(argv[6]) : 4;
+			ret = RunFIRResample(&dev, numTap, numData, blocks, up, down);
+		}
+		else if (!strcmp(argv[3], "complex"))
+		{
+			int complexTap = !(argc > 4 && !strcmp(argv[4], "real"));
+			FIRIQLayout layout = argc > 5 && !strcmp(argv[5], "split") ?
+				FIR_IQ_SPLIT : FIR_IQ_INTERLEAVED;
+			cl_uint blocks = argc > 6 ? atoi(argv[6]) : 4;
+			ret = RunFIRComplex(&dev, numTap, numData, blocks, layout, complexTap);
+		}
+		else if (!strcmp(argv[3], "boxcar"))
+		{
+			cl_uint blocks = argc > 4 ? atoi(argv[4]) : 4;
+			ret = RunFIRBoxcar(&dev, numTap, numData, blocks);
+		}
+		else if (!strcmp(argv[3], "stft"))
+		{
+			cl_uint N = argc > 4 ? atoi(argv[4]) : 256;
+			cl_uint hop = argc > 5 ? atoi(argv[5]) : N / 2;
+			cl_uint blocks = argc > 6 ? atoi(argv[6]) : 4;
+			ret = RunFIRStft(&dev, numTap, numData, blocks, N, hop);
+		}
+		else if (!strcmp(argv[3], "packed"))
+		{
+			FIRPackFormat format = argc > 4 && !strcmp(argv[4], "int16") ?
+				FIR_PACK_INT16 : FIR_PACK_HALF;
+			cl_uint blocks = argc > 5 ? atoi(argv[5]) : 4;
+			ret = RunFIRPacked(&dev, numTap, numData, blocks, format);
+		}
+		else if (!strcmp(argv[3], "fixed"))
+		{
+			FIRQFormat format = FIR_Q15_SAT32;
+			if (argc > 4 && !strcmp(argv[4], "q15x64"))
+				format = FIR_Q15_ACC64;
+			else if (argc > 4 && !strcmp(argv[4], "q31"))
+				format = FIR_Q31_ACC64;
+			cl_uint blocks = argc > 5 ? atoi(argv[5]) : 4;
+			ret = RunFIRFixed(&dev, numTap, numData, blocks, format);
+		}
+		else if (!strcmp(argv[3], "file") && argc > 5)
+			ret = RunFIRFile(&dev, numTap, numData, argv[4], argv[5]);
+		else if (!strcmp(argv[3], "latency"))
+		{
+			cl_uint blocks = argc > 4 ? atoi(argv[4]) : 1000;
+			ret = RunFIRLatency(&dev, numTap, numData, blocks);
+		}
+		else if (!strcmp(argv[3], "bench"))
+			ret = RunFIRBench(&dev, numTap, numData);
+		else
+			printf("Unknown mode %s\n", argv[3]);
+
+		FIRDeviceRelease(&dev);
+		return ret;
+	}
+
 
 	/** Declare the Filter Properties */
 	numBlocks = 1; // Reserved for advanced FIR
@@ -76,11 +220,12 @@ int main(int argc , char** argv) {
 		historyInput[i] = 0.0f;
 	}
 	
-	// Perform serial CPU computation
+	// CPU reference: SIMD and threaded, rounded in scalar order
 	float *cpu_out = cpu_compute(input, coeff, numTap, numData);
 
 	
 	/** Input read from data file, for streaming application
+	 *  (the file mode streams binary sample files through mmap, FIRFile.c)
 	 *
 	// Read the input file
 	FILE *fip;
@@ -95,51 +240,14 @@ int main(int argc , char** argv) {
 	*
 	**/
 
-	// Load the kernel source code into the array source_str
-	FILE *fp;
-	char *source_str;
-	size_t source_size;
-
-	fp = fopen("FIR.cl", "r");
-	if (!fp) {
-		fprintf(stderr, "Failed to load kernel.\n");
-		exit(1);
-	}
-	source_str = (char*)malloc(MAX_SOURCE_SIZE);
-	source_size = fread( source_str, 1, MAX_SOURCE_SIZE, fp);
-	fclose( fp );
-
-	// Get platform and device information
-	cl_platform_id platform_id = NULL;
-	cl_device_id device_id = NULL;
-	cl_uint ret_num_devices;
-	cl_uint ret_num_platforms;
-	cl_int ret = clGetPlatformIDs(1, &platform_id, &ret_num_platforms);
-	ret = clGetDeviceIDs( platform_id, CL_DEVICE_TYPE_ALL, 1,
-			&device_id, &ret_num_devices);
-
-	printf("/n No of Devices %d",ret_num_platforms );
-
-	char *platformVendor;
-	size_t platInfoSize;
-	clGetPlatformInfo(platform_id, CL_PLATFORM_VENDOR, 0, NULL,
-			&platInfoSize);
-
-	platformVendor = (char*)malloc(platInfoSize);
-
-	clGetPlatformInfo(platform_id, CL_PLATFORM_VENDOR, platInfoSize,
-			platformVendor, NULL);
-	printf("\tVendor: %s\n", platformVendor);
-	free(platformVendor);
-
-
-	// Create an OpenCL context
-	cl_context context = clCreateContext( NULL, 1, &device_id, NULL, NULL, &ret);
-	CHECK_STATUS( ret,"Error: Create Context\n");
-
-	// Create a command queue
-	cl_command_queue command_queue = clCreateCommandQueue(context, device_id, CL_QUEUE_PROFILING_ENABLE, &ret);
-	CHECK_STATUS( ret,"Error: Create Command Queue\n");
+	// Get the device, create the context and queue, build FIR.cl
+	FIRDevice dev;
+	if (FIRDeviceInit(&dev, NULL))
+		return 1;
+	cl_context context = dev.context;
+	cl_command_queue command_queue = dev.queue;
+	cl_program program = dev.program;
+	cl_int ret;
 
 
 	// Create memory buffers on the device for each vector
@@ -153,50 +261,6 @@ int main(int argc , char** argv) {
 			sizeof(cl_float) * (numData+numTap-1), NULL, &ret);
 	CHECK_STATUS( ret,"Error: Create temp out buffer Buffer\n");
 
-	// Create a program from the kernel source
-	cl_program program = clCreateProgramWithSource(context, 1,
-			(const char **)&source_str, (const size_t *)&source_size, &ret);
-
-	// Build the program
-	ret = clBuildProgram(program, 1, &device_id, NULL, NULL, NULL);
-	if(ret != CL_SUCCESS)
-	{
-		cl_build_status build_status;
-		clGetProgramBuildInfo(program, 
-				              device_id, 
-							  CL_PROGRAM_BUILD_STATUS, 
-							  sizeof(cl_build_status), 
-							  &build_status, 
-							  NULL);
-
-		if(build_status == CL_SUCCESS) 
-		{
-			printf("No compilation errors for this device\n");
-		}
-
-		size_t ret_val_size;
-		clGetProgramBuildInfo(program, 
-				              device_id, 
-							  CL_PROGRAM_BUILD_LOG, 
-							  0, 
-							  NULL, 
-							  &ret_val_size);
-
-		char* build_log = NULL;
-		build_log = (char *)malloc(ret_val_size+1);
-		if(build_log == NULL)
-		{
-			perror("malloc");
-			exit(1);
-		}
-
-		clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, ret_val_size+1, build_log, NULL);
-		build_log[ret_val_size] = '\0';
-
-		printf("Build log:\n %s...\n", build_log);
-	}
-	CHECK_STATUS( ret,"Error: Build Program\n");
-
 	// Create the OpenCL kernel
 	cl_kernel kernel = clCreateKernel(program, "FIR", &ret);
 	CHECK_STATUS( ret,"Error: Create kernel. (clCreateKernel)\n");
@@ -326,12 +390,10 @@ int main(int argc , char** argv) {
 	ret= clFlush(command_queue);
 	ret = clFinish(command_queue);
 	ret = clReleaseKernel(kernel);
-	ret = clReleaseProgram(program);
 	ret = clReleaseMemObject(outputBuffer);
 	ret = clReleaseMemObject(coeffBuffer);
 	ret = clReleaseMemObject(tempInputBuffer);
-	ret = clReleaseCommandQueue(command_queue);
-	ret = clReleaseContext(context);
+	FIRDeviceRelease(&dev);
 
 	free(input);
 	free(output);
@@ -344,22 +406,237 @@ int main(int argc , char** argv) {
 }
 
 
+/*
+ * \brief Create the context and queue for device_id and build FIR.cl for it.
+ * A NULL device_id selects the first device of the first platform.
+ */
+int FIRDeviceInit(FIRDevice *dev, cl_device_id device_id)
+{
+	// Load the kernel source code of every file into source_str
+	const char *source_file[] = {"FIR.cl", "FFT.cl"};
+	const int num_source = sizeof(source_file) / sizeof(source_file[0]);
+	char *source_str[2];
+	size_t source_size[2];
+	int f;
+
+	for (f = 0; f < num_source; f++)
+	{
+		FILE *fp = fopen(source_file[f], "r");
+		if (!fp) {
+			fprintf(stderr, "Failed to load kernel %s.\n", source_file[f]);
+			exit(1);
+		}
+		source_str[f] = (char*)malloc(MAX_SOURCE_SIZE);
+		source_size[f] = fread( source_str[f], 1, MAX_SOURCE_SIZE, fp);
+		fclose( fp );
+	}
+
+	// Get platform and device information
+	cl_int ret;
+	if (device_id == NULL)
+	{
+		cl_platform_id platform_id = NULL;
+		cl_uint ret_num_devices;
+		cl_uint ret_num_platforms;
+		ret = clGetPlatformIDs(1, &platform_id, &ret_num_platforms);
+		CHECK_STATUS( ret,"Error: Get Platform IDs\n");
+		ret = clGetDeviceIDs( platform_id, CL_DEVICE_TYPE_ALL, 1,
+				&device_id, &ret_num_devices);
+		CHECK_STATUS( ret,"Error: Get Device IDs\n");
+
+		printf("/n No of Devices %d",ret_num_platforms );
+
+		char *platformVendor;
+		size_t platInfoSize;
+		clGetPlatformInfo(platform_id, CL_PLATFORM_VENDOR, 0, NULL,
+				&platInfoSize);
+
+		platformVendor = (char*)malloc(platInfoSize);
+
+		clGetPlatformInfo(platform_id, CL_PLATFORM_VENDOR, platInfoSize,
+				platformVendor, NULL);
+		printf("\tVendor: %s\n", platformVendor);
+		free(platformVendor);
+	}
+	dev->device = device_id;
+
+	// Create an OpenCL context
+	dev->context = clCreateContext( NULL, 1, &device_id, NULL, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create Context\n");
+
+	// Create a command queue
+	dev->queue = clCreateCommandQueue(dev->context, device_id, CL_QUEUE_PROFILING_ENABLE, &ret);
+	CHECK_STATUS( ret,"Error: Create Command Queue\n");
+
+	// Create a program from the kernel source
+	dev->program = clCreateProgramWithSource(dev->context, num_source,
+			(const char **)source_str, (const size_t *)source_size, &ret);
+	for (f = 0; f < num_source; f++)
+		free(source_str[f]);
+	CHECK_STATUS( ret,"Error: Create Program\n");
+
+	// Build the program
+	ret = clBuildProgram(dev->program, 1, &device_id, NULL, NULL, NULL);
+	if(ret != CL_SUCCESS)
+	{
+		cl_build_status build_status;
+		clGetProgramBuildInfo(dev->program, 
+				              device_id, 
+							  CL_PROGRAM_BUILD_STATUS, 
+							  sizeof(cl_build_status), 
+							  &build_status, 
+							  NULL);
+
+		if(build_status == CL_SUCCESS) 
+		{
+			printf("No compilation errors for this device\n");
+		}
+
+		size_t ret_val_size;
+		clGetProgramBuildInfo(dev->program, 
+				              device_id, 
+							  CL_PROGRAM_BUILD_LOG, 
+							  0, 
+							  NULL, 
+							  &ret_val_size);
+
+		char* build_log = NULL;
+		build_log = (char *)malloc(ret_val_size+1);
+		if(build_log == NULL)
+		{
+			perror("malloc");
+			exit(1);
+		}
+
+		clGetProgramBuildInfo(dev->program, device_id, CL_PROGRAM_BUILD_LOG, ret_val_size+1, build_log, NULL);
+		build_log[ret_val_size] = '\0';
+
+		printf("Build log:\n %s...\n", build_log);
+		free(build_log);
+	}
+	CHECK_STATUS( ret,"Error: Build Program\n");
+
+	return 0;
+}
+
+void FIRDeviceRelease(FIRDevice *dev)
+{
+	clFlush(dev->queue);
+	clFinish(dev->queue);
+	clReleaseProgram(dev->program);
+	clReleaseCommandQueue(dev->queue);
+	clReleaseContext(dev->context);
+}
+
+double FIREventTime(cl_event event)
+{
+	cl_ulong t_start = 0;
+	cl_ulong t_end = 0;
+
+	clWaitForEvents(1, &event);
+	clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START,
+			sizeof(cl_ulong), &t_start, NULL);
+	clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END,
+			sizeof(cl_ulong), &t_end, NULL);
+
+	return (t_end - t_start) / 1e3;
+}
+
+double WallTime(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/*
+ * \brief Return 0 if every output is within tol of the reference, relative
+ * to the largest reference magnitude.
+ */
+int FIRVerify(const float *ref, const float *out, size_t n, float tol)
+{
+	size_t i;
+	float scale = 0.f;
+
+	for (i = 0; i < n; i++)
+		if (fabsf(ref[i]) > scale)
+			scale = fabsf(ref[i]);
+	if (scale == 0.f)
+		scale = 1.f;
+
+	for (i = 0; i < n; i++)
+	{
+		if (!(fabsf(out[i] - ref[i]) <= tol * scale))
+		{
+			printf("Mismatch at %zu: %f (expected %f)\n", i, out[i], ref[i]);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+
+/*
+ * \brief CPU reference FIR over one block with zero history, on the
+ * SIMD and threaded FIRCpu backend, which rounds in the same order as a
+ * scalar loop.  Starts and stops a worker pool, so callers checking many
+ * blocks should keep one FIRCpu and use cpu_compute_with.
+ */
 float* cpu_compute(float *input, float* coeff, unsigned int numTap, unsigned int numData)
 {
-	float *out_cpu, *temp_in;
+	FIRCpu fc;
+	if (FIRCpuCreate(&fc, numTap, coeff, 0, FIRCpuDetect()))
+		exit(1);
+	float *out_cpu = cpu_compute_with(&fc, coeff, input, numData);
+	FIRCpuRelease(&fc);
+
+	return out_cpu;
+}
+
+/*
+ * \brief cpu_compute on an existing FIRCpu of the same numTap: loads
+ * coeff, clears the history and filters the block.
+ */
+float* cpu_compute_with(FIRCpu *fc, const float *coeff, const float *input,
+		unsigned int numData)
+{
+	float *out_cpu;
 	out_cpu = (float*) malloc (numData * sizeof(float));
-	temp_in = (float*) calloc ((numData + numTap - 1) , sizeof(float));
-	
-	memcpy((temp_in + numTap - 1) , input, sizeof(float) * numData);
-	float sum;
+
+	FIRCpuSetCoeff(fc, coeff);
+	FIRCpuProcess(fc, input, out_cpu, numData);
+
+	return out_cpu;
+}
+
+/*
+ * \brief Serial complex FIR: input and output are numData interleaved
+ * (I, Q) pairs, coeff is numTap real taps or numTap (re, im) pairs.
+ */
+float* cpu_compute_complex(float *input, float* coeff, unsigned int numTap,
+		unsigned int numData, int complexTap)
+{
+	float *out_cpu, *temp_in;
+	out_cpu = (float*) malloc (2 * numData * sizeof(float));
+	temp_in = (float*) calloc (2 * (numData + numTap - 1) , sizeof(float));
+
+	memcpy((temp_in + 2 * (numTap - 1)) , input, sizeof(float) * 2 * numData);
 	for(int i = 0; i < numData; i++)
 	{
-		sum = 0.f;
+		float re = 0.f, im = 0.f;
 		for(int j = 0; j < numTap; j++)
-			sum += coeff[j] * temp_in[i + j];
-		out_cpu[i] = sum;
+		{
+			float xr = temp_in[2 * (i + j)];
+			float xi = temp_in[2 * (i + j) + 1];
+			float cr = complexTap ? coeff[2 * j] : coeff[j];
+			float ci = complexTap ? coeff[2 * j + 1] : 0.f;
+			re += cr * xr - ci * xi;
+			im += cr * xi + ci * xr;
+		}
+		out_cpu[2 * i] = re;
+		out_cpu[2 * i + 1] = im;
 	}
-	
+
 	free(temp_in);
 	return out_cpu;
 }
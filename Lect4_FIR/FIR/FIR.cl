@@ -30,3 +30,661 @@ __kernel void FIR( __global float * output,
 
     //barrier( CLK_GLOBAL_MEM_FENCE );
 }
+
+/*
+ * Calculate a bank of FIR filters in one launch
+ * dim 0 is the output sample, dim 1 is the channel.  Each channel reads its
+ * taps at coeff + coeffOffset[ch] and its window at temp_input + historyOffset[ch];
+ * the window is (numTap-1) history samples followed by the numData new samples.
+ * The last (numTap-1) samples of the window are copied to the same offset in
+ * next_input so the following block finds its history there (ping-pong windows).
+ */
+
+__kernel void FIR_bank( __global float * output,          /* numChannel rows, each numData long */
+                        __global const float * coeff,     /* packed coefficient sets, each numTap long */
+                        __global const uint * coeffOffset,
+                        __global const float * temp_input,
+                        __global float * next_input,
+                        __global const uint * historyOffset,
+                        uint numTap,
+                        uint numData){
+
+    uint tid = get_global_id(0);
+    uint ch = get_global_id(1);
+
+    if( tid >= numData )
+        return;
+
+    __global const float * c = coeff + coeffOffset[ch];
+    __global const float * x = temp_input + historyOffset[ch];
+
+    float sum = 0;
+    uint i=0;
+
+    for( i=0; i<numTap; i++ )
+    {
+        sum += c[i] * x[tid + i];
+    }
+    output[ch * numData + tid] = sum;
+
+    /* fill the history buffer of the next block */
+    for( i=tid; i<numTap-1; i+=numData )
+        next_input[historyOffset[ch] + i] = x[numData + i];
+}
+
+/*
+ * Calculate a FIR filter with the input window staged in local memory
+ * Every work group loads the (local + numTap - 1) samples its outputs need
+ * once, instead of every work item reading numTap samples from global memory.
+ * When the window does not fit in local memory the taps are processed in
+ * tiles of tapTile, and the window is restaged for every tile.
+ * window must hold (local size + tapTile - 1) floats.
+ * FIR_local takes the coefficients from constant memory; FIR_local_global is
+ * the fallback for filters longer than the constant buffer.
+ */
+
+#define FIR_LOCAL_KERNEL( name, coeffSpace )                                  \
+__kernel void name( __global float * output,                                  \
+                    coeffSpace float * coeff,                                 \
+                    __global const float * temp_input,                        \
+                    __local float * window,                                   \
+                    uint numTap,                                              \
+                    uint numData,                                             \
+                    uint tapTile ){                                           \
+                                                                              \
+    uint tid = get_global_id(0);                                              \
+    uint lid = get_local_id(0);                                               \
+    uint local_size = get_local_size(0);                                      \
+    uint base = get_group_id(0) * local_size;                                 \
+    uint numWindow = numData + numTap - 1;                                    \
+                                                                              \
+    float sum = 0;                                                            \
+    uint t0, i;                                                               \
+                                                                              \
+    for( t0=0; t0<numTap; t0+=tapTile )                                       \
+    {                                                                         \
+        uint tileLen = min( tapTile, numTap - t0 );                           \
+        uint winLen = local_size + tileLen - 1;                               \
+                                                                              \
+        for( i=lid; i<winLen; i+=local_size )                                 \
+        {                                                                     \
+            uint x = base + t0 + i;                                           \
+            window[i] = x < numWindow ? temp_input[x] : 0.0f;                 \
+        }                                                                     \
+        barrier( CLK_LOCAL_MEM_FENCE );                                       \
+                                                                              \
+        for( i=0; i<tileLen; i++ )                                            \
+        {                                                                     \
+            sum += coeff[t0 + i] * window[lid + i];                           \
+        }                                                                     \
+        barrier( CLK_LOCAL_MEM_FENCE );                                       \
+    }                                                                         \
+                                                                              \
+    if( tid < numData )                                                       \
+        output[tid] = sum;                                                    \
+}
+
+FIR_LOCAL_KERNEL( FIR_local, __constant )
+FIR_LOCAL_KERNEL( FIR_local_global, __global const )
+
+/*
+ * Calculate a FIR filter with several consecutive outputs per work item
+ * Work item g computes outputs [g*NOUT, g*NOUT + NOUT) and keeps the NOUT
+ * input samples they currently need in registers.  Every tap loads one new
+ * sample and slides the window, so each input is loaded once per work item
+ * instead of once per output.
+ */
+
+#define FIR_BLOCKED_KERNEL( name, NOUT )                                      \
+__kernel void name( __global float * output,                                  \
+                    __global const float * coeff,                             \
+                    __global const float * temp_input,                        \
+                    uint numTap,                                              \
+                    uint numData ){                                           \
+                                                                              \
+    uint first = get_global_id(0) * NOUT;                                     \
+    uint numWindow = numData + numTap - 1;                                    \
+                                                                              \
+    float sum[NOUT];                                                          \
+    float x[NOUT];                                                            \
+    uint i, k;                                                                \
+                                                                              \
+    if( first >= numData )                                                    \
+        return;                                                               \
+                                                                              \
+    for( k=0; k<NOUT; k++ )                                                   \
+    {                                                                         \
+        sum[k] = 0;                                                           \
+        x[k] = first + k < numWindow ? temp_input[first + k] : 0.0f;          \
+    }                                                                         \
+                                                                              \
+    for( i=0; i<numTap; i++ )                                                 \
+    {                                                                         \
+        float c = coeff[i];                                                   \
+        uint next = first + i + NOUT;                                         \
+                                                                              \
+        for( k=0; k<NOUT; k++ )                                               \
+            sum[k] += c * x[k];                                               \
+                                                                              \
+        for( k=0; k<NOUT-1; k++ )                                             \
+            x[k] = x[k+1];                                                    \
+        x[NOUT-1] = next < numWindow ? temp_input[next] : 0.0f;               \
+    }                                                                         \
+                                                                              \
+    for( k=0; k<NOUT; k++ )                                                   \
+        if( first + k < numData )                                             \
+            output[first + k] = sum[k];                                       \
+}
+
+FIR_BLOCKED_KERNEL( FIR_blocked4, 4 )
+FIR_BLOCKED_KERNEL( FIR_blocked8, 8 )
+FIR_BLOCKED_KERNEL( FIR_blocked16, 16 )
+
+/*
+ * Overlap-save fast convolution, used with the FFT kernels in FFT.cl
+ * The window ((numTap-1) history + numData samples) is cut into segments of
+ * N samples that overlap by numTap-1; segment s starts at s*L, L = N-numTap+1.
+ * After the circular convolution with the reversed taps, samples
+ * [numTap-1, N) of segment s are outputs [s*L, s*L + L) of the FIR kernel.
+ * dim 0 is the sample in the segment, dim 1 the segment.
+ */
+
+__kernel void FIR_ols_gather( __global const float * temp_input,
+                              __global float2 * segment,
+                              uint numWindow,
+                              uint N,
+                              uint L ){
+
+    uint t = get_global_id(0);
+    uint s = get_global_id(1);
+    uint x = s * L + t;
+
+    segment[s * N + t] = (float2)( x < numWindow ? temp_input[x] : 0.0f, 0.0f );
+}
+
+/* Pointwise product with the filter spectrum, folding in the 1/N of the inverse FFT */
+__kernel void FIR_ols_multiply( __global float2 * segment,
+                                __global const float2 * spectrum,
+                                uint N,
+                                float scale ){
+
+    uint t = get_global_id(0);
+    uint s = get_global_id(1);
+    float2 a = segment[s * N + t];
+    float2 h = spectrum[t];
+
+    segment[s * N + t] = scale * (float2)( a.x * h.x - a.y * h.y, a.x * h.y + a.y * h.x );
+}
+
+__kernel void FIR_ols_scatter( __global const float2 * segment,
+                               __global float * output,
+                               uint numTap,
+                               uint numData,
+                               uint N,
+                               uint L ){
+
+    uint t = get_global_id(0);
+    uint s = get_global_id(1);
+    uint n = s * L + t;
+
+    if( t < L && n < numData )
+        output[n] = segment[s * N + numTap - 1 + t].x;
+}
+
+/*
+ * Polyphase resampling by up/down
+ * The output is the FIR kernel applied to the input zero-stuffed by up,
+ * keeping every down-th sample.  Only the retained outputs are computed and
+ * the stuffed zeros are never touched: output j falls on stuffed sample
+ * m = first + j*down, i.e. phase p = m % up of input sample q = m / up, and
+ * only the phaseTap taps of that phase multiply nonzero samples.  first (less
+ * than down) carries the output phase from one block to the next.  coeff
+ * holds up phases of phaseTap taps each, laid out by the host so that
+ *     output[j] = sum_r coeff[p*phaseTap + r] * temp_input[q + r]
+ * where temp_input is (phaseTap-1) history followed by the new samples.
+ */
+
+/* up = 1: the phase is the filter itself, one work item per kept output */
+__kernel void FIR_decimate( __global float * output,
+                            __global const float * coeff,
+                            __global const float * temp_input,
+                            uint numTap,
+                            uint down,
+                            uint numOut,
+                            uint first ){
+
+    uint tid = get_global_id(0);
+
+    if( tid >= numOut )
+        return;
+
+    __global const float * x = temp_input + first + tid * down;
+
+    float sum = 0;
+    uint i=0;
+
+    for( i=0; i<numTap; i++ )
+    {
+        sum += coeff[i] * x[i];
+    }
+    output[tid] = sum;
+}
+
+/* down = 1: one work item per input sample, computing its up outputs */
+__kernel void FIR_interpolate( __global float * output,
+                               __global const float * coeff,
+                               __global const float * temp_input,
+                               uint up,
+                               uint phaseTap,
+                               uint numIn ){
+
+    uint q = get_global_id(0);
+
+    if( q >= numIn )
+        return;
+
+    __global const float * x = temp_input + q;
+    uint p, r;
+
+    for( p=0; p<up; p++ )
+    {
+        __global const float * c = coeff + p * phaseTap;
+        float sum = 0;
+
+        for( r=0; r<phaseTap; r++ )
+        {
+            sum += c[r] * x[r];
+        }
+        output[q * up + p] = sum;
+    }
+}
+
+/* General up/down: one work item per kept output */
+__kernel void FIR_resample( __global float * output,
+                            __global const float * coeff,
+                            __global const float * temp_input,
+                            uint up,
+                            uint down,
+                            uint phaseTap,
+                            uint numOut,
+                            uint first ){
+
+    uint tid = get_global_id(0);
+
+    if( tid >= numOut )
+        return;
+
+    uint m = first + tid * down;
+    __global const float * c = coeff + ( m % up ) * phaseTap;
+    __global const float * x = temp_input + m / up;
+
+    float sum = 0;
+    uint r=0;
+
+    for( r=0; r<phaseTap; r++ )
+    {
+        sum += c[r] * x[r];
+    }
+    output[tid] = sum;
+}
+
+/*
+ * Complex (IQ) FIR filters
+ * Same window and output layout as FIR, but every sample is complex.
+ * The taps are real (tapType float) or complex (tapType float2).  The
+ * interleaved kernels read float2 samples; the split kernels read the I and
+ * Q planes as two float windows and write two float outputs, so both layouts
+ * filter I and Q in one launch without a host deinterleave.
+ */
+
+#define FIR_TAP_REAL( c, v )     ( (c) * (v) )
+#define FIR_TAP_COMPLEX( c, v )  (float2)( (c).x * (v).x - (c).y * (v).y,       \
+                                           (c).x * (v).y + (c).y * (v).x )
+
+#define FIR_COMPLEX_KERNEL( name, tapType, TAP )                              \
+__kernel void name( __global float2 * output,                                 \
+                    __global const tapType * coeff,                           \
+                    __global const float2 * temp_input,                       \
+                    uint numTap,                                              \
+                    uint numData ){                                           \
+                                                                              \
+    uint tid = get_global_id(0);                                              \
+                                                                              \
+    if( tid >= numData )                                                      \
+        return;                                                               \
+                                                                              \
+    float2 sum = (float2)( 0.0f, 0.0f );                                      \
+    uint i=0;                                                                 \
+                                                                              \
+    for( i=0; i<numTap; i++ )                                                 \
+    {                                                                         \
+        sum += TAP( coeff[i], temp_input[tid + i] );                          \
+    }                                                                         \
+    output[tid] = sum;                                                        \
+}
+
+#define FIR_COMPLEX_SPLIT_KERNEL( name, tapType, TAP )                        \
+__kernel void name( __global float * output_re,                               \
+                    __global float * output_im,                               \
+                    __global const tapType * coeff,                           \
+                    __global const float * temp_re,                           \
+                    __global const float * temp_im,                           \
+                    uint numTap,                                              \
+                    uint numData ){                                           \
+                                                                              \
+    uint tid = get_global_id(0);                                              \
+                                                                              \
+    if( tid >= numData )                                                      \
+        return;                                                               \
+                                                                              \
+    float2 sum = (float2)( 0.0f, 0.0f );                                      \
+    uint i=0;                                                                 \
+                                                                              \
+    for( i=0; i<numTap; i++ )                                                 \
+    {                                                                         \
+        float2 x = (float2)( temp_re[tid + i], temp_im[tid + i] );            \
+        sum += TAP( coeff[i], x );                                            \
+    }                                                                         \
+    output_re[tid] = sum.x;                                                   \
+    output_im[tid] = sum.y;                                                   \
+}
+
+FIR_COMPLEX_KERNEL( FIR_complex_rtap, float, FIR_TAP_REAL )
+FIR_COMPLEX_KERNEL( FIR_complex_ctap, float2, FIR_TAP_COMPLEX )
+FIR_COMPLEX_SPLIT_KERNEL( FIR_complex_split_rtap, float, FIR_TAP_REAL )
+FIR_COMPLEX_SPLIT_KERNEL( FIR_complex_split_ctap, float2, FIR_TAP_COMPLEX )
+
+/*
+ * Calculate a FIR filter with symmetric (linear-phase) taps
+ * coeff holds the first (numTap+1)/2 taps only; coeff[i] == coeff[numTap-1-i]
+ * lets the two mirrored samples be added before the multiply, halving both
+ * the multiplies and the coefficient loads.  The middle tap of an odd-length
+ * filter is applied on its own.
+ */
+
+__kernel void FIR_symmetric( __global float * output,
+                             __global const float * coeff,
+                             __global const float * temp_input,
+                             uint numTap,
+                             uint numData ){
+
+    uint tid = get_global_id(0);
+
+    if( tid >= numData )
+        return;
+
+    __global const float * x = temp_input + tid;
+    uint half = numTap / 2;
+
+    float sum = 0;
+    uint i=0;
+
+    for( i=0; i<half; i++ )
+    {
+        sum += coeff[i] * ( x[i] + x[numTap - 1 - i] );
+    }
+    if( numTap & 1 )
+        sum += coeff[half] * x[half];
+
+    output[tid] = sum;
+}
+
+/*
+ * Moving average (boxcar) over numTap samples from prefix sums
+ * The window (numTap-1) history + numData samples is scanned into
+ * compensated prefix sums, kept as (sum, error) pairs, so that
+ *     output[n] = ( P[n+numTap-1] - P[n-1] ) / numTap
+ * costs two lookups whatever numTap is.  The scan restarts with every
+ * window, so the prefix never grows past one window of samples.
+ */
+
+/* Error-free a + b: .x the rounded sum, .y what rounding lost */
+float2 two_sum( float a, float b )
+{
+    float s = a + b;
+    float bb = s - a;
+    return (float2)( s, ( a - ( s - bb ) ) + ( b - bb ) );
+}
+
+/* (sum, error) pair plus pair, renormalized */
+float2 ff_add( float2 a, float2 b )
+{
+    float2 s = two_sum( a.x, b.x );
+    float e = s.y + a.y + b.y;
+    float hi = s.x + e;
+    return (float2)( hi, e - ( hi - s.x ) );
+}
+
+/*
+ * Each work item scans perItem consecutive samples, the work group scans
+ * the item totals in local memory (Hillis-Steele) and adds them back.
+ * prefix gets the inclusive prefix within the group, groupSum the group
+ * total.
+ */
+__kernel void FIR_boxcar_scan( __global const float * temp_input,
+                               __global float2 * prefix,
+                               __global float2 * groupSum,
+                               __local float2 * scan,
+                               uint len,
+                               uint perItem ){
+
+    uint lid = get_local_id(0);
+    uint size = get_local_size(0);
+    uint n0 = get_global_id(0) * perItem;
+    uint n1 = min( n0 + perItem, len );
+    float2 acc = (float2)( 0.0f, 0.0f );
+    uint n, d;
+
+    for( n=n0; n<n1; n++ )
+    {
+        acc = ff_add( acc, (float2)( temp_input[n], 0.0f ) );
+        prefix[n] = acc;
+    }
+    scan[lid] = acc;
+    barrier( CLK_LOCAL_MEM_FENCE );
+
+    for( d=1; d<size; d*=2 )
+    {
+        float2 add = lid >= d ? scan[lid - d] : (float2)( 0.0f, 0.0f );
+        barrier( CLK_LOCAL_MEM_FENCE );
+        scan[lid] = ff_add( scan[lid], add );
+        barrier( CLK_LOCAL_MEM_FENCE );
+    }
+
+    if( lid > 0 )
+    {
+        float2 offset = scan[lid - 1];
+        for( n=n0; n<n1; n++ )
+            prefix[n] = ff_add( offset, prefix[n] );
+    }
+    if( lid == size - 1 )
+        groupSum[get_group_id(0)] = scan[lid];
+}
+
+/* One work group: group totals become exclusive group offsets */
+__kernel void FIR_boxcar_group( __global float2 * groupSum,
+                                __local float2 * scan,
+                                uint numGroup ){
+
+    uint lid = get_local_id(0);
+    uint size = get_local_size(0);
+    uint d;
+
+    scan[lid] = lid > 0 && lid <= numGroup ? groupSum[lid - 1] : (float2)( 0.0f, 0.0f );
+    barrier( CLK_LOCAL_MEM_FENCE );
+
+    for( d=1; d<size; d*=2 )
+    {
+        float2 add = lid >= d ? scan[lid - d] : (float2)( 0.0f, 0.0f );
+        barrier( CLK_LOCAL_MEM_FENCE );
+        scan[lid] = ff_add( scan[lid], add );
+        barrier( CLK_LOCAL_MEM_FENCE );
+    }
+
+    if( lid < numGroup )
+        groupSum[lid] = scan[lid];
+}
+
+/* Full prefix P[k]: the group offset plus the prefix within the group */
+float2 boxcar_prefix( __global const float2 * prefix,
+                      __global const float2 * groupSum,
+                      uint k,
+                      uint groupLen ){
+
+    return ff_add( groupSum[k / groupLen], prefix[k] );
+}
+
+__kernel void FIR_boxcar( __global float * output,
+                          __global const float2 * prefix,
+                          __global const float2 * groupSum,
+                          uint numTap,
+                          uint numData,
+                          uint groupLen ){
+
+    uint tid = get_global_id(0);
+
+    if( tid >= numData )
+        return;
+
+    float2 hi = boxcar_prefix( prefix, groupSum, tid + numTap - 1, groupLen );
+    float2 lo = tid > 0 ? boxcar_prefix( prefix, groupSum, tid - 1, groupLen )
+                        : (float2)( 0.0f, 0.0f );
+
+    output[tid] = ( ( hi.x - lo.x ) + ( hi.y - lo.y ) ) / numTap;
+}
+
+/*
+ * Short-time Fourier transform of the filtered stream
+ * samples holds the filtered samples not yet consumed by a full frame
+ * followed by the new block.  Frame f starts at f*hop, is N samples long
+ * and is multiplied by window before the batched FFT (FFT.cl).
+ * dim 0 is the sample (or bin) in the frame, dim 1 the frame.
+ */
+
+__kernel void FIR_stft_frame( __global const float * samples,
+                              __global const float * window,
+                              __global float2 * frame,
+                              uint N,
+                              uint hop ){
+
+    uint t = get_global_id(0);
+    uint f = get_global_id(1);
+
+    frame[f * N + t] = (float2)( samples[f * hop + t] * window[t], 0.0f );
+}
+
+/* Power of bins 0 .. N/2, the rest mirror them for real input */
+__kernel void FIR_stft_power( __global const float2 * frame,
+                              __global float * power,
+                              uint N ){
+
+    uint k = get_global_id(0);
+    uint f = get_global_id(1);
+    uint numBin = N / 2 + 1;
+
+    if( k >= numBin )
+        return;
+
+    float2 v = frame[f * N + k];
+    power[f * numBin + k] = v.x * v.x + v.y * v.y;
+}
+
+/*
+ * Calculate a FIR filter on a window uploaded in a compact sample format
+ * The window ((numTap-1) history + numData samples) is float, half or
+ * int16; every sample is expanded to float as it is loaded and the int16
+ * full scale is applied once to the sum.
+ */
+
+#define FIR_LOAD_FLOAT( p, n )  ( p[n] )
+#define FIR_LOAD_HALF( p, n )   vload_half( n, p )
+#define FIR_LOAD_INT16( p, n )  convert_float( p[n] )
+
+#define FIR_PACKED_KERNEL( name, type, LOAD )                                 \
+__kernel void name( __global float * output,                                  \
+                    __global const float * coeff,                             \
+                    __global const type * temp_input,                         \
+                    uint numTap,                                              \
+                    uint numData,                                             \
+                    float scale ){                                            \
+                                                                              \
+    uint tid = get_global_id(0);                                              \
+                                                                              \
+    if( tid >= numData )                                                      \
+        return;                                                               \
+                                                                              \
+    float sum = 0;                                                            \
+    uint i=0;                                                                 \
+                                                                              \
+    for( i=0; i<numTap; i++ )                                                 \
+    {                                                                         \
+        sum += coeff[i] * LOAD( temp_input, tid + i );                        \
+    }                                                                         \
+    output[tid] = sum * scale;                                                \
+}
+
+FIR_PACKED_KERNEL( FIR_packed_float, float, FIR_LOAD_FLOAT )
+FIR_PACKED_KERNEL( FIR_packed_half, half, FIR_LOAD_HALF )
+FIR_PACKED_KERNEL( FIR_packed_int16, short, FIR_LOAD_INT16 )
+
+/*
+ * Calculate a fixed-point FIR filter on Q15 samples and taps
+ * Work item g computes outputs [g*8, g*8 + 8) from short8 loads: every
+ * group of 8 taps loads two short8 of samples and slides over them.  coeff
+ * is padded with zero taps to numTapPad, a multiple of 8, and the window
+ * ((numTap-1) history + numData samples) is padded so that every short8
+ * load stays inside the buffer.  Products are Q30; the accumulator is
+ * int8 with saturation after every tap (mad_sat) or long8 without, and
+ * the result is rounded to Q15 or widened to Q31, saturated.
+ */
+
+#define FIR_MAC_SAT32( acc, v, c )  acc = mad_sat( convert_int8( v ), (int8)( c ), acc )
+#define FIR_MAC_64( acc, v, c )     acc += convert_long8( convert_int8( v ) * (int8)( c ) )
+
+#define FIR_OUT_Q15_SAT32( acc )    convert_short8_sat( add_sat( acc, (int8)( 1 << 14 ) ) >> 15 )
+#define FIR_OUT_Q15_64( acc )       convert_short8_sat( ( acc + (long8)( 1 << 14 ) ) >> 15 )
+#define FIR_OUT_Q31_64( acc )       convert_int8_sat( acc << 1 )
+
+#define FIR_Q15_KERNEL( name, accType, outType, MAC, OUT )                    \
+__kernel void name( __global outType * output,                                \
+                    __global const short * coeff,                             \
+                    __global const short * temp_input,                        \
+                    uint numTapPad,                                           \
+                    uint numData ){                                           \
+                                                                              \
+    uint g = get_global_id(0);                                                \
+    uint first = g * 8;                                                       \
+                                                                              \
+    if( first >= numData )                                                    \
+        return;                                                               \
+                                                                              \
+    accType##8 acc = (accType##8)( 0 );                                       \
+    short x[16];                                                              \
+    short c[8];                                                               \
+    uint j, t, k;                                                             \
+                                                                              \
+    for( j=0; j<numTapPad/8; j++ )                                            \
+    {                                                                         \
+        vstore8( vload8( j, coeff ), 0, c );                                  \
+        vstore8( vload8( g + j, temp_input ), 0, x );                         \
+        vstore8( vload8( g + j + 1, temp_input ), 1, x );                     \
+                                                                              \
+        for( t=0; t<8; t++ )                                                  \
+            MAC( acc, vload8( 0, x + t ), c[t] );                             \
+    }                                                                         \
+                                                                              \
+    outType##8 y = OUT( acc );                                                \
+    if( first + 8 <= numData )                                                \
+        vstore8( y, g, output );                                              \
+    else                                                                      \
+    {                                                                         \
+        outType o[8];                                                         \
+        vstore8( y, 0, o );                                                   \
+        for( k=0; first + k<numData; k++ )                                    \
+            output[first + k] = o[k];                                         \
+    }                                                                         \
+}
+
+FIR_Q15_KERNEL( FIR_q15_sat32, int, short, FIR_MAC_SAT32, FIR_OUT_Q15_SAT32 )
+FIR_Q15_KERNEL( FIR_q15_acc64, long, short, FIR_MAC_64, FIR_OUT_Q15_64 )
+FIR_Q15_KERNEL( FIR_q31_acc64, long, int, FIR_MAC_64, FIR_OUT_Q31_64 )
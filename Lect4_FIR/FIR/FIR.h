@@ -0,0 +1,484 @@
+#ifndef _FIR_H_
+#define _FIR_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <CL/cl.h>
+
+#define CHECK_STATUS( status, message )   \
+		if(status != CL_SUCCESS) \
+		{ \
+			printf( message); \
+			printf( "\n" ); \
+			return 1; \
+		}
+
+/** Define custom constants*/
+#define MAX_SOURCE_SIZE (0x100000)
+
+/*
+ * OpenCL objects shared by every FIR mode: one device, its context and
+ * profiling queue, and FIR.cl + FFT.cl built for it.
+ */
+typedef struct {
+	cl_device_id device;
+	cl_context context;
+	cl_command_queue queue;
+	cl_program program;
+} FIRDevice;
+
+int FIRDeviceInit(FIRDevice *dev, cl_device_id device_id);
+int FIRDeviceList(cl_device_id **ids, cl_uint *numDevice);
+void FIRDeviceRelease(FIRDevice *dev);
+
+/* Kernel execution time of a profiled event, in microseconds */
+double FIREventTime(cl_event event);
+
+/* Host wall-clock time, in microseconds */
+double WallTime(void);
+
+/* Compare against a CPU reference with a relative tolerance */
+int FIRVerify(const float *ref, const float *out, size_t n, float tol);
+
+float* cpu_compute(float *input, float* coeff, unsigned int numTap, unsigned int numData);
+float* cpu_compute_complex(float *input, float* coeff, unsigned int numTap,
+		unsigned int numData, int complexTap);
+
+
+/*
+ * CPU filter (FIRCpu.c): the verification reference and the backend for
+ * hosts without an OpenCL device.  SIMD across outputs, a pool of threads
+ * started once and shared by every block, and only the numTap-1 history
+ * samples kept between blocks.
+ */
+typedef enum {
+	FIR_CPU_SCALAR,
+	FIR_CPU_AVX2,
+	FIR_CPU_AVX512,
+	FIR_CPU_NUM_ISA
+} FIRCpuISA;
+
+extern const char *FIRCpuISAName[FIR_CPU_NUM_ISA];
+
+typedef struct {
+	cl_uint numTap;
+	int numThread;
+	FIRCpuISA isa;
+	float *coeff;
+	float *history;          /* last numTap-1 input samples */
+	float *stitch;           /* history + first numTap-1 samples of a block */
+	struct FIRCpuPool *pool; /* numThread-1 persistent workers, NULL for one thread */
+} FIRCpu;
+
+FIRCpuISA FIRCpuDetect(void);
+int FIRCpuCreate(FIRCpu *fc, cl_uint numTap, const float *coeff,
+		int numThread, FIRCpuISA isa);
+void FIRCpuProcess(FIRCpu *fc, const float *input, float *output, size_t numData);
+void FIRCpuReset(FIRCpu *fc);
+void FIRCpuSetCoeff(FIRCpu *fc, const float *coeff);
+void FIRCpuRelease(FIRCpu *fc);
+float* cpu_compute_with(FIRCpu *fc, const float *coeff, const float *input,
+		unsigned int numData);
+int RunFIRCpu(cl_uint numTap, cl_uint numData, cl_uint numBlocks, int numThread);
+
+
+/*
+ * Filter bank: numChannel independent FIR filters, each with its own
+ * coefficient set and history, computed in a single 2D launch
+ * (dim 0 = sample, dim 1 = channel).
+ */
+typedef struct {
+	cl_uint numChannel;
+	cl_uint numTap;
+	cl_uint numData;         /* samples per channel per block */
+	cl_uint stride;          /* window length per channel, (numTap-1) history + numData */
+	cl_uint block;           /* blocks processed so far, selects the active window */
+	cl_mem coeffBuffer;
+	cl_mem coeffOffsetBuffer;
+	cl_mem historyOffsetBuffer;
+	cl_mem window[2];        /* ping-pong windows, the kernel writes the next history */
+	cl_mem outputBuffer;
+	cl_kernel kernel;
+} FIRBank;
+
+int FIRBankCreate(FIRBank *bank, FIRDevice *dev, cl_uint numChannel,
+		cl_uint numTap, cl_uint numData, const cl_float *coeff,
+		cl_uint numCoeffSet, const cl_uint *coeffSet);
+int FIRBankProcess(FIRBank *bank, FIRDevice *dev, const cl_float *input,
+		cl_float *output, cl_event *event);
+int FIRBankReset(FIRBank *bank, FIRDevice *dev);
+void FIRBankRelease(FIRBank *bank);
+
+/*
+ * Single-filter kernels in FIR.cl, all producing the output of the FIR
+ * kernel for one block with zero history (FIR_symmetric only for mirrored
+ * taps).
+ */
+typedef enum {
+	FIR_VARIANT_DIRECT,      /* FIR: one work-item per output, global loads */
+	FIR_VARIANT_LOCAL,       /* FIR_local: window in local memory, constant taps */
+	FIR_VARIANT_BLOCKED4,    /* FIR_blockedN: N outputs per work-item, */
+	FIR_VARIANT_BLOCKED8,    /*   sliding register window */
+	FIR_VARIANT_BLOCKED16,
+	FIR_VARIANT_SYMMETRIC,   /* FIR_symmetric: linear phase, half the taps */
+	FIR_VARIANT_FFT,         /* overlap-save FFT convolution (FIRFFT) */
+	FIR_NUM_VARIANT
+} FIRVariant;
+
+/* RunFIRVariant picks the variant with FIRSelectVariant */
+#define FIR_VARIANT_AUTO FIR_NUM_VARIANT
+
+extern const char *FIRVariantName[FIR_NUM_VARIANT];
+
+/* Nonzero if coeff[i] == coeff[numTap-1-i] for every tap */
+int FIRIsSymmetric(const cl_float *coeff, cl_uint numTap);
+
+int FIRRunVariant(FIRDevice *dev, FIRVariant variant, cl_uint numTap,
+		cl_uint numData, const cl_float *coeff, const cl_float *input,
+		cl_float *output, int numIter, double *time);
+
+/*
+ * Batched radix-4/radix-2 FFT of length N = 2^m (FFT.cl).
+ */
+typedef struct {
+	cl_uint N;
+	cl_kernel radix2;
+	cl_kernel radix4;
+} FFTPlan;
+
+int FFTPlanCreate(FFTPlan *plan, FIRDevice *dev, cl_uint N);
+int FFTEnqueue(FFTPlan *plan, FIRDevice *dev, cl_mem *data, cl_mem *scratch,
+		cl_uint batch, int dir, double *time);
+void FFTPlanRelease(FFTPlan *plan);
+
+/* Below this many taps FIRSelectVariant does not try the FFT */
+#define FIR_FFT_MIN_TAP 64
+
+/*
+ * Overlap-save FFT convolution of a stream in blocks of numData samples.
+ * Each block is cut into numSeg segments of N samples overlapping by
+ * numTap-1; every segment yields L = N-numTap+1 outputs.
+ */
+typedef struct {
+	cl_uint numTap;
+	cl_uint numData;
+	cl_uint N;
+	cl_uint L;
+	cl_uint numSeg;
+	cl_uint block;           /* blocks processed so far, selects the active window */
+	FFTPlan fft;
+	cl_mem spectrum;         /* FFT of the reversed taps, computed once */
+	cl_mem window[2];        /* ping-pong (numTap-1) history + numData windows */
+	cl_mem segment;
+	cl_mem scratch;
+	cl_mem outputBuffer;
+	cl_kernel gather;
+	cl_kernel multiply;
+	cl_kernel scatter;
+} FIRFFT;
+
+cl_uint FIRFFTSize(cl_uint numTap, cl_uint numData);
+int FIRFFTCreate(FIRFFT *f, FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		const cl_float *coeff, cl_uint N);
+int FIRFFTProcess(FIRFFT *f, FIRDevice *dev, const cl_float *input,
+		cl_float *output, double *time);
+int FIRFFTReset(FIRFFT *f, FIRDevice *dev);
+void FIRFFTRelease(FIRFFT *f);
+int FIRFFTRunBlock(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		const cl_float *coeff, const cl_float *input, cl_float *output,
+		int numIter, double *time);
+FIRVariant FIRSelectVariant(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		const cl_float *coeff);
+
+/*
+ * Polyphase rational resampler: the FIR filter runs at up times the input
+ * rate and every down-th output is kept.  Each block of numIn input samples
+ * produces floor or ceil of numIn*up/down outputs, whichever keeps the
+ * stream on the down grid; the history and the output phase carry over.
+ */
+typedef struct {
+	cl_uint up;
+	cl_uint down;
+	cl_uint numTap;
+	cl_uint phaseTap;        /* taps per phase, ceil(numTap/up) */
+	cl_uint numIn;           /* input samples per block */
+	cl_uint numOut;          /* most output samples per block, ceil(numIn*up/down) */
+	cl_uint first;           /* stuffed index of the next output in the block, < down */
+	cl_uint block;           /* blocks processed so far, selects the active window */
+	cl_mem coeffBuffer;      /* up phases of phaseTap taps */
+	cl_mem window[2];        /* ping-pong (phaseTap-1) history + numIn windows */
+	cl_mem outputBuffer;
+	cl_kernel kernel;        /* FIR_decimate, FIR_interpolate or FIR_resample */
+} FIRResampler;
+
+int FIRResamplerCreate(FIRResampler *rs, FIRDevice *dev, cl_uint up,
+		cl_uint down, cl_uint numTap, cl_uint numIn, const cl_float *coeff);
+int FIRResamplerProcess(FIRResampler *rs, FIRDevice *dev,
+		const cl_float *input, cl_float *output, cl_uint *numOut, cl_event *event);
+int FIRResamplerReset(FIRResampler *rs, FIRDevice *dev);
+void FIRResamplerRelease(FIRResampler *rs);
+
+/*
+ * Complex (IQ) FIR filter with real or complex taps.  Interleaved blocks
+ * are numData (I, Q) pairs; split blocks are numData I samples followed by
+ * numData Q samples.  Complex taps are interleaved (re, im) pairs.
+ */
+typedef enum {
+	FIR_IQ_INTERLEAVED,
+	FIR_IQ_SPLIT
+} FIRIQLayout;
+
+typedef struct {
+	FIRIQLayout layout;
+	int complexTap;
+	cl_uint numTap;
+	cl_uint numData;
+	cl_uint block;           /* blocks processed so far, selects the active window */
+	cl_mem coeffBuffer;
+	cl_mem window[2][2];     /* [ping-pong][plane]; interleaved uses plane 0 only */
+	cl_mem outputBuffer[2];  /* I and Q planes, or the interleaved output in [0] */
+	cl_kernel kernel;
+} FIRComplex;
+
+int FIRComplexCreate(FIRComplex *fc, FIRDevice *dev, FIRIQLayout layout,
+		cl_uint numTap, cl_uint numData, const cl_float *coeff, int complexTap);
+int FIRComplexProcess(FIRComplex *fc, FIRDevice *dev, const cl_float *input,
+		cl_float *output, cl_event *event);
+int FIRComplexReset(FIRComplex *fc, FIRDevice *dev);
+void FIRComplexRelease(FIRComplex *fc);
+
+/*
+ * Moving average of numTap samples (every tap 1/numTap) from device prefix
+ * sums: the (numTap-1) history + numData window is scanned in groups of
+ * groupLen samples, then each output is the difference of two prefixes.
+ */
+typedef struct {
+	cl_uint numTap;
+	cl_uint numData;
+	cl_uint len;             /* window length, numTap-1 + numData */
+	cl_uint perItem;         /* samples scanned serially by one work item */
+	cl_uint groupSize;       /* work items per scan group, a power of two */
+	cl_uint numGroup;
+	cl_uint block;           /* blocks processed so far, selects the active window */
+	cl_mem window[2];        /* ping-pong (numTap-1) history + numData windows */
+	cl_mem prefix;           /* compensated (sum, error) prefix within each group */
+	cl_mem groupSum;         /* group totals, then exclusive group offsets */
+	cl_mem outputBuffer;
+	cl_kernel scan;
+	cl_kernel group;
+	cl_kernel kernel;
+} FIRBoxcar;
+
+int FIRBoxcarCreate(FIRBoxcar *bx, FIRDevice *dev, cl_uint numTap, cl_uint numData);
+int FIRBoxcarProcess(FIRBoxcar *bx, FIRDevice *dev, const cl_float *input,
+		cl_float *output, double *time);
+int FIRBoxcarReset(FIRBoxcar *bx, FIRDevice *dev);
+void FIRBoxcarRelease(FIRBoxcar *bx);
+
+/*
+ * Spectrogram of the filtered stream: a one-channel filter bank feeds a
+ * windowed, hop-spaced STFT on the device.  Filtered samples never leave
+ * the device; every block yields the frames it completes, numBin = N/2+1
+ * power values each.
+ */
+typedef struct {
+	FIRBank bank;
+	FFTPlan fft;
+	cl_uint N;               /* frame (FFT) length, a power of two */
+	cl_uint hop;             /* samples between frame starts, 1 .. N */
+	cl_uint numBin;
+	cl_uint numData;
+	cl_uint maxFrame;        /* most frames one block can complete */
+	cl_uint pending;         /* filtered samples waiting for the next frame */
+	cl_uint block;           /* blocks processed so far, selects the active buffer */
+	cl_mem samples[2];       /* ping-pong pending + numData filtered samples */
+	cl_mem window;
+	cl_mem frame;
+	cl_mem scratch;
+	cl_mem power;
+	cl_kernel frameKernel;
+	cl_kernel powerKernel;
+} FIRStft;
+
+int FIRStftCreate(FIRStft *st, FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		const cl_float *coeff, cl_uint N, cl_uint hop);
+int FIRStftProcess(FIRStft *st, FIRDevice *dev, const cl_float *input,
+		cl_float *power, cl_uint *numFrame, double *time);
+void FIRStftRelease(FIRStft *st);
+
+/*
+ * Single filter fed in a compact sample format: the host converts every
+ * block (SIMD, multithreaded) before the upload and FIR_packed_* expands
+ * it back to float as it loads it.  int16 samples are Q15 fractions of
+ * fullScale, clipped outside +-fullScale.
+ */
+typedef enum {
+	FIR_PACK_FLOAT,          /* 4 bytes, the reference path */
+	FIR_PACK_HALF,           /* 2 bytes, IEEE binary16 */
+	FIR_PACK_INT16,          /* 2 bytes, Q15 of fullScale */
+	FIR_NUM_PACK
+} FIRPackFormat;
+
+extern const char *FIRPackName[FIR_NUM_PACK];
+extern const size_t FIRPackSize[FIR_NUM_PACK];
+
+typedef struct {
+	FIRPackFormat format;
+	cl_uint numTap;
+	cl_uint numData;
+	float fullScale;
+	int numThread;           /* conversion threads */
+	FIRCpuISA isa;
+	cl_uint block;           /* blocks processed so far, selects the active window */
+	void *staging;           /* converted block */
+	cl_mem coeffBuffer;
+	cl_mem window[2];        /* ping-pong (numTap-1) history + numData windows */
+	cl_mem outputBuffer;
+	cl_kernel kernel;
+} FIRPacked;
+
+void FIRPackConvert(FIRPackFormat format, const float *in, void *out, size_t n,
+		float fullScale, int numThread, FIRCpuISA isa);
+int FIRPackedCreate(FIRPacked *pk, FIRDevice *dev, FIRPackFormat format,
+		cl_uint numTap, cl_uint numData, const cl_float *coeff, float fullScale);
+int FIRPackedProcess(FIRPacked *pk, FIRDevice *dev, const cl_float *input,
+		cl_float *output, double *convertTime, double *uploadTime, double *kernelTime);
+void FIRPackedRelease(FIRPacked *pk);
+
+/*
+ * Fixed-point filter on Q15 samples and taps (FIR_q15_* / FIR_q31_*):
+ * Q30 products summed in a 32-bit accumulator saturated after every tap,
+ * or in a 64-bit one, then rounded to Q15 or widened to Q31.
+ */
+typedef enum {
+	FIR_Q15_SAT32,           /* int accumulator with mad_sat, Q15 out */
+	FIR_Q15_ACC64,           /* long accumulator, Q15 out */
+	FIR_Q31_ACC64,           /* long accumulator, Q31 out */
+	FIR_NUM_QFORMAT
+} FIRQFormat;
+
+extern const char *FIRQFormatName[FIR_NUM_QFORMAT];
+
+typedef struct {
+	FIRQFormat format;
+	cl_uint numTap;
+	cl_uint numTapPad;       /* numTap rounded up to 8, padded with zero taps */
+	cl_uint numData;
+	cl_uint block;           /* blocks processed so far, selects the active window */
+	cl_mem coeffBuffer;
+	cl_mem window[2];        /* ping-pong (numTap-1) history + numData windows, padded */
+	cl_mem outputBuffer;
+	cl_kernel kernel;
+} FIRFixed;
+
+int FIRFixedCreate(FIRFixed *fx, FIRDevice *dev, FIRQFormat format,
+		cl_uint numTap, cl_uint numData, const cl_short *coeff);
+int FIRFixedProcess(FIRFixed *fx, FIRDevice *dev, const cl_short *input,
+		void *output, cl_event *event);
+void FIRFixedRelease(FIRFixed *fx);
+void cpu_compute_fixed(const cl_short *input, const cl_short *coeff,
+		unsigned int numTap, size_t numData, FIRQFormat format, void *output);
+
+/*
+ * Binary sample file: a 64-byte header, then numFrame frames of numChannel
+ * interleaved samples starting at dataOffset (page aligned when written
+ * here).  Files are accessed through mmap only.
+ */
+#define FIR_FILE_MAGIC "FIRS"
+#define FIR_FILE_VERSION 1
+
+enum {
+	FIR_SAMPLE_FLOAT32 = 1,
+	FIR_SAMPLE_CFLOAT32 = 2   /* interleaved (I, Q) float pairs */
+};
+
+typedef struct {
+	char magic[4];
+	cl_uint version;
+	cl_uint sampleType;
+	cl_uint numChannel;
+	cl_uint sampleRate;      /* Hz */
+	cl_uint dataOffset;      /* bytes from the start of the file */
+	cl_ulong numFrame;       /* samples per channel */
+	char reserved[32];
+} FIRFileHeader;
+
+typedef struct {
+	int fd;
+	int writable;
+	void *map;
+	size_t mapSize;
+	FIRFileHeader *header;   /* points into the mapping */
+	void *data;
+} FIRFile;
+
+size_t FIRSampleSize(cl_uint sampleType);
+int FIRFileOpen(FIRFile *file, const char *path);
+int FIRFileCreate(FIRFile *file, const char *path, cl_uint sampleType,
+		cl_uint numChannel, cl_uint sampleRate, cl_ulong numFrame);
+void FIRFileClose(FIRFile *file);
+int FIRFileGenerate(const char *path, cl_ulong numFrame, cl_uint numChannel,
+		cl_uint sampleRate);
+
+/*
+ * Single-producer/single-consumer lock-free ring of samples.  The producer
+ * owns head, the consumer owns tail; each sits on its own cache line next
+ * to a cached copy of the other index, so the two threads only share a
+ * line when the cached index runs out.
+ */
+#define FIR_CACHE_LINE 64
+
+typedef struct {
+	cl_float *buffer;
+	size_t mask;             /* capacity - 1, capacity a power of two */
+	size_t head __attribute__((aligned(FIR_CACHE_LINE)));
+	size_t tailCache;        /* producer's last view of tail */
+	size_t tail __attribute__((aligned(FIR_CACHE_LINE)));
+	size_t headCache;        /* consumer's last view of head */
+} FIRRing;
+
+typedef struct {
+	cl_ulong produced;       /* samples offered by the producer */
+	cl_ulong overrun;        /* samples dropped on a full ring */
+	cl_ulong backpressure;   /* producer waits on a full ring */
+	cl_ulong underrun;       /* submission thread waits for a block */
+	cl_ulong blocks;         /* blocks enqueued to the filter */
+	cl_ulong maxFill;        /* peak ring occupancy, samples */
+	cl_ulong tail;           /* samples left over, less than a block */
+} FIRRingStats;
+
+int FIRRingCreate(FIRRing *ring, size_t capacity);
+size_t FIRRingWrite(FIRRing *ring, const cl_float *src, size_t n);
+size_t FIRRingRead(FIRRing *ring, cl_float *dst, size_t n);
+size_t FIRRingAvailable(FIRRing *ring);
+void FIRRingRelease(FIRRing *ring);
+
+int RunFIRBank(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		cl_uint numBlocks, cl_uint numChannel);
+int RunFIRVariant(FIRDevice *dev, FIRVariant variant, cl_uint numTap,
+		cl_uint numData, int symmetric);
+int RunFIRBench(FIRDevice *dev, cl_uint maxTap, cl_uint numData);
+int RunFIRFFT(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		cl_uint numBlocks);
+int RunFIRResample(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		cl_uint numBlocks, cl_uint up, cl_uint down);
+int RunFIRFile(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		const char *inPath, const char *outPath);
+int RunFIRRing(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		cl_uint numBlocks, double rate, int drop);
+void FIRLatencyReport(const char *label, double *lat, size_t n);
+int RunFIRLatency(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		cl_uint numBlocks);
+int RunFIRComplex(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		cl_uint numBlocks, FIRIQLayout layout, int complexTap);
+int RunFIRBoxcar(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		cl_uint numBlocks);
+int RunFIRMulti(cl_uint numTap, cl_uint numData);
+int RunFIRFixed(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		cl_uint numBlocks, FIRQFormat format);
+int RunFIRPacked(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		cl_uint numBlocks, FIRPackFormat format);
+int RunFIRStft(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		cl_uint numBlocks, cl_uint N, cl_uint hop);
+
+#endif // _FIR_H_
@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <CL/cl.h>
+#include "FIR.h"
+
+
+/*
+ * \brief Create the buffers and kernel of a filter bank.
+ *
+ * coeff holds numCoeffSet sets of numTap taps.  Channel ch filters with set
+ * coeffSet[ch]; pass NULL to give every channel its own set (numCoeffSet must
+ * then be numChannel).  The history of every channel starts out as zeros.
+ */
+int FIRBankCreate(FIRBank *bank, FIRDevice *dev, cl_uint numChannel,
+		cl_uint numTap, cl_uint numData, const cl_float *coeff,
+		cl_uint numCoeffSet, const cl_uint *coeffSet)
+{
+	cl_int ret;
+	cl_uint ch;
+
+	memset(bank, 0, sizeof(*bank));
+	bank->numChannel = numChannel;
+	bank->numTap = numTap;
+	bank->numData = numData;
+	bank->stride = numData + numTap - 1;
+
+	cl_uint *coeffOffset = (cl_uint *) malloc(numChannel * sizeof(cl_uint));
+	cl_uint *historyOffset = (cl_uint *) malloc(numChannel * sizeof(cl_uint));
+	for (ch = 0; ch < numChannel; ch++)
+	{
+		cl_uint set = coeffSet ? coeffSet[ch] : ch;
+		if (set >= numCoeffSet)
+		{
+			printf("Error: channel %u uses coefficient set %u of %u\n",
+					ch, set, numCoeffSet);
+			free(coeffOffset);
+			free(historyOffset);
+			return 1;
+		}
+		coeffOffset[ch] = set * numTap;
+		historyOffset[ch] = ch * bank->stride;
+	}
+
+	bank->coeffBuffer = clCreateBuffer(dev->context,
+			CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			sizeof(cl_float) * numTap * numCoeffSet, (void *)coeff, &ret);
+	CHECK_STATUS( ret,"Error: Create bank coeff Buffer\n");
+	bank->coeffOffsetBuffer = clCreateBuffer(dev->context,
+			CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			sizeof(cl_uint) * numChannel, coeffOffset, &ret);
+	CHECK_STATUS( ret,"Error: Create bank coeff offset Buffer\n");
+	bank->historyOffsetBuffer = clCreateBuffer(dev->context,
+			CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			sizeof(cl_uint) * numChannel, historyOffset, &ret);
+	CHECK_STATUS( ret,"Error: Create bank history offset Buffer\n");
+	free(coeffOffset);
+	free(historyOffset);
+
+	bank->window[0] = clCreateBuffer(dev->context, CL_MEM_READ_WRITE,
+			sizeof(cl_float) * bank->stride * numChannel, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create bank window Buffer\n");
+	bank->window[1] = clCreateBuffer(dev->context, CL_MEM_READ_WRITE,
+			sizeof(cl_float) * bank->stride * numChannel, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create bank window Buffer\n");
+	bank->outputBuffer = clCreateBuffer(dev->context, CL_MEM_WRITE_ONLY,
+			sizeof(cl_float) * numData * numChannel, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create bank output Buffer\n");
+
+	bank->kernel = clCreateKernel(dev->program, "FIR_bank", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (FIR_bank)\n");
+
+	ret = clSetKernelArg(bank->kernel, 0, sizeof(cl_mem), (void *)&bank->outputBuffer);
+	ret |= clSetKernelArg(bank->kernel, 1, sizeof(cl_mem), (void *)&bank->coeffBuffer);
+	ret |= clSetKernelArg(bank->kernel, 2, sizeof(cl_mem), (void *)&bank->coeffOffsetBuffer);
+	ret |= clSetKernelArg(bank->kernel, 5, sizeof(cl_mem), (void *)&bank->historyOffsetBuffer);
+	ret |= clSetKernelArg(bank->kernel, 6, sizeof(cl_uint), (void *)&numTap);
+	ret |= clSetKernelArg(bank->kernel, 7, sizeof(cl_uint), (void *)&numData);
+	CHECK_STATUS( ret,"Error: Set bank kernel arguments\n");
+
+	return FIRBankReset(bank, dev);
+}
+
+/*
+ * \brief Clear the history of every channel.
+ */
+int FIRBankReset(FIRBank *bank, FIRDevice *dev)
+{
+	cl_int ret;
+	cl_float *zero = (cl_float *) calloc(bank->stride * bank->numChannel,
+			sizeof(cl_float));
+
+	bank->block = 0;
+	ret = clEnqueueWriteBuffer(dev->queue, bank->window[0], CL_TRUE, 0,
+			sizeof(cl_float) * bank->stride * bank->numChannel, zero,
+			0, NULL, NULL);
+	free(zero);
+	CHECK_STATUS( ret,"Error: Reset bank history\n");
+
+	return 0;
+}
+
+/*
+ * \brief Filter one block of every channel.
+ *
+ * input and output are numChannel rows of numData samples.  The block is
+ * uploaded with a single rectangular write behind each channel's history,
+ * filtered with a single launch and read back with a single read.  If event
+ * is not NULL it receives the kernel event (the caller releases it).
+ * output = NULL leaves the block in bank->outputBuffer for further kernels.
+ */
+int FIRBankProcess(FIRBank *bank, FIRDevice *dev, const cl_float *input,
+		cl_float *output, cl_event *event)
+{
+	cl_int ret;
+	cl_mem cur = bank->window[bank->block & 1];
+	cl_mem next = bank->window[(bank->block + 1) & 1];
+
+	/* Fill in the new samples behind the history of each channel */
+	size_t bufferOrigin[3] = {(bank->numTap - 1) * sizeof(cl_float), 0, 0};
+	size_t hostOrigin[3] = {0, 0, 0};
+	size_t region[3] = {bank->numData * sizeof(cl_float), bank->numChannel, 1};
+	ret = clEnqueueWriteBufferRect(dev->queue, cur, CL_FALSE,
+			bufferOrigin, hostOrigin, region,
+			bank->stride * sizeof(cl_float), 0,
+			bank->numData * sizeof(cl_float), 0,
+			input, 0, NULL, NULL);
+	CHECK_STATUS( ret,"Error: Write bank input\n");
+
+	ret = clSetKernelArg(bank->kernel, 3, sizeof(cl_mem), (void *)&cur);
+	ret |= clSetKernelArg(bank->kernel, 4, sizeof(cl_mem), (void *)&next);
+	CHECK_STATUS( ret,"Error: Set bank window arguments\n");
+
+	size_t localThreads[2] = {64, 1};
+	size_t globalThreads[2] = {(bank->numData + 63) / 64 * 64, bank->numChannel};
+	ret = clEnqueueNDRangeKernel(dev->queue, bank->kernel, 2, NULL,
+			globalThreads, localThreads, 0, NULL, event);
+	CHECK_STATUS( ret,"Error: Range kernel. (FIR_bank)\n");
+
+	if (output)
+	{
+		ret = clEnqueueReadBuffer(dev->queue, bank->outputBuffer, CL_TRUE, 0,
+				sizeof(cl_float) * bank->numData * bank->numChannel, output,
+				0, NULL, NULL);
+		CHECK_STATUS( ret,"Error: Read bank output\n");
+	}
+
+	bank->block++;
+	return 0;
+}
+
+void FIRBankRelease(FIRBank *bank)
+{
+	clReleaseKernel(bank->kernel);
+	clReleaseMemObject(bank->outputBuffer);
+	clReleaseMemObject(bank->window[1]);
+	clReleaseMemObject(bank->window[0]);
+	clReleaseMemObject(bank->historyOffsetBuffer);
+	clReleaseMemObject(bank->coeffOffsetBuffer);
+	clReleaseMemObject(bank->coeffBuffer);
+}
+
+/*
+ * \brief Run numBlocks blocks of a numChannel filter bank and check every
+ * channel against the serial CPU filter over the whole stream.
+ */
+int RunFIRBank(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		cl_uint numBlocks, cl_uint numChannel)
+{
+	cl_uint ch, b, i;
+	size_t numStream = (size_t)numData * numBlocks;
+
+	printf("FIR Filter Bank\n Channels : %u \n Blocks : %u\n", numChannel, numBlocks);
+
+	/* Channel-major streams: stream[ch * numStream + t] */
+	cl_float *stream = (cl_float *) malloc(numStream * numChannel * sizeof(cl_float));
+	cl_float *result = (cl_float *) malloc(numStream * numChannel * sizeof(cl_float));
+	cl_float *coeff = (cl_float *) malloc(numTap * numChannel * sizeof(cl_float));
+	cl_float *block = (cl_float *) malloc(numData * numChannel * sizeof(cl_float));
+	cl_float *out = (cl_float *) malloc(numData * numChannel * sizeof(cl_float));
+
+	for (i = 0; i < numStream * numChannel; i++)
+		stream[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+	for (i = 0; i < numTap * numChannel; i++)
+		coeff[i] = 1.0f * rand() / RAND_MAX / numTap;
+
+	FIRBank bank;
+	if (FIRBankCreate(&bank, dev, numChannel, numTap, numData, coeff,
+				numChannel, NULL))
+		return 1;
+
+	double kernelTime = 0;
+	for (b = 0; b < numBlocks; b++)
+	{
+		for (ch = 0; ch < numChannel; ch++)
+			memcpy(block + ch * numData,
+					stream + ch * numStream + b * numData,
+					numData * sizeof(cl_float));
+
+		cl_event event;
+		if (FIRBankProcess(&bank, dev, block, out, &event))
+			return 1;
+		kernelTime += FIREventTime(event);
+		clReleaseEvent(event);
+
+		for (ch = 0; ch < numChannel; ch++)
+			memcpy(result + ch * numStream + b * numData,
+					out + ch * numData,
+					numData * sizeof(cl_float));
+	}
+	FIRBankRelease(&bank);
+
+	fprintf(stderr, "\tBank kernel time: %8.2f us per block (%u channels x %u samples)\n",
+			kernelTime / numBlocks, numChannel, numData);
+	fprintf(stderr, "\tThroughput: %8.2f Msamples/s\n",
+			1.0 * numStream * numChannel / kernelTime);
+
+	// One CPU filter, and its threads, for every channel's reference
+	FIRCpu fc;
+	if (FIRCpuCreate(&fc, numTap, coeff, 0, FIRCpuDetect()))
+		return 1;
+	int failed = 0;
+	for (ch = 0; ch < numChannel && !failed; ch++)
+	{
+		float *cpu_out = cpu_compute_with(&fc, coeff + ch * numTap,
+				stream + ch * numStream, numStream);
+		if (FIRVerify(cpu_out, result + ch * numStream, numStream, 1e-4f))
+		{
+			printf("Channel %u mismatch\n", ch);
+			failed = 1;
+		}
+		free(cpu_out);
+	}
+	FIRCpuRelease(&fc);
+	if (failed)
+		printf("FIR Bank Fail\n");
+	else
+		printf("FIR Bank Successful\n");
+
+	free(stream);
+	free(result);
+	free(coeff);
+	free(block);
+	free(out);
+	return failed;
+}
@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <CL/cl.h>
+#include "FIR.h"
+
+
+/* Largest scan work group, and the shortest run one work item scans */
+#define FIR_BOXCAR_GROUP 256
+#define FIR_BOXCAR_MIN_ITEM 4
+
+/*
+ * \brief Create a moving average over numTap samples for blocks of numData.
+ *
+ * The window is scanned by groupSize work items of perItem samples each;
+ * perItem grows with the window so the group totals always fit the single
+ * work group of FIR_boxcar_group.
+ */
+int FIRBoxcarCreate(FIRBoxcar *bx, FIRDevice *dev, cl_uint numTap, cl_uint numData)
+{
+	cl_int ret;
+
+	memset(bx, 0, sizeof(*bx));
+	if (!numTap)
+	{
+		printf("Error: moving average needs at least one tap\n");
+		return 1;
+	}
+
+	size_t maxGroup = 0;
+	clGetDeviceInfo(dev->device, CL_DEVICE_MAX_WORK_GROUP_SIZE,
+			sizeof(size_t), &maxGroup, NULL);
+	bx->groupSize = 1;
+	while (bx->groupSize * 2 <= FIR_BOXCAR_GROUP && bx->groupSize * 2 <= maxGroup)
+		bx->groupSize *= 2;
+
+	cl_uint G = bx->groupSize;
+	bx->numTap = numTap;
+	bx->numData = numData;
+	bx->len = numTap - 1 + numData;
+	bx->perItem = (cl_uint)(((size_t)bx->len + (size_t)G * G - 1) / ((size_t)G * G));
+	if (bx->perItem < FIR_BOXCAR_MIN_ITEM)
+		bx->perItem = FIR_BOXCAR_MIN_ITEM;
+	cl_uint groupLen = G * bx->perItem;
+	bx->numGroup = (bx->len + groupLen - 1) / groupLen;
+
+	size_t winBytes = sizeof(cl_float) * bx->len;
+	bx->window[0] = clCreateBuffer(dev->context, CL_MEM_READ_WRITE, winBytes, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create moving average window Buffer\n");
+	bx->window[1] = clCreateBuffer(dev->context, CL_MEM_READ_WRITE, winBytes, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create moving average window Buffer\n");
+	bx->prefix = clCreateBuffer(dev->context, CL_MEM_READ_WRITE,
+			sizeof(cl_float2) * bx->len, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create prefix Buffer\n");
+	bx->groupSum = clCreateBuffer(dev->context, CL_MEM_READ_WRITE,
+			sizeof(cl_float2) * bx->numGroup, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create group sum Buffer\n");
+	bx->outputBuffer = clCreateBuffer(dev->context, CL_MEM_WRITE_ONLY,
+			sizeof(cl_float) * numData, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create moving average output Buffer\n");
+
+	bx->scan = clCreateKernel(dev->program, "FIR_boxcar_scan", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (FIR_boxcar_scan)\n");
+	bx->group = clCreateKernel(dev->program, "FIR_boxcar_group", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (FIR_boxcar_group)\n");
+	bx->kernel = clCreateKernel(dev->program, "FIR_boxcar", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (FIR_boxcar)\n");
+
+	ret = clSetKernelArg(bx->scan, 1, sizeof(cl_mem), (void *)&bx->prefix);
+	ret |= clSetKernelArg(bx->scan, 2, sizeof(cl_mem), (void *)&bx->groupSum);
+	ret |= clSetKernelArg(bx->scan, 3, sizeof(cl_float2) * G, NULL);
+	ret |= clSetKernelArg(bx->scan, 4, sizeof(cl_uint), (void *)&bx->len);
+	ret |= clSetKernelArg(bx->scan, 5, sizeof(cl_uint), (void *)&bx->perItem);
+	ret |= clSetKernelArg(bx->group, 0, sizeof(cl_mem), (void *)&bx->groupSum);
+	ret |= clSetKernelArg(bx->group, 1, sizeof(cl_float2) * G, NULL);
+	ret |= clSetKernelArg(bx->group, 2, sizeof(cl_uint), (void *)&bx->numGroup);
+	ret |= clSetKernelArg(bx->kernel, 0, sizeof(cl_mem), (void *)&bx->outputBuffer);
+	ret |= clSetKernelArg(bx->kernel, 1, sizeof(cl_mem), (void *)&bx->prefix);
+	ret |= clSetKernelArg(bx->kernel, 2, sizeof(cl_mem), (void *)&bx->groupSum);
+	ret |= clSetKernelArg(bx->kernel, 3, sizeof(cl_uint), (void *)&numTap);
+	ret |= clSetKernelArg(bx->kernel, 4, sizeof(cl_uint), (void *)&numData);
+	ret |= clSetKernelArg(bx->kernel, 5, sizeof(cl_uint), (void *)&groupLen);
+	CHECK_STATUS( ret,"Error: Set moving average kernel arguments\n");
+
+	return FIRBoxcarReset(bx, dev);
+}
+
+/*
+ * \brief Clear the history.
+ */
+int FIRBoxcarReset(FIRBoxcar *bx, FIRDevice *dev)
+{
+	cl_int ret = CL_SUCCESS;
+
+	bx->block = 0;
+	if (bx->numTap > 1)
+	{
+		cl_float *zero = (cl_float *) calloc(bx->numTap - 1, sizeof(cl_float));
+		ret = clEnqueueWriteBuffer(dev->queue, bx->window[0], CL_TRUE, 0,
+				sizeof(cl_float) * (bx->numTap - 1), zero, 0, NULL, NULL);
+		free(zero);
+	}
+	CHECK_STATUS( ret,"Error: Reset moving average history\n");
+
+	return 0;
+}
+
+static int EnqueueTimed(FIRDevice *dev, cl_kernel kernel, size_t global,
+		size_t local, double *time)
+{
+	cl_event event;
+	size_t globalThreads[1] = {global};
+	size_t localThreads[1] = {local};
+	cl_int ret = clEnqueueNDRangeKernel(dev->queue, kernel, 1, NULL,
+			globalThreads, localThreads, 0, NULL, &event);
+	CHECK_STATUS( ret,"Error: Range kernel. (moving average)\n");
+	if (time)
+		*time += FIREventTime(event);
+	clReleaseEvent(event);
+	return 0;
+}
+
+/*
+ * \brief Average one block of numData samples, carrying the history over
+ * from the previous block.  The kernel time of the three launches is added
+ * to *time when time is not NULL.
+ */
+int FIRBoxcarProcess(FIRBoxcar *bx, FIRDevice *dev, const cl_float *input,
+		cl_float *output, double *time)
+{
+	cl_int ret;
+	cl_mem cur = bx->window[bx->block & 1];
+	cl_mem next = bx->window[(bx->block + 1) & 1];
+	size_t G = bx->groupSize;
+
+	ret = clEnqueueWriteBuffer(dev->queue, cur, CL_FALSE,
+			sizeof(cl_float) * (bx->numTap - 1), sizeof(cl_float) * bx->numData,
+			input, 0, NULL, NULL);
+	CHECK_STATUS( ret,"Error: Write moving average input\n");
+
+	// Next block's history is the tail of this window
+	if (bx->numTap > 1)
+	{
+		ret = clEnqueueCopyBuffer(dev->queue, cur, next,
+				sizeof(cl_float) * bx->numData, 0,
+				sizeof(cl_float) * (bx->numTap - 1), 0, NULL, NULL);
+		CHECK_STATUS( ret,"Error: Copy moving average history\n");
+	}
+
+	ret = clSetKernelArg(bx->scan, 0, sizeof(cl_mem), (void *)&cur);
+	CHECK_STATUS( ret,"Error: Set scan input\n");
+	if (EnqueueTimed(dev, bx->scan, G * bx->numGroup, G, time) ||
+			EnqueueTimed(dev, bx->group, G, G, time) ||
+			EnqueueTimed(dev, bx->kernel, (bx->numData + 63) / 64 * 64, 64, time))
+		return 1;
+
+	ret = clEnqueueReadBuffer(dev->queue, bx->outputBuffer, CL_TRUE, 0,
+			sizeof(cl_float) * bx->numData, output, 0, NULL, NULL);
+	CHECK_STATUS( ret,"Error: Read moving average output\n");
+
+	bx->block++;
+	return 0;
+}
+
+void FIRBoxcarRelease(FIRBoxcar *bx)
+{
+	clReleaseKernel(bx->scan);
+	clReleaseKernel(bx->group);
+	clReleaseKernel(bx->kernel);
+	clReleaseMemObject(bx->outputBuffer);
+	clReleaseMemObject(bx->groupSum);
+	clReleaseMemObject(bx->prefix);
+	clReleaseMemObject(bx->window[1]);
+	clReleaseMemObject(bx->window[0]);
+}
+
+/*
+ * \brief Average numBlocks blocks of numData samples over numTap samples,
+ * time one block of the same filter through the generic FIR kernel, and
+ * check the stream against a double-precision running sum.
+ */
+int RunFIRBoxcar(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		cl_uint numBlocks)
+{
+	size_t i;
+	cl_uint b;
+	size_t numStream = (size_t)numData * numBlocks;
+
+	cl_float *stream = (cl_float *) malloc(numStream * sizeof(cl_float));
+	cl_float *result = (cl_float *) malloc(numStream * sizeof(cl_float));
+	for (i = 0; i < numStream; i++)
+		stream[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+
+	FIRBoxcar bx;
+	if (FIRBoxcarCreate(&bx, dev, numTap, numData))
+		return 1;
+	printf("FIR Filter (moving average)\n Window : %u samples \n Scan : %u groups x %u items x %u samples \n Blocks : %u\n",
+			numTap, bx.numGroup, bx.groupSize, bx.perItem, numBlocks);
+
+	double time = 0;
+	for (b = 0; b < numBlocks; b++)
+		if (FIRBoxcarProcess(&bx, dev, stream + (size_t)b * numData,
+					result + (size_t)b * numData, &time))
+			return 1;
+	FIRBoxcarRelease(&bx);
+
+	fprintf(stderr, "\tKernel exec time: %8.2f us per block\n", time / numBlocks);
+	fprintf(stderr, "\tThroughput: %8.2f Msamples/s\n", numStream / time);
+
+	// The same filter as numTap taps of 1/numTap through the FIR kernel
+	cl_float *coeff = (cl_float *) malloc(numTap * sizeof(cl_float));
+	cl_float *direct = (cl_float *) malloc(numData * sizeof(cl_float));
+	for (i = 0; i < numTap; i++)
+		coeff[i] = 1.0f / numTap;
+	FIRVariant variant = numData % 64 ? FIR_VARIANT_SYMMETRIC : FIR_VARIANT_DIRECT;
+	double directTime = 0;
+	if (!FIRRunVariant(dev, variant, numTap, numData, coeff, stream, direct,
+				1, &directTime))
+		fprintf(stderr, "\t%s kernel: %8.2f us per block (%.2fx)\n",
+				FIRVariantName[variant], directTime, directTime * numBlocks / time);
+
+	// Reference: running sum over the whole stream in double
+	float *cpu_out = (float *) malloc(numStream * sizeof(float));
+	double sum = 0;
+	for (i = 0; i < numStream; i++)
+	{
+		sum += stream[i];
+		if (i >= numTap)
+			sum -= stream[i - numTap];
+		cpu_out[i] = sum / numTap;
+	}
+	int failed = FIRVerify(cpu_out, result, numStream, 1e-5f);
+	printf(failed ? "FIR Fail\n" : "FIR Successful\n");
+
+	free(cpu_out);
+	free(coeff);
+	free(direct);
+	free(stream);
+	free(result);
+	return failed;
+}
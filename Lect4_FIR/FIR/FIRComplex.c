@@ -0,0 +1,222 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <CL/cl.h>
+#include "FIR.h"
+
+
+/* Buffers per window and floats per sample in each of them */
+#define NUM_PLANE(fc)  ((fc)->layout == FIR_IQ_SPLIT ? 2 : 1)
+#define SAMPLE_SIZE(fc) (sizeof(cl_float) * ((fc)->layout == FIR_IQ_SPLIT ? 1 : 2))
+
+/*
+ * \brief Create the buffers and kernel of a complex FIR filter.
+ *
+ * coeff holds numTap real taps, or numTap (re, im) pairs if complexTap.
+ */
+int FIRComplexCreate(FIRComplex *fc, FIRDevice *dev, FIRIQLayout layout,
+		cl_uint numTap, cl_uint numData, const cl_float *coeff, int complexTap)
+{
+	cl_int ret;
+	int b, p;
+
+	memset(fc, 0, sizeof(*fc));
+	fc->layout = layout;
+	fc->complexTap = complexTap;
+	fc->numTap = numTap;
+	fc->numData = numData;
+
+	fc->coeffBuffer = clCreateBuffer(dev->context,
+			CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			sizeof(cl_float) * numTap * (complexTap ? 2 : 1), (void *)coeff, &ret);
+	CHECK_STATUS( ret,"Error: Create complex coeff Buffer\n");
+
+	size_t winBytes = SAMPLE_SIZE(fc) * (numData + numTap - 1);
+	for (b = 0; b < 2; b++)
+		for (p = 0; p < NUM_PLANE(fc); p++)
+		{
+			fc->window[b][p] = clCreateBuffer(dev->context, CL_MEM_READ_WRITE,
+					winBytes, NULL, &ret);
+			CHECK_STATUS( ret,"Error: Create complex window Buffer\n");
+		}
+	for (p = 0; p < NUM_PLANE(fc); p++)
+	{
+		fc->outputBuffer[p] = clCreateBuffer(dev->context, CL_MEM_WRITE_ONLY,
+				SAMPLE_SIZE(fc) * numData, NULL, &ret);
+		CHECK_STATUS( ret,"Error: Create complex output Buffer\n");
+	}
+
+	const char *name = layout == FIR_IQ_SPLIT ?
+		(complexTap ? "FIR_complex_split_ctap" : "FIR_complex_split_rtap") :
+		(complexTap ? "FIR_complex_ctap" : "FIR_complex_rtap");
+	fc->kernel = clCreateKernel(dev->program, name, &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (FIR_complex)\n");
+
+	// Split kernels take two outputs and two windows
+	cl_uint arg = 0;
+	ret = CL_SUCCESS;
+	for (p = 0; p < NUM_PLANE(fc); p++)
+		ret |= clSetKernelArg(fc->kernel, arg++, sizeof(cl_mem), (void *)&fc->outputBuffer[p]);
+	ret |= clSetKernelArg(fc->kernel, arg++, sizeof(cl_mem), (void *)&fc->coeffBuffer);
+	arg += NUM_PLANE(fc);
+	ret |= clSetKernelArg(fc->kernel, arg++, sizeof(cl_uint), (void *)&numTap);
+	ret |= clSetKernelArg(fc->kernel, arg++, sizeof(cl_uint), (void *)&numData);
+	CHECK_STATUS( ret,"Error: Set complex kernel arguments\n");
+
+	return FIRComplexReset(fc, dev);
+}
+
+/*
+ * \brief Clear the history.
+ */
+int FIRComplexReset(FIRComplex *fc, FIRDevice *dev)
+{
+	cl_int ret = CL_SUCCESS;
+	int p;
+
+	fc->block = 0;
+	if (fc->numTap > 1)
+	{
+		cl_float *zero = (cl_float *) calloc(2 * (fc->numTap - 1), sizeof(cl_float));
+		for (p = 0; p < NUM_PLANE(fc); p++)
+			ret |= clEnqueueWriteBuffer(dev->queue, fc->window[0][p], CL_TRUE, 0,
+					SAMPLE_SIZE(fc) * (fc->numTap - 1), zero, 0, NULL, NULL);
+		free(zero);
+	}
+	CHECK_STATUS( ret,"Error: Reset complex history\n");
+
+	return 0;
+}
+
+/*
+ * \brief Filter one block of numData complex samples in the layout of the
+ * filter.  If event is not NULL it receives the kernel event (the caller
+ * releases it).
+ */
+int FIRComplexProcess(FIRComplex *fc, FIRDevice *dev, const cl_float *input,
+		cl_float *output, cl_event *event)
+{
+	cl_int ret = CL_SUCCESS;
+	cl_mem *cur = fc->window[fc->block & 1];
+	cl_mem *next = fc->window[(fc->block + 1) & 1];
+	size_t histBytes = SAMPLE_SIZE(fc) * (fc->numTap - 1);
+	size_t dataBytes = SAMPLE_SIZE(fc) * fc->numData;
+	int p;
+
+	for (p = 0; p < NUM_PLANE(fc); p++)
+	{
+		ret |= clEnqueueWriteBuffer(dev->queue, cur[p], CL_FALSE, histBytes,
+				dataBytes, (const char *)input + p * dataBytes, 0, NULL, NULL);
+
+		// Next block's history is the tail of this window
+		if (fc->numTap > 1)
+			ret |= clEnqueueCopyBuffer(dev->queue, cur[p], next[p],
+					dataBytes, 0, histBytes, 0, NULL, NULL);
+
+		ret |= clSetKernelArg(fc->kernel, NUM_PLANE(fc) + 1 + p,
+				sizeof(cl_mem), (void *)&cur[p]);
+	}
+	CHECK_STATUS( ret,"Error: Write complex input\n");
+
+	size_t local = 64;
+	size_t localThreads[1] = {local};
+	size_t globalThreads[1] = {(fc->numData + local - 1) / local * local};
+	ret = clEnqueueNDRangeKernel(dev->queue, fc->kernel, 1, NULL,
+			globalThreads, localThreads, 0, NULL, event);
+	CHECK_STATUS( ret,"Error: Range kernel. (FIR_complex)\n");
+
+	for (p = 0; p < NUM_PLANE(fc); p++)
+		ret |= clEnqueueReadBuffer(dev->queue, fc->outputBuffer[p], CL_TRUE, 0,
+				dataBytes, (char *)output + p * dataBytes, 0, NULL, NULL);
+	CHECK_STATUS( ret,"Error: Read complex output\n");
+
+	fc->block++;
+	return 0;
+}
+
+void FIRComplexRelease(FIRComplex *fc)
+{
+	int b, p;
+
+	clReleaseKernel(fc->kernel);
+	for (p = 0; p < NUM_PLANE(fc); p++)
+	{
+		clReleaseMemObject(fc->outputBuffer[p]);
+		for (b = 0; b < 2; b++)
+			clReleaseMemObject(fc->window[b][p]);
+	}
+	clReleaseMemObject(fc->coeffBuffer);
+}
+
+/*
+ * \brief Filter numBlocks blocks of an IQ stream and check the whole stream
+ * against cpu_compute_complex.
+ */
+int RunFIRComplex(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		cl_uint numBlocks, FIRIQLayout layout, int complexTap)
+{
+	cl_uint i, b;
+	size_t numStream = (size_t)numData * numBlocks;
+
+	printf("FIR Filter (complex, %s taps, %s)\n Blocks : %u\n",
+			complexTap ? "complex" : "real",
+			layout == FIR_IQ_SPLIT ? "split planes" : "interleaved", numBlocks);
+
+	/* Interleaved (I, Q) stream and result */
+	cl_float *stream = (cl_float *) malloc(2 * numStream * sizeof(cl_float));
+	cl_float *result = (cl_float *) malloc(2 * numStream * sizeof(cl_float));
+	cl_float *coeff = (cl_float *) malloc(2 * numTap * sizeof(cl_float));
+	cl_float *block = (cl_float *) malloc(2 * numData * sizeof(cl_float));
+	cl_float *out = (cl_float *) malloc(2 * numData * sizeof(cl_float));
+	for (i = 0; i < 2 * numStream; i++)
+		stream[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+	for (i = 0; i < 2 * numTap; i++)
+		coeff[i] = 1.0f * rand() / RAND_MAX / numTap;
+
+	FIRComplex fc;
+	if (FIRComplexCreate(&fc, dev, layout, numTap, numData, coeff, complexTap))
+		return 1;
+
+	double kernelTime = 0;
+	for (b = 0; b < numBlocks; b++)
+	{
+		cl_float *in = stream + 2 * (size_t)b * numData;
+		cl_float *res = result + 2 * (size_t)b * numData;
+		cl_event event;
+
+		if (layout == FIR_IQ_SPLIT)
+			for (i = 0; i < numData; i++)
+			{
+				block[i] = in[2 * i];
+				block[numData + i] = in[2 * i + 1];
+			}
+		if (FIRComplexProcess(&fc, dev, layout == FIR_IQ_SPLIT ? block : in,
+					layout == FIR_IQ_SPLIT ? out : res, &event))
+			return 1;
+		kernelTime += FIREventTime(event);
+		clReleaseEvent(event);
+		if (layout == FIR_IQ_SPLIT)
+			for (i = 0; i < numData; i++)
+			{
+				res[2 * i] = out[i];
+				res[2 * i + 1] = out[numData + i];
+			}
+	}
+	FIRComplexRelease(&fc);
+
+	fprintf(stderr, "\tKernel exec time: %8.2f us per block\n", kernelTime / numBlocks);
+	fprintf(stderr, "\tThroughput: %8.2f Msamples/s\n", numStream / kernelTime);
+
+	float *cpu_out = cpu_compute_complex(stream, coeff, numTap, numStream, complexTap);
+	int failed = FIRVerify(cpu_out, result, 2 * numStream, 1e-4f);
+	printf(failed ? "FIR Fail\n" : "FIR Successful\n");
+
+	free(cpu_out);
+	free(stream);
+	free(result);
+	free(coeff);
+	free(block);
+	free(out);
+	return failed;
+}
@@ -0,0 +1,415 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <CL/cl.h>
+#include "FIR.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FIR_CPU_X86
+#endif
+
+
+const char *FIRCpuISAName[FIR_CPU_NUM_ISA] = {
+	"scalar",
+	"avx2",
+	"avx512",
+};
+
+/* Blocks smaller than this per thread are not worth a thread */
+#define FIR_CPU_MIN_CHUNK 4096
+
+/*
+ * out[k] = sum_i coeff[i] * x[k + i] for k < count.
+ * Every implementation vectorizes across outputs and accumulates each output
+ * in tap order with a separate multiply and add, so all of them round
+ * exactly like the scalar loop.
+ */
+static void FIRRangeScalar(const float *x, const float *coeff, cl_uint numTap,
+		float *out, size_t count)
+{
+	size_t k;
+	cl_uint i;
+
+	for (k = 0; k < count; k++)
+	{
+		float sum = 0.f;
+		for (i = 0; i < numTap; i++)
+			sum += coeff[i] * x[k + i];
+		out[k] = sum;
+	}
+}
+
+#ifdef FIR_CPU_X86
+__attribute__((target("avx2")))
+static void FIRRangeAVX2(const float *x, const float *coeff, cl_uint numTap,
+		float *out, size_t count)
+{
+	size_t k = 0;
+	cl_uint i;
+
+	// Two registers of outputs per pass to hide the add latency
+	for (; k + 16 <= count; k += 16)
+	{
+		__m256 sum0 = _mm256_setzero_ps();
+		__m256 sum1 = _mm256_setzero_ps();
+		for (i = 0; i < numTap; i++)
+		{
+			__m256 c = _mm256_broadcast_ss(coeff + i);
+			sum0 = _mm256_add_ps(sum0, _mm256_mul_ps(c, _mm256_loadu_ps(x + k + i)));
+			sum1 = _mm256_add_ps(sum1, _mm256_mul_ps(c, _mm256_loadu_ps(x + k + i + 8)));
+		}
+		_mm256_storeu_ps(out + k, sum0);
+		_mm256_storeu_ps(out + k + 8, sum1);
+	}
+	FIRRangeScalar(x + k, coeff, numTap, out + k, count - k);
+}
+
+__attribute__((target("avx512f")))
+static void FIRRangeAVX512(const float *x, const float *coeff, cl_uint numTap,
+		float *out, size_t count)
+{
+	size_t k = 0;
+	cl_uint i;
+
+	for (; k + 32 <= count; k += 32)
+	{
+		__m512 sum0 = _mm512_setzero_ps();
+		__m512 sum1 = _mm512_setzero_ps();
+		for (i = 0; i < numTap; i++)
+		{
+			__m512 c = _mm512_set1_ps(coeff[i]);
+			sum0 = _mm512_add_ps(sum0, _mm512_mul_ps(c, _mm512_loadu_ps(x + k + i)));
+			sum1 = _mm512_add_ps(sum1, _mm512_mul_ps(c, _mm512_loadu_ps(x + k + i + 16)));
+		}
+		_mm512_storeu_ps(out + k, sum0);
+		_mm512_storeu_ps(out + k + 16, sum1);
+	}
+	FIRRangeAVX2(x + k, coeff, numTap, out + k, count - k);
+}
+#endif
+
+static void FIRRange(FIRCpuISA isa, const float *x, const float *coeff,
+		cl_uint numTap, float *out, size_t count)
+{
+#ifdef FIR_CPU_X86
+	if (isa == FIR_CPU_AVX512)
+		FIRRangeAVX512(x, coeff, numTap, out, count);
+	else if (isa == FIR_CPU_AVX2)
+		FIRRangeAVX2(x, coeff, numTap, out, count);
+	else
+#endif
+		FIRRangeScalar(x, coeff, numTap, out, count);
+}
+
+/*
+ * \brief Widest instruction set this CPU supports.
+ */
+FIRCpuISA FIRCpuDetect(void)
+{
+#ifdef FIR_CPU_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f"))
+		return FIR_CPU_AVX512;
+	if (__builtin_cpu_supports("avx2"))
+		return FIR_CPU_AVX2;
+#endif
+	return FIR_CPU_SCALAR;
+}
+
+typedef struct {
+	FIRCpu *fc;
+	const float *x;
+	float *out;
+	size_t count;
+} FIRCpuChunk;
+
+/*
+ * Workers sleep on start until a block is handed out, then take chunks
+ * until none are left; the caller takes chunks too and sleeps on done
+ * until the last one is finished.
+ */
+struct FIRCpuPool {
+	pthread_mutex_t lock;
+	pthread_cond_t start;
+	pthread_cond_t done;
+	unsigned long round;     /* blocks handed out so far */
+	int quit;
+	int numWorker;           /* threads that were started */
+	pthread_t *thread;
+	FIRCpuChunk *chunk;      /* numThread slots */
+	int numChunk;            /* chunks of the current block */
+	int next;                /* first chunk nobody has taken */
+	int remaining;           /* chunks not finished yet */
+};
+
+static void FIRCpuRunChunk(FIRCpuChunk *chunk)
+{
+	FIRRange(chunk->fc->isa, chunk->x, chunk->fc->coeff, chunk->fc->numTap,
+			chunk->out, chunk->count);
+}
+
+/* With pool->lock held: run chunks until none are left to take */
+static void FIRCpuTakeChunks(struct FIRCpuPool *pool)
+{
+	while (pool->next < pool->numChunk)
+	{
+		FIRCpuChunk *chunk = &pool->chunk[pool->next++];
+		pthread_mutex_unlock(&pool->lock);
+		FIRCpuRunChunk(chunk);
+		pthread_mutex_lock(&pool->lock);
+		if (--pool->remaining == 0)
+			pthread_cond_signal(&pool->done);
+	}
+}
+
+static void *FIRCpuWorker(void *arg)
+{
+	struct FIRCpuPool *pool = (struct FIRCpuPool *) arg;
+	unsigned long seen = 0;
+
+	pthread_mutex_lock(&pool->lock);
+	for (;;)
+	{
+		while (!pool->quit && pool->round == seen)
+			pthread_cond_wait(&pool->start, &pool->lock);
+		if (pool->quit)
+			break;
+		seen = pool->round;
+		FIRCpuTakeChunks(pool);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+/*
+ * Start numThread-1 workers.  If some cannot be started the pool runs with
+ * fewer, down to none, in which case the caller does all the work.
+ */
+static struct FIRCpuPool *FIRCpuPoolCreate(int numThread)
+{
+	int t;
+	struct FIRCpuPool *pool = (struct FIRCpuPool *) calloc(1, sizeof(*pool));
+	if (!pool)
+		return NULL;
+	pool->thread = (pthread_t *) malloc(numThread * sizeof(pthread_t));
+	pool->chunk = (FIRCpuChunk *) malloc(numThread * sizeof(FIRCpuChunk));
+	if (!pool->thread || !pool->chunk)
+	{
+		free(pool->thread);
+		free(pool->chunk);
+		free(pool);
+		return NULL;
+	}
+	pthread_mutex_init(&pool->lock, NULL);
+	pthread_cond_init(&pool->start, NULL);
+	pthread_cond_init(&pool->done, NULL);
+
+	for (t = 1; t < numThread; t++)
+		if (!pthread_create(&pool->thread[pool->numWorker], NULL, FIRCpuWorker, pool))
+			pool->numWorker++;
+	return pool;
+}
+
+static void FIRCpuPoolRelease(struct FIRCpuPool *pool)
+{
+	int t;
+
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = 1;
+	pthread_cond_broadcast(&pool->start);
+	pthread_mutex_unlock(&pool->lock);
+	for (t = 0; t < pool->numWorker; t++)
+		pthread_join(pool->thread[t], NULL);
+
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->start);
+	pthread_mutex_destroy(&pool->lock);
+	free(pool->chunk);
+	free(pool->thread);
+	free(pool);
+}
+
+/*
+ * \brief Set up a CPU filter.  numThread = 0 uses every online CPU.
+ *
+ * Only the numTap-1 history samples are kept between blocks, plus a
+ * 2*(numTap-1) stitch buffer for the outputs that straddle the history and
+ * the new block; the rest of the block is filtered in place.
+ */
+int FIRCpuCreate(FIRCpu *fc, cl_uint numTap, const float *coeff,
+		int numThread, FIRCpuISA isa)
+{
+	memset(fc, 0, sizeof(*fc));
+	if (numThread <= 0)
+		numThread = sysconf(_SC_NPROCESSORS_ONLN);
+	if (numThread <= 0)
+		numThread = 1;
+
+	fc->numTap = numTap;
+	fc->numThread = numThread;
+	fc->isa = isa;
+	fc->coeff = (float *) malloc(numTap * sizeof(float));
+	fc->history = (float *) calloc(numTap, sizeof(float));
+	fc->stitch = (float *) malloc(2 * numTap * sizeof(float));
+	if (!fc->coeff || !fc->history || !fc->stitch)
+	{
+		printf("Error: allocate CPU filter\n");
+		return 1;
+	}
+	memcpy(fc->coeff, coeff, numTap * sizeof(float));
+
+	if (numThread > 1)
+	{
+		fc->pool = FIRCpuPoolCreate(numThread);
+		if (!fc->pool)
+		{
+			printf("Error: start CPU filter threads\n");
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+void FIRCpuReset(FIRCpu *fc)
+{
+	memset(fc->history, 0, fc->numTap * sizeof(float));
+}
+
+/* New taps (numTap of them) and a cleared history, keeping the threads */
+void FIRCpuSetCoeff(FIRCpu *fc, const float *coeff)
+{
+	memcpy(fc->coeff, coeff, fc->numTap * sizeof(float));
+	FIRCpuReset(fc);
+}
+
+/*
+ * \brief Filter one block of numData samples, carrying the history over
+ * from the previous block.  The block size may change between calls.
+ */
+void FIRCpuProcess(FIRCpu *fc, const float *input, float *output, size_t numData)
+{
+	size_t numHist = fc->numTap - 1;
+	size_t head = numData < numHist ? numData : numHist;
+	size_t t;
+
+	// Outputs [0, head) read history: filter them from the stitch buffer
+	memcpy(fc->stitch, fc->history, numHist * sizeof(float));
+	memcpy(fc->stitch + numHist, input, head * sizeof(float));
+	FIRRange(fc->isa, fc->stitch, fc->coeff, fc->numTap, output, head);
+
+	// Outputs [head, numData) only read the new block
+	size_t count = numData - head;
+	const float *x = count ? input + head - numHist : input;
+	size_t numThread = fc->numThread;
+	if (count / FIR_CPU_MIN_CHUNK < numThread)
+		numThread = count / FIR_CPU_MIN_CHUNK > 0 ? count / FIR_CPU_MIN_CHUNK : 1;
+
+	if (count && (numThread == 1 || !fc->pool))
+		FIRRange(fc->isa, x, fc->coeff, fc->numTap, output + head, count);
+	else if (count)
+	{
+		struct FIRCpuPool *pool = fc->pool;
+		size_t per = (count + numThread - 1) / numThread;
+		per = (per + 31) / 32 * 32;
+
+		// Hand the chunks to the workers, which are idle between blocks;
+		// the calling thread takes chunks as well
+		pthread_mutex_lock(&pool->lock);
+		for (t = 0; t < numThread; t++)
+		{
+			size_t first = t * per < count ? t * per : count;
+			pool->chunk[t].fc = fc;
+			pool->chunk[t].x = x + first;
+			pool->chunk[t].out = output + head + first;
+			pool->chunk[t].count = first + per < count ? per : count - first;
+		}
+		pool->numChunk = numThread;
+		pool->next = 0;
+		pool->remaining = numThread;
+		pool->round++;
+		pthread_cond_broadcast(&pool->start);
+		FIRCpuTakeChunks(pool);
+		while (pool->remaining)
+			pthread_cond_wait(&pool->done, &pool->lock);
+		pthread_mutex_unlock(&pool->lock);
+	}
+
+	// The last numTap-1 samples of history + block become the history
+	if (numData >= numHist)
+		memcpy(fc->history, input + numData - numHist, numHist * sizeof(float));
+	else
+	{
+		memmove(fc->history, fc->history + numData, (numHist - numData) * sizeof(float));
+		memcpy(fc->history + numHist - numData, input, numData * sizeof(float));
+	}
+}
+
+void FIRCpuRelease(FIRCpu *fc)
+{
+	if (fc->pool)
+		FIRCpuPoolRelease(fc->pool);
+	free(fc->coeff);
+	free(fc->history);
+	free(fc->stitch);
+}
+
+/*
+ * \brief Filter numBlocks blocks on the CPU only, no OpenCL device needed,
+ * and check the stream against the single-threaded scalar filter.
+ */
+int RunFIRCpu(cl_uint numTap, cl_uint numData, cl_uint numBlocks, int numThread)
+{
+	cl_uint i, b;
+	size_t numStream = (size_t)numData * numBlocks;
+
+	float *stream = (float *) malloc(numStream * sizeof(float));
+	float *result = (float *) malloc(numStream * sizeof(float));
+	float *ref = (float *) malloc(numStream * sizeof(float));
+	float *coeff = (float *) malloc(numTap * sizeof(float));
+	for (i = 0; i < numStream; i++)
+		stream[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+	for (i = 0; i < numTap; i++)
+		coeff[i] = 1.0f * rand() / RAND_MAX / numTap;
+
+	FIRCpu fc;
+	if (FIRCpuCreate(&fc, numTap, coeff, numThread, FIRCpuDetect()))
+		return 1;
+	printf("FIR Filter (CPU)\n ISA : %s \n Threads : %d \n Blocks : %u\n",
+			FIRCpuISAName[fc.isa], fc.numThread, numBlocks);
+
+	double start = WallTime();
+	for (b = 0; b < numBlocks; b++)
+		FIRCpuProcess(&fc, stream + (size_t)b * numData,
+				result + (size_t)b * numData, numData);
+	double time = WallTime() - start;
+	FIRCpuRelease(&fc);
+
+	fprintf(stderr, "\tCPU exec time: %8.2f us per block\n", time / numBlocks);
+	fprintf(stderr, "\tThroughput: %8.2f Msamples/s\n", numStream / time);
+
+	// Reference: whole stream in one call, one thread, no SIMD
+	FIRCpu scalar;
+	if (FIRCpuCreate(&scalar, numTap, coeff, 1, FIR_CPU_SCALAR))
+		return 1;
+	start = WallTime();
+	FIRCpuProcess(&scalar, stream, ref, numStream);
+	double scalarTime = WallTime() - start;
+	fprintf(stderr, "\tScalar time:   %8.2f us per block (%.2fx)\n",
+			scalarTime / numBlocks, scalarTime / time);
+	FIRCpuRelease(&scalar);
+
+	int failed = FIRVerify(ref, result, numStream, 0.f);
+	printf(failed ? "FIR Fail\n" : "FIR Successful\n");
+
+	free(stream);
+	free(result);
+	free(ref);
+	free(coeff);
+	return failed;
+}
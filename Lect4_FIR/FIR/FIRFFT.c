@@ -0,0 +1,402 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <CL/cl.h>
+#include "FIR.h"
+
+
+/*
+ * \brief Create the radix-4/radix-2 kernels for length N (a power of two).
+ */
+int FFTPlanCreate(FFTPlan *plan, FIRDevice *dev, cl_uint N)
+{
+	cl_int ret;
+
+	if (N < 2 || (N & (N - 1)))
+	{
+		printf("Error: FFT length %u is not a power of two\n", N);
+		return 1;
+	}
+	plan->N = N;
+	plan->radix2 = clCreateKernel(dev->program, "fft_radix2", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (fft_radix2)\n");
+	plan->radix4 = clCreateKernel(dev->program, "fft_radix4", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (fft_radix4)\n");
+
+	return 0;
+}
+
+/*
+ * \brief Transform batch consecutive length-N complex vectors in *data.
+ *
+ * Every pass ping-pongs between *data and *scratch; on return the handles
+ * are swapped if needed so that *data holds the result.  dir = -1 is the
+ * forward transform, +1 the unscaled inverse.  The kernel time of all the
+ * passes is added to *time when time is not NULL.
+ */
+int FFTEnqueue(FFTPlan *plan, FIRDevice *dev, cl_mem *data, cl_mem *scratch,
+		cl_uint batch, int dir, double *time)
+{
+	cl_int ret;
+	cl_uint Ns = 1;
+
+	while (Ns < plan->N)
+	{
+		cl_uint radix = plan->N / Ns >= 4 ? 4 : 2;
+		cl_kernel kernel = radix == 4 ? plan->radix4 : plan->radix2;
+
+		ret = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)data);
+		ret |= clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)scratch);
+		ret |= clSetKernelArg(kernel, 2, sizeof(cl_uint), (void *)&plan->N);
+		ret |= clSetKernelArg(kernel, 3, sizeof(cl_uint), (void *)&Ns);
+		ret |= clSetKernelArg(kernel, 4, sizeof(cl_int), (void *)&dir);
+		CHECK_STATUS( ret,"Error: Set FFT kernel arguments\n");
+
+		size_t numButterfly = plan->N / radix;
+		size_t localThreads[2] = {numButterfly < 64 ? numButterfly : 64, 1};
+		size_t globalThreads[2] = {numButterfly, batch};
+		cl_event event;
+		ret = clEnqueueNDRangeKernel(dev->queue, kernel, 2, NULL,
+				globalThreads, localThreads, 0, NULL, &event);
+		CHECK_STATUS( ret,"Error: Range kernel. (FFT pass)\n");
+		if (time)
+			*time += FIREventTime(event);
+		clReleaseEvent(event);
+
+		cl_mem swap = *data;
+		*data = *scratch;
+		*scratch = swap;
+		Ns *= radix;
+	}
+
+	return 0;
+}
+
+void FFTPlanRelease(FFTPlan *plan)
+{
+	clReleaseKernel(plan->radix2);
+	clReleaseKernel(plan->radix4);
+}
+
+/*
+ * \brief FFT length for overlap-save: about four times the filter, but no
+ * longer than one segment covering the whole block.
+ */
+cl_uint FIRFFTSize(cl_uint numTap, cl_uint numData)
+{
+	cl_uint N = 2;
+	cl_uint whole = 2;
+
+	while (N < 4 * numTap)
+		N *= 2;
+	while (whole < numData + numTap - 1)
+		whole *= 2;
+	if (whole < N)
+		N = whole;
+	while (N < 2 * numTap)
+		N *= 2;
+
+	return N;
+}
+
+/*
+ * \brief Set up overlap-save convolution of numData-sample blocks.
+ *
+ * The spectrum of the (reversed, zero-padded) taps is computed once here on
+ * the device; every block then costs one batched forward FFT, a pointwise
+ * product and one batched inverse FFT.  N = 0 picks FIRFFTSize.
+ */
+int FIRFFTCreate(FIRFFT *f, FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		const cl_float *coeff, cl_uint N)
+{
+	cl_int ret;
+	cl_uint i;
+
+	memset(f, 0, sizeof(*f));
+	f->numTap = numTap;
+	f->numData = numData;
+	f->N = N ? N : FIRFFTSize(numTap, numData);
+	if (f->N < numTap)
+	{
+		printf("Error: FFT length %u is shorter than the filter\n", f->N);
+		return 1;
+	}
+	f->L = f->N - numTap + 1;
+	f->numSeg = (numData + f->L - 1) / f->L;
+
+	if (FFTPlanCreate(&f->fft, dev, f->N))
+		return 1;
+
+	size_t segBytes = sizeof(cl_float2) * f->N * f->numSeg;
+	size_t winBytes = sizeof(cl_float) * (numData + numTap - 1);
+	f->segment = clCreateBuffer(dev->context, CL_MEM_READ_WRITE, segBytes, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create segment Buffer\n");
+	f->scratch = clCreateBuffer(dev->context, CL_MEM_READ_WRITE, segBytes, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create scratch Buffer\n");
+	f->window[0] = clCreateBuffer(dev->context, CL_MEM_READ_WRITE, winBytes, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create window Buffer\n");
+	f->window[1] = clCreateBuffer(dev->context, CL_MEM_READ_WRITE, winBytes, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create window Buffer\n");
+	f->outputBuffer = clCreateBuffer(dev->context, CL_MEM_WRITE_ONLY,
+			sizeof(cl_float) * numData, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create output Buffer\n");
+
+	f->gather = clCreateKernel(dev->program, "FIR_ols_gather", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (FIR_ols_gather)\n");
+	f->multiply = clCreateKernel(dev->program, "FIR_ols_multiply", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (FIR_ols_multiply)\n");
+	f->scatter = clCreateKernel(dev->program, "FIR_ols_scatter", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (FIR_ols_scatter)\n");
+
+	// Filter spectrum: FFT of the reversed taps, zero padded to N
+	cl_float2 *h = (cl_float2 *) calloc(f->N, sizeof(cl_float2));
+	for (i = 0; i < numTap; i++)
+		h[i].x = coeff[numTap - 1 - i];
+	f->spectrum = clCreateBuffer(dev->context, CL_MEM_READ_WRITE,
+			sizeof(cl_float2) * f->N, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create spectrum Buffer\n");
+	cl_mem spectrumScratch = clCreateBuffer(dev->context, CL_MEM_READ_WRITE,
+			sizeof(cl_float2) * f->N, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create spectrum Buffer\n");
+	ret = clEnqueueWriteBuffer(dev->queue, f->spectrum, CL_TRUE, 0,
+			sizeof(cl_float2) * f->N, h, 0, NULL, NULL);
+	free(h);
+	CHECK_STATUS( ret,"Error: Write spectrum Buffer\n");
+	if (FFTEnqueue(&f->fft, dev, &f->spectrum, &spectrumScratch, 1, -1, NULL))
+		return 1;
+	clReleaseMemObject(spectrumScratch);
+
+	cl_uint numWindow = numData + numTap - 1;
+	cl_float scale = 1.0f / f->N;
+	ret = clSetKernelArg(f->gather, 1, sizeof(cl_mem), (void *)&f->segment);
+	ret |= clSetKernelArg(f->gather, 2, sizeof(cl_uint), (void *)&numWindow);
+	ret |= clSetKernelArg(f->gather, 3, sizeof(cl_uint), (void *)&f->N);
+	ret |= clSetKernelArg(f->gather, 4, sizeof(cl_uint), (void *)&f->L);
+	ret |= clSetKernelArg(f->multiply, 1, sizeof(cl_mem), (void *)&f->spectrum);
+	ret |= clSetKernelArg(f->multiply, 2, sizeof(cl_uint), (void *)&f->N);
+	ret |= clSetKernelArg(f->multiply, 3, sizeof(cl_float), (void *)&scale);
+	ret |= clSetKernelArg(f->scatter, 1, sizeof(cl_mem), (void *)&f->outputBuffer);
+	ret |= clSetKernelArg(f->scatter, 2, sizeof(cl_uint), (void *)&numTap);
+	ret |= clSetKernelArg(f->scatter, 3, sizeof(cl_uint), (void *)&numData);
+	ret |= clSetKernelArg(f->scatter, 4, sizeof(cl_uint), (void *)&f->N);
+	ret |= clSetKernelArg(f->scatter, 5, sizeof(cl_uint), (void *)&f->L);
+	CHECK_STATUS( ret,"Error: Set overlap-save kernel arguments\n");
+
+	return FIRFFTReset(f, dev);
+}
+
+/*
+ * \brief Clear the history.
+ */
+int FIRFFTReset(FIRFFT *f, FIRDevice *dev)
+{
+	cl_int ret = CL_SUCCESS;
+
+	f->block = 0;
+	if (f->numTap > 1)
+	{
+		cl_float *zero = (cl_float *) calloc(f->numTap - 1, sizeof(cl_float));
+		ret = clEnqueueWriteBuffer(dev->queue, f->window[0], CL_TRUE, 0,
+				sizeof(cl_float) * (f->numTap - 1), zero, 0, NULL, NULL);
+		free(zero);
+	}
+	CHECK_STATUS( ret,"Error: Reset overlap-save history\n");
+
+	return 0;
+}
+
+static int EnqueueTimed(FIRDevice *dev, cl_kernel kernel, size_t *globalThreads,
+		double *time)
+{
+	cl_event event;
+	cl_int ret = clEnqueueNDRangeKernel(dev->queue, kernel, 2, NULL,
+			globalThreads, NULL, 0, NULL, &event);
+	CHECK_STATUS( ret,"Error: Range kernel. (overlap-save)\n");
+	if (time)
+		*time += FIREventTime(event);
+	clReleaseEvent(event);
+	return 0;
+}
+
+/*
+ * \brief Filter one block of numData samples, carrying the history over
+ * from the previous block.  The kernel time of every launch of the block
+ * is added to *time when time is not NULL.
+ */
+int FIRFFTProcess(FIRFFT *f, FIRDevice *dev, const cl_float *input,
+		cl_float *output, double *time)
+{
+	cl_int ret;
+	cl_mem cur = f->window[f->block & 1];
+	cl_mem next = f->window[(f->block + 1) & 1];
+
+	ret = clEnqueueWriteBuffer(dev->queue, cur, CL_FALSE,
+			sizeof(cl_float) * (f->numTap - 1), sizeof(cl_float) * f->numData,
+			input, 0, NULL, NULL);
+	CHECK_STATUS( ret,"Error: Write overlap-save input\n");
+
+	// Next block's history is the tail of this window
+	if (f->numTap > 1)
+	{
+		ret = clEnqueueCopyBuffer(dev->queue, cur, next,
+				sizeof(cl_float) * f->numData, 0,
+				sizeof(cl_float) * (f->numTap - 1), 0, NULL, NULL);
+		CHECK_STATUS( ret,"Error: Copy overlap-save history\n");
+	}
+
+	size_t segThreads[2] = {f->N, f->numSeg};
+	ret = clSetKernelArg(f->gather, 0, sizeof(cl_mem), (void *)&cur);
+	CHECK_STATUS( ret,"Error: Set gather input\n");
+	if (EnqueueTimed(dev, f->gather, segThreads, time))
+		return 1;
+
+	if (FFTEnqueue(&f->fft, dev, &f->segment, &f->scratch, f->numSeg, -1, time))
+		return 1;
+
+	ret = clSetKernelArg(f->multiply, 0, sizeof(cl_mem), (void *)&f->segment);
+	CHECK_STATUS( ret,"Error: Set multiply input\n");
+	if (EnqueueTimed(dev, f->multiply, segThreads, time))
+		return 1;
+
+	if (FFTEnqueue(&f->fft, dev, &f->segment, &f->scratch, f->numSeg, 1, time))
+		return 1;
+
+	size_t outThreads[2] = {f->L, f->numSeg};
+	ret = clSetKernelArg(f->scatter, 0, sizeof(cl_mem), (void *)&f->segment);
+	CHECK_STATUS( ret,"Error: Set scatter input\n");
+	if (EnqueueTimed(dev, f->scatter, outThreads, time))
+		return 1;
+
+	ret = clEnqueueReadBuffer(dev->queue, f->outputBuffer, CL_TRUE, 0,
+			sizeof(cl_float) * f->numData, output, 0, NULL, NULL);
+	CHECK_STATUS( ret,"Error: Read overlap-save output\n");
+
+	f->block++;
+	return 0;
+}
+
+void FIRFFTRelease(FIRFFT *f)
+{
+	clReleaseKernel(f->gather);
+	clReleaseKernel(f->multiply);
+	clReleaseKernel(f->scatter);
+	clReleaseMemObject(f->spectrum);
+	clReleaseMemObject(f->segment);
+	clReleaseMemObject(f->scratch);
+	clReleaseMemObject(f->window[0]);
+	clReleaseMemObject(f->window[1]);
+	clReleaseMemObject(f->outputBuffer);
+	FFTPlanRelease(&f->fft);
+}
+
+/*
+ * \brief Filter one block with zero history numIter times, for
+ * FIRRunVariant.  *time is the average kernel time per block.
+ */
+int FIRFFTRunBlock(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		const cl_float *coeff, const cl_float *input, cl_float *output,
+		int numIter, double *time)
+{
+	int i;
+	FIRFFT f;
+
+	if (FIRFFTCreate(&f, dev, numTap, numData, coeff, 0))
+		return 1;
+
+	*time = 0;
+	for (i = 0; i < numIter; i++)
+		if (FIRFFTReset(&f, dev) ||
+				FIRFFTProcess(&f, dev, input, output, time))
+			return 1;
+	*time /= numIter;
+
+	FIRFFTRelease(&f);
+	return 0;
+}
+
+/*
+ * \brief Pick direct or FFT convolution for these taps and block size.
+ *
+ * The direct candidate is the symmetric kernel for mirrored taps and
+ * blocked8 otherwise.  Below FIR_FFT_MIN_TAP taps it always wins.  Above
+ * it, one block is timed with the direct candidate and with overlap-save,
+ * and the faster one is returned.
+ */
+FIRVariant FIRSelectVariant(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		const cl_float *coeff)
+{
+	cl_uint i;
+	double directTime, fftTime;
+	FIRVariant direct = FIRIsSymmetric(coeff, numTap) ?
+		FIR_VARIANT_SYMMETRIC : FIR_VARIANT_BLOCKED8;
+
+	if (numTap < FIR_FFT_MIN_TAP)
+		return direct;
+
+	cl_float *input = (cl_float *) malloc(numData * sizeof(cl_float));
+	cl_float *output = (cl_float *) malloc(numData * sizeof(cl_float));
+	for (i = 0; i < numData; i++)
+		input[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+
+	FIRVariant variant = direct;
+	if (!FIRRunVariant(dev, direct, numTap, numData, coeff,
+				input, output, 3, &directTime) &&
+			!FIRRunVariant(dev, FIR_VARIANT_FFT, numTap, numData, coeff,
+				input, output, 3, &fftTime))
+	{
+		fprintf(stderr, "\tDirect: %8.2f us, FFT: %8.2f us per block\n",
+				directTime, fftTime);
+		if (fftTime < directTime)
+			variant = FIR_VARIANT_FFT;
+	}
+
+	free(input);
+	free(output);
+	return variant;
+}
+
+/*
+ * \brief Filter numBlocks blocks with overlap-save and check the whole
+ * stream against cpu_compute.
+ */
+int RunFIRFFT(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		cl_uint numBlocks)
+{
+	cl_uint i, b;
+	size_t numStream = (size_t)numData * numBlocks;
+
+	cl_float *stream = (cl_float *) malloc(numStream * sizeof(cl_float));
+	cl_float *result = (cl_float *) malloc(numStream * sizeof(cl_float));
+	cl_float *coeff = (cl_float *) malloc(numTap * sizeof(cl_float));
+	for (i = 0; i < numStream; i++)
+		stream[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+	for (i = 0; i < numTap; i++)
+		coeff[i] = 1.0f * rand() / RAND_MAX / numTap;
+
+	FIRFFT f;
+	if (FIRFFTCreate(&f, dev, numTap, numData, coeff, 0))
+		return 1;
+	printf("FIR Filter (overlap-save)\n FFT length : %u \n Segments per block : %u \n Blocks : %u\n",
+			f.N, f.numSeg, numBlocks);
+
+	double time = 0;
+	for (b = 0; b < numBlocks; b++)
+		if (FIRFFTProcess(&f, dev, stream + b * numData,
+					result + b * numData, &time))
+			return 1;
+	FIRFFTRelease(&f);
+
+	fprintf(stderr, "\tKernel exec time: %8.2f us per block\n", time / numBlocks);
+	fprintf(stderr, "\tThroughput: %8.2f Msamples/s\n", numStream / time);
+
+	float *cpu_out = cpu_compute(stream, coeff, numTap, numStream);
+	int failed = FIRVerify(cpu_out, result, numStream, 1e-4f);
+	printf(failed ? "FIR Fail\n" : "FIR Successful\n");
+
+	free(cpu_out);
+	free(stream);
+	free(result);
+	free(coeff);
+	return failed;
+}
@@ -0,0 +1,439 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <CL/cl.h>
+#include "FIR.h"
+
+
+size_t FIRSampleSize(cl_uint sampleType)
+{
+	switch (sampleType)
+	{
+	case FIR_SAMPLE_FLOAT32:  return sizeof(cl_float);
+	case FIR_SAMPLE_CFLOAT32: return 2 * sizeof(cl_float);
+	default:                  return 0;
+	}
+}
+
+/*
+ * \brief Map an existing sample file read-only and check its header.  On
+ * failure nothing is left open.
+ */
+int FIRFileOpen(FIRFile *file, const char *path)
+{
+	struct stat st;
+
+	memset(file, 0, sizeof(*file));
+	file->fd = open(path, O_RDONLY);
+	if (file->fd < 0 || fstat(file->fd, &st))
+	{
+		printf("Error: open sample file %s\n", path);
+		FIRFileClose(file);
+		return 1;
+	}
+	file->mapSize = st.st_size;
+	if (file->mapSize < sizeof(FIRFileHeader))
+	{
+		printf("Error: %s is too short for a sample file\n", path);
+		FIRFileClose(file);
+		return 1;
+	}
+	file->map = mmap(NULL, file->mapSize, PROT_READ, MAP_SHARED, file->fd, 0);
+	if (file->map == MAP_FAILED)
+	{
+		printf("Error: mmap sample file %s\n", path);
+		FIRFileClose(file);
+		return 1;
+	}
+
+	file->header = (FIRFileHeader *) file->map;
+	FIRFileHeader *h = file->header;
+	size_t frameSize = FIRSampleSize(h->sampleType) * h->numChannel;
+	// The sizes come from the file, so check them without a product that
+	// can wrap around
+	if (memcmp(h->magic, FIR_FILE_MAGIC, 4) || h->version != FIR_FILE_VERSION ||
+			!frameSize || h->dataOffset < sizeof(FIRFileHeader) ||
+			h->dataOffset > file->mapSize ||
+			h->numFrame > (file->mapSize - h->dataOffset) / frameSize)
+	{
+		printf("Error: %s is not a valid sample file\n", path);
+		FIRFileClose(file);
+		return 1;
+	}
+	file->data = (char *) file->map + h->dataOffset;
+	// Sequential scan: let the kernel read ahead
+	posix_madvise(file->map, file->mapSize, POSIX_MADV_SEQUENTIAL);
+
+	return 0;
+}
+
+/*
+ * \brief Create (or truncate) a sample file of numFrame frames and map it
+ * read-write.  The data starts on a page boundary so that blocks can be
+ * wrapped with CL_MEM_USE_HOST_PTR.  On failure nothing is left open.
+ */
+int FIRFileCreate(FIRFile *file, const char *path, cl_uint sampleType,
+		cl_uint numChannel, cl_uint sampleRate, cl_ulong numFrame)
+{
+	size_t frameSize = FIRSampleSize(sampleType) * numChannel;
+
+	memset(file, 0, sizeof(*file));
+	file->fd = -1;
+	if (!frameSize)
+	{
+		printf("Error: unknown sample type %u\n", sampleType);
+		return 1;
+	}
+	size_t dataOffset = sysconf(_SC_PAGESIZE);
+	if (dataOffset < sizeof(FIRFileHeader))
+		dataOffset = sizeof(FIRFileHeader);
+	if (numFrame > (SIZE_MAX - dataOffset) / frameSize)
+	{
+		printf("Error: %lu frames do not fit in a sample file\n",
+				(unsigned long)numFrame);
+		return 1;
+	}
+
+	file->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	file->mapSize = dataOffset + numFrame * frameSize;
+	if (file->fd < 0 || ftruncate(file->fd, file->mapSize))
+	{
+		printf("Error: create sample file %s\n", path);
+		FIRFileClose(file);
+		return 1;
+	}
+	file->map = mmap(NULL, file->mapSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+			file->fd, 0);
+	if (file->map == MAP_FAILED)
+	{
+		printf("Error: mmap sample file %s\n", path);
+		FIRFileClose(file);
+		return 1;
+	}
+
+	file->header = (FIRFileHeader *) file->map;
+	memcpy(file->header->magic, FIR_FILE_MAGIC, 4);
+	file->header->version = FIR_FILE_VERSION;
+	file->header->sampleType = sampleType;
+	file->header->numChannel = numChannel;
+	file->header->sampleRate = sampleRate;
+	file->header->dataOffset = dataOffset;
+	file->header->numFrame = numFrame;
+	file->data = (char *) file->map + dataOffset;
+	file->writable = 1;
+
+	return 0;
+}
+
+void FIRFileClose(FIRFile *file)
+{
+	if (file->map && file->map != MAP_FAILED)
+	{
+		if (file->writable)
+			msync(file->map, file->mapSize, MS_SYNC);
+		munmap(file->map, file->mapSize);
+	}
+	if (file->fd >= 0)
+		close(file->fd);
+	file->map = NULL;
+	file->fd = -1;
+}
+
+/*
+ * \brief Write numFrame frames of numChannel channels of uniform noise.
+ */
+int FIRFileGenerate(const char *path, cl_ulong numFrame, cl_uint numChannel,
+		cl_uint sampleRate)
+{
+	FIRFile file;
+	size_t i;
+
+	if (FIRFileCreate(&file, path, FIR_SAMPLE_FLOAT32, numChannel, sampleRate,
+				numFrame))
+		return 1;
+	cl_float *data = (cl_float *) file.data;
+	for (i = 0; i < numFrame * numChannel; i++)
+		data[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+	FIRFileClose(&file);
+
+	printf("Wrote %s: %lu frames x %u channels at %u Hz\n", path,
+			(unsigned long)numFrame, numChannel, sampleRate);
+	return 0;
+}
+
+/*
+ * \brief Filter a mono file block by block with no staging copy.
+ *
+ * The window of block b (numTap-1 history + n samples) is contiguous in the
+ * mapped input, so it is wrapped with CL_MEM_USE_HOST_PTR when its address
+ * meets the device alignment, and written straight from the mapping
+ * otherwise.  The output block is handled the same way in the mapped output.
+ */
+static int FilterMono(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		const cl_float *coeff, const cl_float *in, cl_float *out,
+		cl_ulong numFrame, double *time, cl_uint *numZeroCopy)
+{
+	cl_int ret;
+	cl_uint align = 0;
+	cl_ulong b;
+	cl_uint numHist = numTap - 1;
+
+	clGetDeviceInfo(dev->device, CL_DEVICE_MEM_BASE_ADDR_ALIGN,
+			sizeof(cl_uint), &align, NULL);
+	align = align / 8 ? align / 8 : 1;
+
+	cl_kernel kernel = clCreateKernel(dev->program, "FIR_blocked8", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (FIR_blocked8)\n");
+	cl_mem coeffBuffer = clCreateBuffer(dev->context,
+			CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			sizeof(cl_float) * numTap, (void *)coeff, &ret);
+	CHECK_STATUS( ret,"Error: Create coeff Buffer\n");
+	cl_mem windowBuffer = clCreateBuffer(dev->context, CL_MEM_READ_ONLY,
+			sizeof(cl_float) * (numData + numHist), NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create window Buffer\n");
+	cl_mem outputBuffer = clCreateBuffer(dev->context, CL_MEM_WRITE_ONLY,
+			sizeof(cl_float) * numData, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create output Buffer\n");
+
+	// The first block starts with zero history
+	if (numHist)
+	{
+		cl_float *zero = (cl_float *) calloc(numHist, sizeof(cl_float));
+		ret = clEnqueueWriteBuffer(dev->queue, windowBuffer, CL_TRUE, 0,
+				sizeof(cl_float) * numHist, zero, 0, NULL, NULL);
+		free(zero);
+		CHECK_STATUS( ret,"Error: Write history\n");
+	}
+
+	*time = 0;
+	*numZeroCopy = 0;
+	for (b = 0; b * numData < numFrame; b++)
+	{
+		cl_ulong first = b * numData;
+		cl_uint n = numFrame - first < numData ? numFrame - first : numData;
+		cl_mem window = windowBuffer;
+		cl_mem output = outputBuffer;
+
+		if (b == 0 || first < numHist)
+		{
+			// History not all in the file yet: stage it in the window buffer
+			cl_uint numPrev = first < numHist ? first : numHist;
+			ret = clEnqueueWriteBuffer(dev->queue, windowBuffer, CL_FALSE,
+					sizeof(cl_float) * (numHist - numPrev),
+					sizeof(cl_float) * (numPrev + n), in + first - numPrev,
+					0, NULL, NULL);
+			CHECK_STATUS( ret,"Error: Write window\n");
+		}
+		else if ((uintptr_t)(in + first - numHist) % align == 0)
+		{
+			window = clCreateBuffer(dev->context,
+					CL_MEM_READ_ONLY | CL_MEM_USE_HOST_PTR,
+					sizeof(cl_float) * (numHist + n),
+					(void *)(in + first - numHist), &ret);
+			CHECK_STATUS( ret,"Error: Wrap input window\n");
+		}
+		else
+		{
+			ret = clEnqueueWriteBuffer(dev->queue, windowBuffer, CL_FALSE, 0,
+					sizeof(cl_float) * (numHist + n), in + first - numHist,
+					0, NULL, NULL);
+			CHECK_STATUS( ret,"Error: Write window\n");
+		}
+
+		int wrapOut = (uintptr_t)(out + first) % align == 0;
+		if (wrapOut)
+		{
+			output = clCreateBuffer(dev->context,
+					CL_MEM_WRITE_ONLY | CL_MEM_USE_HOST_PTR,
+					sizeof(cl_float) * n, out + first, &ret);
+			CHECK_STATUS( ret,"Error: Wrap output block\n");
+		}
+		*numZeroCopy += (window != windowBuffer) + wrapOut;
+
+		ret = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&output);
+		ret |= clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&coeffBuffer);
+		ret |= clSetKernelArg(kernel, 2, sizeof(cl_mem), (void *)&window);
+		ret |= clSetKernelArg(kernel, 3, sizeof(cl_uint), (void *)&numTap);
+		ret |= clSetKernelArg(kernel, 4, sizeof(cl_uint), (void *)&n);
+		CHECK_STATUS( ret,"Error: Set kernel arguments (file)\n");
+
+		size_t localThreads[1] = {64};
+		size_t globalThreads[1] = {((n + 7) / 8 + 63) / 64 * 64};
+		cl_event event;
+		ret = clEnqueueNDRangeKernel(dev->queue, kernel, 1, NULL,
+				globalThreads, localThreads, 0, NULL, &event);
+		CHECK_STATUS( ret,"Error: Range kernel. (file)\n");
+		*time += FIREventTime(event);
+		clReleaseEvent(event);
+
+		if (wrapOut)
+		{
+			// Mapping a USE_HOST_PTR buffer makes the result visible in place
+			void *p = clEnqueueMapBuffer(dev->queue, output, CL_TRUE, CL_MAP_READ,
+					0, sizeof(cl_float) * n, 0, NULL, NULL, &ret);
+			CHECK_STATUS( ret,"Error: Map output block\n");
+			clEnqueueUnmapMemObject(dev->queue, output, p, 0, NULL, NULL);
+			clFinish(dev->queue);
+			clReleaseMemObject(output);
+		}
+		else
+		{
+			ret = clEnqueueReadBuffer(dev->queue, outputBuffer, CL_TRUE, 0,
+					sizeof(cl_float) * n, out + first, 0, NULL, NULL);
+			CHECK_STATUS( ret,"Error: Read output block\n");
+		}
+		if (window != windowBuffer)
+			clReleaseMemObject(window);
+	}
+
+	clReleaseKernel(kernel);
+	clReleaseMemObject(coeffBuffer);
+	clReleaseMemObject(windowBuffer);
+	clReleaseMemObject(outputBuffer);
+	return 0;
+}
+
+/*
+ * \brief Filter a multi-channel file with the filter bank.  Frames are
+ * interleaved in the file, so each block is deinterleaved from the mapping
+ * and interleaved into the output mapping.
+ */
+static int FilterBank(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		const cl_float *coeff, cl_uint numChannel, const cl_float *in,
+		cl_float *out, cl_ulong numFrame, double *time)
+{
+	cl_ulong b;
+	cl_uint ch, i;
+
+	FIRBank bank;
+	cl_uint *coeffSet = (cl_uint *) calloc(numChannel, sizeof(cl_uint));
+	if (FIRBankCreate(&bank, dev, numChannel, numTap, numData, coeff, 1, coeffSet))
+		return 1;
+	free(coeffSet);
+
+	cl_float *block = (cl_float *) malloc(numData * numChannel * sizeof(cl_float));
+	cl_float *res = (cl_float *) malloc(numData * numChannel * sizeof(cl_float));
+	*time = 0;
+	for (b = 0; b * numData < numFrame; b++)
+	{
+		cl_ulong first = b * numData;
+		cl_uint n = numFrame - first < numData ? numFrame - first : numData;
+		const cl_float *src = in + first * numChannel;
+
+		for (ch = 0; ch < numChannel; ch++)
+			for (i = 0; i < numData; i++)
+				block[ch * numData + i] = i < n ? src[i * numChannel + ch] : 0.0f;
+
+		cl_event event;
+		if (FIRBankProcess(&bank, dev, block, res, &event))
+			return 1;
+		*time += FIREventTime(event);
+		clReleaseEvent(event);
+
+		cl_float *dst = out + first * numChannel;
+		for (ch = 0; ch < numChannel; ch++)
+			for (i = 0; i < n; i++)
+				dst[i * numChannel + ch] = res[ch * numData + i];
+	}
+	FIRBankRelease(&bank);
+	free(block);
+	free(res);
+	return 0;
+}
+
+/*
+ * \brief Filter every channel of inPath into outPath (same header) and
+ * check each channel against cpu_compute.
+ */
+int RunFIRFile(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		const char *inPath, const char *outPath)
+{
+	cl_uint ch, i;
+	cl_ulong t;
+	FIRFile in, out;
+
+	if (FIRFileOpen(&in, inPath))
+		return 1;
+	FIRFileHeader *h = in.header;
+	if (h->sampleType != FIR_SAMPLE_FLOAT32)
+	{
+		printf("Error: only float32 sample files can be filtered\n");
+		FIRFileClose(&in);
+		return 1;
+	}
+	if (FIRFileCreate(&out, outPath, h->sampleType, h->numChannel,
+				h->sampleRate, h->numFrame))
+	{
+		FIRFileClose(&in);
+		return 1;
+	}
+
+	printf("FIR Filter (file)\n Input : %s \n Frames : %lu \n Channels : %u \n Rate : %u Hz\n",
+			inPath, (unsigned long)h->numFrame, h->numChannel, h->sampleRate);
+
+	cl_float *coeff = (cl_float *) malloc(numTap * sizeof(cl_float));
+	for (i = 0; i < numTap; i++)
+		coeff[i] = 1.0f * rand() / RAND_MAX / numTap;
+
+	const cl_float *src = (const cl_float *) in.data;
+	cl_float *dst = (cl_float *) out.data;
+	double time;
+	cl_uint numZeroCopy = 0;
+	int ret = h->numChannel == 1 ?
+		FilterMono(dev, numTap, numData, coeff, src, dst, h->numFrame,
+				&time, &numZeroCopy) :
+		FilterBank(dev, numTap, numData, coeff, h->numChannel, src, dst,
+				h->numFrame, &time);
+	if (ret)
+	{
+		FIRFileClose(&out);
+		FIRFileClose(&in);
+		free(coeff);
+		return 1;
+	}
+
+	fprintf(stderr, "\tKernel exec time: %8.2f us\n", time);
+	fprintf(stderr, "\tThroughput: %8.2f Msamples/s\n",
+			1.0 * h->numFrame * h->numChannel / time);
+	if (h->numChannel == 1)
+		fprintf(stderr, "\tZero-copy buffers: %u\n", numZeroCopy);
+
+	FIRCpu fc;
+	if (FIRCpuCreate(&fc, numTap, coeff, 0, FIRCpuDetect()))
+	{
+		FIRFileClose(&out);
+		FIRFileClose(&in);
+		free(coeff);
+		return 1;
+	}
+	int failed = 0;
+	cl_float *chan = (cl_float *) malloc(h->numFrame * sizeof(cl_float));
+	cl_float *res = (cl_float *) malloc(h->numFrame * sizeof(cl_float));
+	for (ch = 0; ch < h->numChannel && !failed; ch++)
+	{
+		for (t = 0; t < h->numFrame; t++)
+		{
+			chan[t] = src[t * h->numChannel + ch];
+			res[t] = dst[t * h->numChannel + ch];
+		}
+		float *cpu_out = cpu_compute_with(&fc, coeff, chan, h->numFrame);
+		failed = FIRVerify(cpu_out, res, h->numFrame, 1e-4f);
+		free(cpu_out);
+	}
+	FIRCpuRelease(&fc);
+	printf(failed ? "FIR Fail\n" : "FIR Successful\n");
+
+	FIRFileClose(&out);
+	FIRFileClose(&in);
+	free(chan);
+	free(res);
+	free(coeff);
+	return failed;
+}
@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <CL/cl.h>
+#include "FIR.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+const char *FIRQFormatName[FIR_NUM_QFORMAT] = {
+	"q15 (32-bit saturating)",
+	"q15 (64-bit)",
+	"q31 (64-bit)",
+};
+
+static const char *FIRQFormatKernel[FIR_NUM_QFORMAT] = {
+	"FIR_q15_sat32",
+	"FIR_q15_acc64",
+	"FIR_q31_acc64",
+};
+
+/* Bytes per output sample */
+static size_t FIRQFormatSize(FIRQFormat format)
+{
+	return format == FIR_Q31_ACC64 ? sizeof(cl_int) : sizeof(cl_short);
+}
+
+static int64_t Saturate(int64_t v, int64_t lo, int64_t hi)
+{
+	return v < lo ? lo : v > hi ? hi : v;
+}
+
+/*
+ * \brief Bit-exact reference of the FIR_q15_* / FIR_q31_* kernels over a
+ * stream with zero history.  Right shifts of negative values are
+ * arithmetic (floor), as in OpenCL C.
+ */
+void cpu_compute_fixed(const cl_short *input, const cl_short *coeff,
+		unsigned int numTap, size_t numData, FIRQFormat format, void *output)
+{
+	size_t n;
+	unsigned int i;
+
+	for (n = 0; n < numData; n++)
+	{
+		int64_t acc = 0;
+		for (i = 0; i < numTap; i++)
+		{
+			// Sample n+i of the window, history before the stream is zero
+			int64_t k = (int64_t)n + i - (numTap - 1);
+			int64_t p = k < 0 ? 0 : (int32_t)input[k] * coeff[i];
+			acc = format == FIR_Q15_SAT32 ?
+				Saturate(acc + p, INT32_MIN, INT32_MAX) : acc + p;
+		}
+		if (format == FIR_Q15_SAT32)
+			((cl_short *) output)[n] = Saturate(
+					Saturate(acc + (1 << 14), INT32_MIN, INT32_MAX) >> 15,
+					INT16_MIN, INT16_MAX);
+		else if (format == FIR_Q15_ACC64)
+			((cl_short *) output)[n] = Saturate((acc + (1 << 14)) >> 15,
+					INT16_MIN, INT16_MAX);
+		else
+			((cl_int *) output)[n] = Saturate(acc * 2, INT32_MIN, INT32_MAX);
+	}
+}
+
+/*
+ * \brief Create a fixed-point filter with numTap Q15 taps for blocks of
+ * numData Q15 samples.
+ */
+int FIRFixedCreate(FIRFixed *fx, FIRDevice *dev, FIRQFormat format,
+		cl_uint numTap, cl_uint numData, const cl_short *coeff)
+{
+	cl_int ret;
+
+	memset(fx, 0, sizeof(*fx));
+	fx->format = format;
+	fx->numTap = numTap;
+	fx->numTapPad = (numTap + 7) / 8 * 8;
+	fx->numData = numData;
+
+	cl_short *pad = (cl_short *) calloc(fx->numTapPad, sizeof(cl_short));
+	memcpy(pad, coeff, numTap * sizeof(cl_short));
+	fx->coeffBuffer = clCreateBuffer(dev->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			sizeof(cl_short) * fx->numTapPad, pad, &ret);
+	free(pad);
+	CHECK_STATUS( ret,"Error: Create Q15 coeff Buffer\n");
+
+	// The last short8 load of the last work item ends before numDataPad + numTapPad
+	size_t numWindow = (numData + 7) / 8 * 8 + fx->numTapPad;
+	cl_short *zero = (cl_short *) calloc(numWindow, sizeof(cl_short));
+	fx->window[0] = clCreateBuffer(dev->context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+			sizeof(cl_short) * numWindow, zero, &ret);
+	CHECK_STATUS( ret,"Error: Create Q15 window Buffer\n");
+	fx->window[1] = clCreateBuffer(dev->context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+			sizeof(cl_short) * numWindow, zero, &ret);
+	CHECK_STATUS( ret,"Error: Create Q15 window Buffer\n");
+	free(zero);
+	fx->outputBuffer = clCreateBuffer(dev->context, CL_MEM_WRITE_ONLY,
+			FIRQFormatSize(format) * numData, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create Q15 output Buffer\n");
+
+	fx->kernel = clCreateKernel(dev->program, FIRQFormatKernel[format], &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (FIR_q15)\n");
+	ret = clSetKernelArg(fx->kernel, 0, sizeof(cl_mem), (void *)&fx->outputBuffer);
+	ret |= clSetKernelArg(fx->kernel, 1, sizeof(cl_mem), (void *)&fx->coeffBuffer);
+	ret |= clSetKernelArg(fx->kernel, 3, sizeof(cl_uint), (void *)&fx->numTapPad);
+	ret |= clSetKernelArg(fx->kernel, 4, sizeof(cl_uint), (void *)&numData);
+	CHECK_STATUS( ret,"Error: Set kernel arguments (FIR_q15)\n");
+
+	return 0;
+}
+
+/*
+ * \brief Filter one block of numData Q15 samples, carrying the history over
+ * from the previous block.  output receives numData Q15 (cl_short) or Q31
+ * (cl_int) samples.  If event is not NULL it receives the kernel event
+ * (the caller releases it).
+ */
+int FIRFixedProcess(FIRFixed *fx, FIRDevice *dev, const cl_short *input,
+		void *output, cl_event *event)
+{
+	cl_int ret;
+	cl_mem cur = fx->window[fx->block & 1];
+	cl_mem next = fx->window[(fx->block + 1) & 1];
+
+	ret = clEnqueueWriteBuffer(dev->queue, cur, CL_FALSE,
+			sizeof(cl_short) * (fx->numTap - 1), sizeof(cl_short) * fx->numData,
+			input, 0, NULL, NULL);
+	CHECK_STATUS( ret,"Error: Write Q15 input\n");
+
+	// Next block's history is the tail of this window
+	if (fx->numTap > 1)
+	{
+		ret = clEnqueueCopyBuffer(dev->queue, cur, next,
+				sizeof(cl_short) * fx->numData, 0,
+				sizeof(cl_short) * (fx->numTap - 1), 0, NULL, NULL);
+		CHECK_STATUS( ret,"Error: Copy Q15 history\n");
+	}
+
+	ret = clSetKernelArg(fx->kernel, 2, sizeof(cl_mem), (void *)&cur);
+	CHECK_STATUS( ret,"Error: Set Q15 window argument\n");
+	size_t numItem = (fx->numData + 7) / 8;
+	size_t localThreads[1] = {64};
+	size_t globalThreads[1] = {(numItem + 63) / 64 * 64};
+	ret = clEnqueueNDRangeKernel(dev->queue, fx->kernel, 1, NULL,
+			globalThreads, localThreads, 0, NULL, event);
+	CHECK_STATUS( ret,"Error: Range kernel. (FIR_q15)\n");
+
+	ret = clEnqueueReadBuffer(dev->queue, fx->outputBuffer, CL_TRUE, 0,
+			FIRQFormatSize(fx->format) * fx->numData, output, 0, NULL, NULL);
+	CHECK_STATUS( ret,"Error: Read Q15 output\n");
+
+	fx->block++;
+	return 0;
+}
+
+void FIRFixedRelease(FIRFixed *fx)
+{
+	clReleaseKernel(fx->kernel);
+	clReleaseMemObject(fx->outputBuffer);
+	clReleaseMemObject(fx->window[1]);
+	clReleaseMemObject(fx->window[0]);
+	clReleaseMemObject(fx->coeffBuffer);
+}
+
+/* A 0.9 full-scale Q15 tone plus noise */
+static void FixedSignal(cl_short *x, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i < n; i++)
+		x[i] = (cl_short) Saturate(lrint(32768 * (0.9 * sin(2 * M_PI * i / 1000) +
+					0.1 * (2.0 * rand() / RAND_MAX - 1.0))), INT16_MIN, INT16_MAX);
+}
+
+/* Random Q15 taps, of both signs if mixed, scaled so that sum |coeff| = gain */
+static void FixedTaps(cl_short *coeff, cl_uint numTap, double gain, int mixed)
+{
+	cl_uint i;
+	double *r = (double *) malloc(numTap * sizeof(double));
+	double sum = 0;
+
+	for (i = 0; i < numTap; i++)
+	{
+		r[i] = mixed ? 2.0 * rand() / RAND_MAX - 1.0 : 1.0 * rand() / RAND_MAX;
+		sum += fabs(r[i]);
+	}
+	for (i = 0; i < numTap; i++)
+		coeff[i] = (cl_short) Saturate(lrint(r[i] * gain / (sum ? sum : 1) * 32768),
+				INT16_MIN, INT16_MAX);
+	free(r);
+}
+
+/*
+ * \brief Filter numBlocks blocks of stream on the device and compare bit
+ * for bit with cpu_compute_fixed.  Adds the kernel time to *kernelTime and
+ * returns 0 if every output matches.
+ */
+static int FixedCheck(FIRDevice *dev, FIRQFormat format, cl_uint numTap,
+		cl_uint numData, cl_uint numBlocks, const cl_short *stream,
+		const cl_short *coeff, const char *label, double *kernelTime)
+{
+	size_t i;
+	cl_uint b;
+	size_t numStream = (size_t)numData * numBlocks;
+	size_t outSize = FIRQFormatSize(format);
+	char *result = (char *) malloc(numStream * outSize);
+	char *ref = (char *) malloc(numStream * outSize);
+
+	FIRFixed fx;
+	if (FIRFixedCreate(&fx, dev, format, numTap, numData, coeff))
+		return 1;
+	for (b = 0; b < numBlocks; b++)
+	{
+		cl_event event;
+		if (FIRFixedProcess(&fx, dev, stream + (size_t)b * numData,
+					result + (size_t)b * numData * outSize, &event))
+			return 1;
+		*kernelTime += FIREventTime(event);
+		clReleaseEvent(event);
+	}
+	FIRFixedRelease(&fx);
+
+	cpu_compute_fixed(stream, coeff, numTap, numStream, format, ref);
+	size_t saturated = 0;
+	for (i = 0; i < numStream; i++)
+	{
+		int64_t v = format == FIR_Q31_ACC64 ? ((cl_int *) ref)[i] : ((cl_short *) ref)[i];
+		int64_t top = format == FIR_Q31_ACC64 ? INT32_MAX : INT16_MAX;
+		if (v >= top || v <= -top - 1)
+			saturated++;
+	}
+	fprintf(stderr, "\t%-12s saturated outputs: %zu of %zu\n", label, saturated, numStream);
+
+	int failed = 0;
+	for (i = 0; i < numStream && !failed; i++)
+		if (memcmp(result + i * outSize, ref + i * outSize, outSize))
+		{
+			long long got = format == FIR_Q31_ACC64 ?
+				((cl_int *) result)[i] : ((cl_short *) result)[i];
+			long long want = format == FIR_Q31_ACC64 ?
+				((cl_int *) ref)[i] : ((cl_short *) ref)[i];
+			printf("Mismatch at %zu (%s): %lld (expected %lld)\n", i, label, got, want);
+			failed = 1;
+		}
+
+	free(result);
+	free(ref);
+	return failed;
+}
+
+/*
+ * \brief Filter numBlocks blocks of a 0.9 full-scale Q15 tone plus noise
+ * with mixed-sign taps of sum |coeff| = 0.9, which never saturate, so the
+ * bit-exact comparison with cpu_compute_fixed covers rounding and
+ * accumulation.  A short run with positive taps of gain 4 then checks
+ * that saturated outputs (and 32-bit accumulators) match as well.  One
+ * block of the same filter in float through FIR_blocked8 is timed
+ * alongside.
+ */
+int RunFIRFixed(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		cl_uint numBlocks, FIRQFormat format)
+{
+	size_t i;
+	size_t numStream = (size_t)numData * numBlocks;
+	size_t outSize = FIRQFormatSize(format);
+
+	cl_short *stream = (cl_short *) malloc(numStream * sizeof(cl_short));
+	cl_short *coeff = (cl_short *) malloc(numTap * sizeof(cl_short));
+	FixedSignal(stream, numStream);
+	FixedTaps(coeff, numTap, 0.9, 1);
+
+	printf("FIR Filter (fixed point)\n Format : %s \n Taps : %u (padded to %u) \n Blocks : %u\n",
+			FIRQFormatName[format], numTap, (numTap + 7) / 8 * 8, numBlocks);
+
+	double kernelTime = 0;
+	int failed = FixedCheck(dev, format, numTap, numData, numBlocks, stream, coeff,
+			"gain 0.9", &kernelTime);
+
+	fprintf(stderr, "\tKernel exec time: %8.2f us per block\n", kernelTime / numBlocks);
+	fprintf(stderr, "\tThroughput: %8.2f Msamples/s, %zu+%zu bytes per sample\n",
+			numStream / kernelTime, sizeof(cl_short), outSize);
+
+	// The same taps and samples as float fractions through FIR_blocked8
+	cl_float *fcoeff = (cl_float *) malloc(numTap * sizeof(cl_float));
+	cl_float *finput = (cl_float *) malloc(numData * sizeof(cl_float));
+	cl_float *foutput = (cl_float *) malloc(numData * sizeof(cl_float));
+	for (i = 0; i < numTap; i++)
+		fcoeff[i] = coeff[i] / 32768.f;
+	for (i = 0; i < numData; i++)
+		finput[i] = stream[i] / 32768.f;
+	double floatTime = 0;
+	if (!FIRRunVariant(dev, FIR_VARIANT_BLOCKED8, numTap, numData, fcoeff,
+				finput, foutput, 1, &floatTime))
+		fprintf(stderr, "\tFloat %s: %8.2f us per block, 4+4 bytes per sample\n",
+				FIRVariantName[FIR_VARIANT_BLOCKED8], floatTime);
+
+	// Deliberate overload: positive taps of gain 4 clip on the peaks
+	double satTime = 0;
+	FixedTaps(coeff, numTap, 4.0, 0);
+	failed |= FixedCheck(dev, format, numTap, numData, numBlocks < 2 ? numBlocks : 2,
+			stream, coeff, "gain 4", &satTime);
+	printf(failed ? "FIR Fail\n" : "FIR Successful\n");
+
+	free(fcoeff);
+	free(finput);
+	free(foutput);
+	free(stream);
+	free(coeff);
+	return failed;
+}
@@ -0,0 +1,162 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <CL/cl.h>
+#include "FIR.h"
+
+
+/* Blocks run before the measurement starts (first launches, page faults) */
+#define FIR_LATENCY_WARMUP 16
+
+static int CompareDouble(const void *a, const void *b)
+{
+	double x = *(const double *) a;
+	double y = *(const double *) b;
+	return x < y ? -1 : x > y;
+}
+
+/* Nearest-rank percentile of a sorted array */
+static double Percentile(const double *sorted, size_t n, double p)
+{
+	size_t rank = (size_t) ceil(p / 100.0 * n);
+	return sorted[rank ? rank - 1 : 0];
+}
+
+/*
+ * \brief Print p50/p90/p99/max of n latencies (us) and a log2 histogram.
+ * lat is sorted in place.
+ */
+void FIRLatencyReport(const char *label, double *lat, size_t n)
+{
+	size_t i;
+	int b;
+
+	if (!n)
+		return;
+	qsort(lat, n, sizeof(double), CompareDouble);
+	fprintf(stderr, "\t%s latency (us): p50 %8.2f  p90 %8.2f  p99 %8.2f  max %8.2f\n",
+			label, Percentile(lat, n, 50), Percentile(lat, n, 90),
+			Percentile(lat, n, 99), lat[n - 1]);
+
+	// Buckets [2^b, 2^(b+1)) us, bucket 0 also takes everything below 1 us
+	size_t count[32] = {0};
+	int last = 0;
+	for (i = 0; i < n; i++)
+	{
+		b = lat[i] < 1.0 ? 0 : (int) log2(lat[i]);
+		if (b > 31)
+			b = 31;
+		count[b]++;
+		if (b > last)
+			last = b;
+	}
+	int first = (int) (lat[0] < 1.0 ? 0 : log2(lat[0]));
+	for (b = first; b <= last; b++)
+	{
+		int bar = (int) (50.0 * count[b] / n + 0.5);
+		fprintf(stderr, "\t  %8.0f - %8.0f us %7zu ", b ? pow(2, b) : 0.0,
+				pow(2, b + 1), count[b]);
+		while (bar--)
+			fputc('#', stderr);
+		fputc('\n', stderr);
+	}
+}
+
+/*
+ * \brief Filter small blocks back to back and report per-block latency.
+ *
+ * Every buffer and the kernel are built once (a one-channel filter bank),
+ * and the host side of each transfer is pinned memory from
+ * CL_MEM_ALLOC_HOST_PTR.  For each block two latencies are recorded:
+ * host wall time from the moment the block is handed over until its
+ * filtered output is back in host memory, and device time from the
+ * kernel being queued to it completing.
+ */
+int RunFIRLatency(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		cl_uint numBlocks)
+{
+	cl_int ret;
+	cl_uint b, i;
+	cl_uint zero = 0;
+	size_t numRun = numBlocks + FIR_LATENCY_WARMUP;
+	size_t numStream = (size_t)numData * numRun;
+
+	if (numData < 64 || numData > 1024)
+		printf("Note: latency mode is meant for blocks of 64 to 1024 samples\n");
+	printf("FIR Filter (latency)\n Block : %u samples \n Blocks : %u (+%d warm-up)\n",
+			numData, numBlocks, FIR_LATENCY_WARMUP);
+
+	cl_float *coeff = (cl_float *) malloc(numTap * sizeof(cl_float));
+	cl_float *stream = (cl_float *) malloc(numStream * sizeof(cl_float));
+	cl_float *result = (cl_float *) malloc(numStream * sizeof(cl_float));
+	double *wallLat = (double *) malloc(numBlocks * sizeof(double));
+	double *devLat = (double *) malloc(numBlocks * sizeof(double));
+	for (i = 0; i < numTap; i++)
+		coeff[i] = 1.0f * rand() / RAND_MAX / numTap;
+	for (i = 0; i < numStream; i++)
+		stream[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+
+	FIRBank bank;
+	if (FIRBankCreate(&bank, dev, 1, numTap, numData, coeff, 1, &zero))
+		return 1;
+
+	// Pinned staging memory for the block and its output
+	cl_mem pinned = clCreateBuffer(dev->context,
+			CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
+			2 * numData * sizeof(cl_float), NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create pinned Buffer\n");
+	cl_float *stage = (cl_float *) clEnqueueMapBuffer(dev->queue, pinned, CL_TRUE,
+			CL_MAP_READ | CL_MAP_WRITE, 0, 2 * numData * sizeof(cl_float),
+			0, NULL, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Map pinned Buffer\n");
+	cl_float *stageIn = stage;
+	cl_float *stageOut = stage + numData;
+
+	for (b = 0; b < numRun; b++)
+	{
+		// Sample arrival: the block lands in the pinned buffer
+		memcpy(stageIn, stream + (size_t)b * numData, numData * sizeof(cl_float));
+		double arrival = WallTime();
+
+		cl_event event;
+		if (FIRBankProcess(&bank, dev, stageIn, stageOut, &event))
+			return 1;
+		double done = WallTime();
+
+		cl_ulong queued = 0, end = 0;
+		clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_QUEUED,
+				sizeof(cl_ulong), &queued, NULL);
+		clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END,
+				sizeof(cl_ulong), &end, NULL);
+		clReleaseEvent(event);
+
+		memcpy(result + (size_t)b * numData, stageOut, numData * sizeof(cl_float));
+		if (b >= FIR_LATENCY_WARMUP)
+		{
+			wallLat[b - FIR_LATENCY_WARMUP] = done - arrival;
+			devLat[b - FIR_LATENCY_WARMUP] = (end - queued) / 1e3;
+		}
+	}
+
+	clEnqueueUnmapMemObject(dev->queue, pinned, stage, 0, NULL, NULL);
+	clFinish(dev->queue);
+	clReleaseMemObject(pinned);
+	FIRBankRelease(&bank);
+
+	FIRLatencyReport("Arrival-to-output", wallLat, numBlocks);
+	FIRLatencyReport("Kernel queued-to-end", devLat, numBlocks);
+
+	float *cpu_out = cpu_compute(stream, coeff, numTap, numStream);
+	int failed = FIRVerify(cpu_out, result, numStream, 1e-4f);
+	printf(failed ? "FIR Fail\n" : "FIR Successful\n");
+
+	free(cpu_out);
+	free(coeff);
+	free(stream);
+	free(result);
+	free(wallLat);
+	free(devLat);
+	return failed;
+}
@@ -0,0 +1,300 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <CL/cl.h>
+#include "FIR.h"
+
+
+/* Samples each device filters to measure its throughput */
+#define FIR_MULTI_PROBE (1 << 18)
+
+/* Completion of the segments, reported by their event callbacks */
+typedef struct {
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	cl_uint pending;         /* callbacks that have not run yet */
+	double start;            /* wall time the segments were queued */
+} FIRMultiWait;
+
+/* One device and the contiguous segment of the stream it filters */
+typedef struct {
+	FIRDevice dev;
+	char name[128];
+	cl_kernel kernel;        /* FIR_decimate with down = 1: FIR with a bounds check */
+	cl_mem coeffBuffer;
+	cl_mem windowBuffer;     /* numTap-1 halo samples + the segment */
+	cl_mem outputBuffer;
+	size_t capacity;         /* samples the buffers hold */
+	size_t first;            /* first output sample of the segment */
+	size_t count;
+	double rate;             /* measured samples per us */
+	double time;             /* wall time of the segment, us */
+	cl_int status;           /* final status of the segment's readback */
+	FIRMultiWait *wait;
+} FIRPart;
+
+/*
+ * \brief Every OpenCL device of every platform.  *ids is malloc'ed.
+ */
+int FIRDeviceList(cl_device_id **ids, cl_uint *numDevice)
+{
+	cl_uint numPlatform = 0, p, n;
+	cl_int ret;
+
+	*numDevice = 0;
+	ret = clGetPlatformIDs(0, NULL, &numPlatform);
+	CHECK_STATUS( ret,"Error: Get Platform IDs\n");
+	cl_platform_id *platform = (cl_platform_id *) malloc(numPlatform * sizeof(cl_platform_id));
+	clGetPlatformIDs(numPlatform, platform, NULL);
+
+	*ids = NULL;
+	for (p = 0; p < numPlatform; p++)
+	{
+		if (clGetDeviceIDs(platform[p], CL_DEVICE_TYPE_ALL, 0, NULL, &n) != CL_SUCCESS || !n)
+			continue;
+		*ids = (cl_device_id *) realloc(*ids, (*numDevice + n) * sizeof(cl_device_id));
+		clGetDeviceIDs(platform[p], CL_DEVICE_TYPE_ALL, n, *ids + *numDevice, NULL);
+		*numDevice += n;
+	}
+	free(platform);
+
+	if (!*numDevice)
+	{
+		printf("Error: no OpenCL device\n");
+		return 1;
+	}
+	return 0;
+}
+
+static int PartCreate(FIRPart *part, cl_device_id id, cl_uint numTap,
+		const cl_float *coeff)
+{
+	cl_int ret;
+	cl_uint one = 1, zero = 0;
+
+	memset(part, 0, sizeof(*part));
+	if (FIRDeviceInit(&part->dev, id))
+		return 1;
+	clGetDeviceInfo(id, CL_DEVICE_NAME, sizeof(part->name), part->name, NULL);
+
+	part->coeffBuffer = clCreateBuffer(part->dev.context,
+			CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			sizeof(cl_float) * numTap, (void *)coeff, &ret);
+	CHECK_STATUS( ret,"Error: Create coeff Buffer\n");
+	part->kernel = clCreateKernel(part->dev.program, "FIR_decimate", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (FIR_decimate)\n");
+	ret = clSetKernelArg(part->kernel, 1, sizeof(cl_mem), (void *)&part->coeffBuffer);
+	ret |= clSetKernelArg(part->kernel, 3, sizeof(cl_uint), (void *)&numTap);
+	ret |= clSetKernelArg(part->kernel, 4, sizeof(cl_uint), (void *)&one);
+	ret |= clSetKernelArg(part->kernel, 6, sizeof(cl_uint), (void *)&zero);
+	CHECK_STATUS( ret,"Error: Set kernel arguments (FIR_decimate)\n");
+
+	return 0;
+}
+
+/*
+ * Queue the filtering of count outputs on the part's device without
+ * waiting: window holds the numTap-1 halo samples followed by the segment.
+ * If event is not NULL it receives the event of the readback (the caller
+ * releases it).
+ */
+static int PartEnqueue(FIRPart *part, cl_uint numTap, const cl_float *window,
+		size_t count, cl_float *output, cl_event *event)
+{
+	cl_int ret;
+
+	if (count > part->capacity)
+	{
+		if (part->capacity)
+		{
+			clReleaseMemObject(part->windowBuffer);
+			clReleaseMemObject(part->outputBuffer);
+		}
+		part->windowBuffer = clCreateBuffer(part->dev.context, CL_MEM_READ_ONLY,
+				sizeof(cl_float) * (count + numTap - 1), NULL, &ret);
+		CHECK_STATUS( ret,"Error: Create segment window Buffer\n");
+		part->outputBuffer = clCreateBuffer(part->dev.context, CL_MEM_WRITE_ONLY,
+				sizeof(cl_float) * count, NULL, &ret);
+		CHECK_STATUS( ret,"Error: Create segment output Buffer\n");
+		part->capacity = count;
+	}
+
+	cl_uint numOut = count;
+	ret = clEnqueueWriteBuffer(part->dev.queue, part->windowBuffer, CL_FALSE, 0,
+			sizeof(cl_float) * (count + numTap - 1), window, 0, NULL, NULL);
+	CHECK_STATUS( ret,"Error: Write segment window\n");
+	ret = clSetKernelArg(part->kernel, 0, sizeof(cl_mem), (void *)&part->outputBuffer);
+	ret |= clSetKernelArg(part->kernel, 2, sizeof(cl_mem), (void *)&part->windowBuffer);
+	ret |= clSetKernelArg(part->kernel, 5, sizeof(cl_uint), (void *)&numOut);
+	CHECK_STATUS( ret,"Error: Set segment arguments\n");
+
+	size_t localThreads[1] = {64};
+	size_t globalThreads[1] = {(count + 63) / 64 * 64};
+	ret = clEnqueueNDRangeKernel(part->dev.queue, part->kernel, 1, NULL,
+			globalThreads, localThreads, 0, NULL, NULL);
+	CHECK_STATUS( ret,"Error: Range kernel. (FIR segment)\n");
+	ret = clEnqueueReadBuffer(part->dev.queue, part->outputBuffer, CL_FALSE, 0,
+			sizeof(cl_float) * count, output, 0, NULL, event);
+	CHECK_STATUS( ret,"Error: Read segment output\n");
+	clFlush(part->dev.queue);
+
+	return 0;
+}
+
+/* Readback callback: note when the segment finished, without polling */
+static void CL_CALLBACK PartDone(cl_event event, cl_int status, void *arg)
+{
+	FIRPart *part = (FIRPart *) arg;
+	FIRMultiWait *wait = part->wait;
+	double now = WallTime();
+
+	pthread_mutex_lock(&wait->lock);
+	part->time = now - wait->start;
+	part->status = status;
+	if (--wait->pending == 0)
+		pthread_cond_signal(&wait->cond);
+	pthread_mutex_unlock(&wait->lock);
+}
+
+static void PartRelease(FIRPart *part)
+{
+	if (part->capacity)
+	{
+		clReleaseMemObject(part->windowBuffer);
+		clReleaseMemObject(part->outputBuffer);
+	}
+	clReleaseKernel(part->kernel);
+	clReleaseMemObject(part->coeffBuffer);
+	FIRDeviceRelease(&part->dev);
+}
+
+/*
+ * \brief Filter numData samples split over every OpenCL device, CPU
+ * devices included.
+ *
+ * Each device gets one contiguous segment, extended in front by the
+ * numTap-1 samples before it (zeros at the start of the stream), so every
+ * segment is filtered on its own and no samples move between devices.
+ * Segment lengths follow the throughput each device showed on a probe run
+ * of upload, kernel and readback.
+ */
+int RunFIRMulti(cl_uint numTap, cl_uint numData)
+{
+	cl_device_id *ids;
+	cl_uint numDevice, d;
+	size_t i;
+
+	if (FIRDeviceList(&ids, &numDevice))
+		return 1;
+
+	// Stream with the halo of the first segment in front
+	cl_float *padded = (cl_float *) calloc(numData + numTap - 1, sizeof(cl_float));
+	cl_float *stream = padded + numTap - 1;
+	cl_float *result = (cl_float *) malloc(numData * sizeof(cl_float));
+	cl_float *coeff = (cl_float *) malloc(numTap * sizeof(cl_float));
+	for (i = 0; i < numData; i++)
+		stream[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+	for (i = 0; i < numTap; i++)
+		coeff[i] = 1.0f * rand() / RAND_MAX / numTap;
+
+	printf("FIR Filter (multi-device)\n Devices : %u \n Data Samples : %u\n",
+			numDevice, numData);
+
+	FIRPart *part = (FIRPart *) calloc(numDevice, sizeof(FIRPart));
+	size_t probe = numData < FIR_MULTI_PROBE ? numData : FIR_MULTI_PROBE;
+	double totalRate = 0;
+	for (d = 0; d < numDevice; d++)
+	{
+		if (PartCreate(&part[d], ids[d], numTap, coeff))
+			return 1;
+
+		// The first run pays for buffer creation and first-launch costs
+		int run;
+		for (run = 0; run < 2; run++)
+		{
+			double start = WallTime();
+			if (PartEnqueue(&part[d], numTap, padded, probe, result, NULL))
+				return 1;
+			clFinish(part[d].dev.queue);
+			part[d].rate = probe / (WallTime() - start);
+		}
+		totalRate += part[d].rate;
+	}
+
+	// Split in proportion to the measured rates, the last device takes the rest
+	size_t first = 0;
+	for (d = 0; d < numDevice; d++)
+	{
+		part[d].first = first;
+		part[d].count = d == numDevice - 1 ? numData - first :
+			(size_t)(numData * part[d].rate / totalRate);
+		first += part[d].count;
+	}
+
+	// Queue every segment; a callback on each readback notes when it is done
+	FIRMultiWait wait;
+	pthread_mutex_init(&wait.lock, NULL);
+	pthread_cond_init(&wait.cond, NULL);
+	wait.pending = 0;
+	cl_event *done = (cl_event *) calloc(numDevice, sizeof(cl_event));
+	cl_uint numDone = 0;
+	wait.start = WallTime();
+	for (d = 0; d < numDevice; d++)
+		if (part[d].count)
+		{
+			cl_event event;
+			if (PartEnqueue(&part[d], numTap, padded + part[d].first,
+						part[d].count, result + part[d].first, &event))
+				return 1;
+			part[d].wait = &wait;
+			pthread_mutex_lock(&wait.lock);
+			wait.pending++;
+			pthread_mutex_unlock(&wait.lock);
+			cl_int ret = clSetEventCallback(event, CL_COMPLETE, PartDone, &part[d]);
+			CHECK_STATUS( ret,"Error: Set segment callback\n");
+			done[numDone++] = event;
+		}
+	cl_int ret = numDone ? clWaitForEvents(numDone, done) : CL_SUCCESS;
+	// The callbacks may still be running when the wait returns
+	pthread_mutex_lock(&wait.lock);
+	while (wait.pending)
+		pthread_cond_wait(&wait.cond, &wait.lock);
+	pthread_mutex_unlock(&wait.lock);
+	double time = WallTime() - wait.start;
+	for (d = 0; d < numDone; d++)
+		clReleaseEvent(done[d]);
+	free(done);
+	pthread_cond_destroy(&wait.cond);
+	pthread_mutex_destroy(&wait.lock);
+
+	int failed = ret != CL_SUCCESS;
+	for (d = 0; d < numDevice; d++)
+		if (part[d].count && part[d].status < 0)
+		{
+			printf("Error: segment on %s failed (%d)\n", part[d].name, part[d].status);
+			failed = 1;
+		}
+
+	for (d = 0; d < numDevice; d++)
+		fprintf(stderr, "\t%-32.32s %8.2f Msamples/s probe, %10zu samples, done after %8.2f us\n",
+				part[d].name, part[d].rate, part[d].count, part[d].time);
+	fprintf(stderr, "\tWall time: %8.2f us, %8.2f Msamples/s\n", time, numData / time);
+
+	float *cpu_out = cpu_compute(stream, coeff, numTap, numData);
+	if (!failed)
+		failed = FIRVerify(cpu_out, result, numData, 1e-4f);
+	printf(failed ? "FIR Fail\n" : "FIR Successful\n");
+
+	for (d = 0; d < numDevice; d++)
+		PartRelease(&part[d]);
+	free(part);
+	free(ids);
+	free(cpu_out);
+	free(padded);
+	free(result);
+	free(coeff);
+	return failed;
+}
@@ -0,0 +1,396 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <CL/cl.h>
+#include "FIR.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FIR_PACK_X86
+#endif
+
+
+const char *FIRPackName[FIR_NUM_PACK] = {
+	"float",
+	"half",
+	"int16",
+};
+
+const size_t FIRPackSize[FIR_NUM_PACK] = {
+	sizeof(cl_float),
+	sizeof(cl_half),
+	sizeof(cl_short),
+};
+
+static const char *FIRPackKernel[FIR_NUM_PACK] = {
+	"FIR_packed_float",
+	"FIR_packed_half",
+	"FIR_packed_int16",
+};
+
+/* Blocks smaller than this per thread are converted on the calling thread */
+#define FIR_PACK_MIN_CHUNK 65536
+
+/* Round to nearest even, like vstore_half_rte and F16C */
+static uint16_t FloatToHalf(float f)
+{
+	uint32_t x;
+
+	memcpy(&x, &f, sizeof(x));
+	uint16_t sign = (x >> 16) & 0x8000;
+	x &= 0x7fffffff;
+
+	if (x >= 0x7f800000)                    // Inf and NaN
+		return sign | (x > 0x7f800000 ? 0x7e00 : 0x7c00);
+	if (x >= 0x477ff000)                    // rounds to 65520 or more
+		return sign | 0x7c00;
+	if (x < 0x38800000)                     // below 2^-14: subnormal half
+	{
+		float a;
+		memcpy(&a, &x, sizeof(a));
+		return sign | (uint16_t) lrintf(a * 16777216.0f);
+	}
+	x -= 0x38000000;                        // rebias the exponent
+	x += 0xfff + ((x >> 13) & 1);
+	return sign | (uint16_t)(x >> 13);
+}
+
+static int16_t FloatToQ15(float x, float inv)
+{
+	float q = rintf(x * inv);
+	return q > 32767.f ? 32767 : q < -32768.f ? -32768 : (int16_t) q;
+}
+
+static void PackScalar(FIRPackFormat format, const float *in, void *out,
+		size_t n, float inv)
+{
+	size_t i;
+
+	if (format == FIR_PACK_HALF)
+		for (i = 0; i < n; i++)
+			((uint16_t *) out)[i] = FloatToHalf(in[i]);
+	else
+		for (i = 0; i < n; i++)
+			((int16_t *) out)[i] = FloatToQ15(in[i], inv);
+}
+
+#ifdef FIR_PACK_X86
+/* Every AVX2 processor also has F16C */
+__attribute__((target("avx2,f16c")))
+static void PackAVX2(FIRPackFormat format, const float *in, void *out,
+		size_t n, float inv)
+{
+	size_t i = 0;
+
+	if (format == FIR_PACK_HALF)
+		for (; i + 8 <= n; i += 8)
+			_mm_storeu_si128((__m128i *)((uint16_t *) out + i),
+					_mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT));
+	else
+	{
+		__m256 scale = _mm256_set1_ps(inv);
+		__m256 hi = _mm256_set1_ps(32767.f);
+		__m256 lo = _mm256_set1_ps(-32768.f);
+		for (; i + 16 <= n; i += 16)
+		{
+			// Clamp first: out-of-range conversions give INT_MIN
+			__m256 a = _mm256_mul_ps(_mm256_loadu_ps(in + i), scale);
+			__m256 b = _mm256_mul_ps(_mm256_loadu_ps(in + i + 8), scale);
+			a = _mm256_max_ps(_mm256_min_ps(a, hi), lo);
+			b = _mm256_max_ps(_mm256_min_ps(b, hi), lo);
+			__m256i q = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+			// packs works per 128-bit lane: restore the sample order
+			q = _mm256_permute4x64_epi64(q, 0xd8);
+			_mm256_storeu_si256((__m256i *)((int16_t *) out + i), q);
+		}
+	}
+	PackScalar(format, in + i, (char *) out + i * FIRPackSize[format], n - i, inv);
+}
+#endif
+
+typedef struct {
+	FIRPackFormat format;
+	FIRCpuISA isa;
+	const float *in;
+	void *out;
+	size_t n;
+	float inv;
+} FIRPackChunk;
+
+static void *FIRPackWorker(void *arg)
+{
+	FIRPackChunk *c = (FIRPackChunk *) arg;
+
+#ifdef FIR_PACK_X86
+	if (c->isa != FIR_CPU_SCALAR)
+	{
+		PackAVX2(c->format, c->in, c->out, c->n, c->inv);
+		return NULL;
+	}
+#endif
+	PackScalar(c->format, c->in, c->out, c->n, c->inv);
+	return NULL;
+}
+
+/*
+ * \brief Convert n float samples to format, on up to numThread threads
+ * (0 = every online CPU).  The int16 result is the Q15 fraction of
+ * fullScale, rounded to nearest and saturated.
+ */
+void FIRPackConvert(FIRPackFormat format, const float *in, void *out, size_t n,
+		float fullScale, int numThread, FIRCpuISA isa)
+{
+	size_t t;
+
+	if (format == FIR_PACK_FLOAT)
+	{
+		memcpy(out, in, n * sizeof(float));
+		return;
+	}
+	if (numThread <= 0)
+		numThread = sysconf(_SC_NPROCESSORS_ONLN);
+	if ((size_t)numThread > n / FIR_PACK_MIN_CHUNK)
+		numThread = n / FIR_PACK_MIN_CHUNK > 0 ? n / FIR_PACK_MIN_CHUNK : 1;
+
+	FIRPackChunk *chunk = (FIRPackChunk *) malloc(numThread * sizeof(FIRPackChunk));
+	pthread_t *thread = (pthread_t *) malloc(numThread * sizeof(pthread_t));
+	int *started = (int *) calloc(numThread, sizeof(int));
+	size_t per = ((n + numThread - 1) / numThread + 15) / 16 * 16;
+
+	for (t = 0; t < (size_t)numThread; t++)
+	{
+		size_t first = t * per < n ? t * per : n;
+		chunk[t].format = format;
+		chunk[t].isa = isa;
+		chunk[t].in = in + first;
+		chunk[t].out = (char *) out + first * FIRPackSize[format];
+		chunk[t].n = first + per < n ? per : n - first;
+		chunk[t].inv = 32767.f / fullScale;
+	}
+	// The calling thread takes the first chunk, and any chunk whose
+	// thread could not be started
+	for (t = 1; t < (size_t)numThread; t++)
+		started[t] = !pthread_create(&thread[t], NULL, FIRPackWorker, &chunk[t]);
+	for (t = 0; t < (size_t)numThread; t++)
+		if (!started[t])
+			FIRPackWorker(&chunk[t]);
+	for (t = 1; t < (size_t)numThread; t++)
+		if (started[t])
+			pthread_join(thread[t], NULL);
+	free(chunk);
+	free(thread);
+	free(started);
+}
+
+/*
+ * \brief Create a filter whose input travels to the device as format.
+ */
+int FIRPackedCreate(FIRPacked *pk, FIRDevice *dev, FIRPackFormat format,
+		cl_uint numTap, cl_uint numData, const cl_float *coeff, float fullScale)
+{
+	cl_int ret;
+
+	memset(pk, 0, sizeof(*pk));
+	pk->format = format;
+	pk->numTap = numTap;
+	pk->numData = numData;
+	pk->fullScale = fullScale;
+	pk->isa = FIRCpuDetect();
+
+	size_t winBytes = FIRPackSize[format] * (numTap - 1 + numData);
+	pk->staging = malloc(FIRPackSize[format] * numData);
+	pk->coeffBuffer = clCreateBuffer(dev->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			sizeof(cl_float) * numTap, (void *)coeff, &ret);
+	CHECK_STATUS( ret,"Error: Create coeff Buffer\n");
+	pk->window[0] = clCreateBuffer(dev->context, CL_MEM_READ_WRITE, winBytes, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create packed window Buffer\n");
+	pk->window[1] = clCreateBuffer(dev->context, CL_MEM_READ_WRITE, winBytes, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create packed window Buffer\n");
+	pk->outputBuffer = clCreateBuffer(dev->context, CL_MEM_WRITE_ONLY,
+			sizeof(cl_float) * numData, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create output Buffer\n");
+
+	// Zero history; zero is all-zero bits in every format
+	if (numTap > 1)
+	{
+		void *zero = calloc(numTap - 1, FIRPackSize[format]);
+		ret = clEnqueueWriteBuffer(dev->queue, pk->window[0], CL_TRUE, 0,
+				FIRPackSize[format] * (numTap - 1), zero, 0, NULL, NULL);
+		free(zero);
+		CHECK_STATUS( ret,"Error: Reset packed history\n");
+	}
+
+	pk->kernel = clCreateKernel(dev->program, FIRPackKernel[format], &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (FIR_packed)\n");
+	cl_float scale = format == FIR_PACK_INT16 ? fullScale / 32767.f : 1.f;
+	ret = clSetKernelArg(pk->kernel, 0, sizeof(cl_mem), (void *)&pk->outputBuffer);
+	ret |= clSetKernelArg(pk->kernel, 1, sizeof(cl_mem), (void *)&pk->coeffBuffer);
+	ret |= clSetKernelArg(pk->kernel, 3, sizeof(cl_uint), (void *)&numTap);
+	ret |= clSetKernelArg(pk->kernel, 4, sizeof(cl_uint), (void *)&numData);
+	ret |= clSetKernelArg(pk->kernel, 5, sizeof(cl_float), (void *)&scale);
+	CHECK_STATUS( ret,"Error: Set kernel arguments (FIR_packed)\n");
+
+	return 0;
+}
+
+/*
+ * \brief Convert, upload and filter one block of numData samples, carrying
+ * the history over from the previous block.  Host conversion time, upload
+ * time and kernel time (us) are added to the counters that are not NULL.
+ */
+int FIRPackedProcess(FIRPacked *pk, FIRDevice *dev, const cl_float *input,
+		cl_float *output, double *convertTime, double *uploadTime, double *kernelTime)
+{
+	cl_int ret;
+	cl_event event;
+	size_t size = FIRPackSize[pk->format];
+	cl_mem cur = pk->window[pk->block & 1];
+	cl_mem next = pk->window[(pk->block + 1) & 1];
+
+	double start = WallTime();
+	FIRPackConvert(pk->format, input, pk->staging, pk->numData, pk->fullScale,
+			pk->numThread, pk->isa);
+	if (convertTime)
+		*convertTime += WallTime() - start;
+
+	ret = clEnqueueWriteBuffer(dev->queue, cur, CL_TRUE, size * (pk->numTap - 1),
+			size * pk->numData, pk->staging, 0, NULL, &event);
+	CHECK_STATUS( ret,"Error: Write packed input\n");
+	if (uploadTime)
+		*uploadTime += FIREventTime(event);
+	clReleaseEvent(event);
+
+	// Next block's history is the tail of this window
+	if (pk->numTap > 1)
+	{
+		ret = clEnqueueCopyBuffer(dev->queue, cur, next, size * pk->numData, 0,
+				size * (pk->numTap - 1), 0, NULL, NULL);
+		CHECK_STATUS( ret,"Error: Copy packed history\n");
+	}
+
+	ret = clSetKernelArg(pk->kernel, 2, sizeof(cl_mem), (void *)&cur);
+	CHECK_STATUS( ret,"Error: Set packed window argument\n");
+	size_t localThreads[1] = {64};
+	size_t globalThreads[1] = {(pk->numData + 63) / 64 * 64};
+	ret = clEnqueueNDRangeKernel(dev->queue, pk->kernel, 1, NULL,
+			globalThreads, localThreads, 0, NULL, &event);
+	CHECK_STATUS( ret,"Error: Range kernel. (FIR_packed)\n");
+	if (kernelTime)
+		*kernelTime += FIREventTime(event);
+	clReleaseEvent(event);
+
+	ret = clEnqueueReadBuffer(dev->queue, pk->outputBuffer, CL_TRUE, 0,
+			sizeof(cl_float) * pk->numData, output, 0, NULL, NULL);
+	CHECK_STATUS( ret,"Error: Read packed output\n");
+
+	pk->block++;
+	return 0;
+}
+
+void FIRPackedRelease(FIRPacked *pk)
+{
+	clReleaseKernel(pk->kernel);
+	clReleaseMemObject(pk->outputBuffer);
+	clReleaseMemObject(pk->window[1]);
+	clReleaseMemObject(pk->window[0]);
+	clReleaseMemObject(pk->coeffBuffer);
+	free(pk->staging);
+}
+
+static int RunPacked(FIRDevice *dev, FIRPackFormat format, cl_uint numTap,
+		cl_uint numData, cl_uint numBlocks, const cl_float *coeff,
+		const cl_float *stream, cl_float *result)
+{
+	FIRPacked pk;
+	cl_uint b;
+	double convertTime = 0, uploadTime = 0, kernelTime = 0;
+
+	if (FIRPackedCreate(&pk, dev, format, numTap, numData, coeff, 1.0f))
+		return 1;
+	for (b = 0; b < numBlocks; b++)
+		if (FIRPackedProcess(&pk, dev, stream + (size_t)b * numData,
+					result + (size_t)b * numData, &convertTime, &uploadTime, &kernelTime))
+			return 1;
+	fprintf(stderr, "\t%-5s %zu B/sample  convert %8.2f us  upload %8.2f us  kernel %8.2f us per block\n",
+			FIRPackName[format], FIRPackSize[format], convertTime / numBlocks,
+			uploadTime / numBlocks, kernelTime / numBlocks);
+	FIRPackedRelease(&pk);
+	return 0;
+}
+
+/*
+ * \brief Filter numBlocks blocks through the float path and the format
+ * path, and report how far the reduced-precision output strays from the
+ * float one next to the worst case the format allows.
+ *
+ * The bound is sum|coeff| times the largest conversion error of one
+ * sample, plus the float rounding of both sums.
+ */
+int RunFIRPacked(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		cl_uint numBlocks, FIRPackFormat format)
+{
+	size_t i;
+	size_t numStream = (size_t)numData * numBlocks;
+
+	cl_float *stream = (cl_float *) malloc(numStream * sizeof(cl_float));
+	cl_float *ref = (cl_float *) malloc(numStream * sizeof(cl_float));
+	cl_float *result = (cl_float *) malloc(numStream * sizeof(cl_float));
+	cl_float *coeff = (cl_float *) malloc(numTap * sizeof(cl_float));
+	for (i = 0; i < numStream; i++)
+		stream[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+	for (i = 0; i < numTap; i++)
+		coeff[i] = 1.0f * rand() / RAND_MAX / numTap;
+
+	printf("FIR Filter (%s transfer)\n Blocks : %u \n Conversion : %s\n",
+			FIRPackName[format], numBlocks, FIRCpuISAName[FIRCpuDetect()]);
+	if (RunPacked(dev, FIR_PACK_FLOAT, numTap, numData, numBlocks, coeff, stream, ref) ||
+			RunPacked(dev, format, numTap, numData, numBlocks, coeff, stream, result))
+		return 1;
+
+	double sumC = 0, peak = 0, maxErr = 0, errSq = 0, refSq = 0;
+	for (i = 0; i < numTap; i++)
+		sumC += fabs(coeff[i]);
+	for (i = 0; i < numStream; i++)
+	{
+		double e = fabs((double) result[i] - ref[i]);
+		if (fabs(stream[i]) > peak)
+			peak = fabs(stream[i]);
+		if (e > maxErr)
+			maxErr = e;
+		errSq += e * e;
+		refSq += (double) ref[i] * ref[i];
+	}
+
+	// Largest error of one converted sample (full scale 1 for int16)
+	double quant = 0;
+	if (format == FIR_PACK_HALF)
+		quant = peak * ldexp(1, -11) + ldexp(1, -25);
+	else if (format == FIR_PACK_INT16)
+		quant = 0.501 / 32767 + (peak > 1 ? peak - 1 : 0);
+	double bound = sumC * quant + 2 * (numTap + 1) * ldexp(1, -24) * sumC * (peak + quant);
+
+	fprintf(stderr, "\tMax error: %g (bound %g), RMS error %g, SNR %.1f dB\n",
+			maxErr, bound, sqrt(errSq / numStream),
+			errSq > 0 ? 10 * log10(refSq / errSq) : INFINITY);
+
+	float *cpu_out = cpu_compute(stream, coeff, numTap, numStream);
+	int failed = FIRVerify(cpu_out, ref, numStream, 1e-4f);
+	if (!failed && !(maxErr <= bound))
+	{
+		printf("Error exceeds the %s bound\n", FIRPackName[format]);
+		failed = 1;
+	}
+	printf(failed ? "FIR Fail\n" : "FIR Successful\n");
+
+	free(cpu_out);
+	free(stream);
+	free(ref);
+	free(result);
+	free(coeff);
+	return failed;
+}
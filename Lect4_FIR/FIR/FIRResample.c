@@ -0,0 +1,280 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <CL/cl.h>
+#include "FIR.h"
+
+
+static cl_uint gcd(cl_uint a, cl_uint b)
+{
+	while (b)
+	{
+		cl_uint t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+/*
+ * \brief Create a resampler by up/down with the numTap taps in coeff.
+ *
+ * The factors are reduced first.  Any block size works: when numIn*up is
+ * not a multiple of down the number of outputs varies from block to block.
+ * up = 1 runs FIR_decimate, down = 1 FIR_interpolate and anything else
+ * FIR_resample.
+ */
+int FIRResamplerCreate(FIRResampler *rs, FIRDevice *dev, cl_uint up,
+		cl_uint down, cl_uint numTap, cl_uint numIn, const cl_float *coeff)
+{
+	cl_int ret;
+	cl_uint p, r;
+
+	memset(rs, 0, sizeof(*rs));
+	if (!up || !down)
+	{
+		printf("Error: resampling factors must be positive\n");
+		return 1;
+	}
+	cl_uint g = gcd(up, down);
+	up /= g;
+	down /= g;
+
+	rs->up = up;
+	rs->down = down;
+	rs->numTap = numTap;
+	rs->phaseTap = (numTap + up - 1) / up;
+	rs->numIn = numIn;
+	rs->numOut = (cl_uint)(((size_t)numIn * up + down - 1) / down);
+
+	/*
+	 * Phase p holds the taps that meet nonzero samples at output phase p,
+	 * in the order of the window (tap numTap-1-p-up*(phaseTap-1-r) of coeff,
+	 * zero where that runs off the front of the filter)
+	 */
+	cl_uint R = rs->phaseTap;
+	cl_float *phase = (cl_float *) calloc(up * R, sizeof(cl_float));
+	for (p = 0; p < up; p++)
+		for (r = 0; r < R; r++)
+		{
+			long k = (long)numTap - 1 - p - (long)up * (R - 1 - r);
+			if (k >= 0)
+				phase[p * R + r] = coeff[k];
+		}
+
+	rs->coeffBuffer = clCreateBuffer(dev->context,
+			CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			sizeof(cl_float) * up * R, phase, &ret);
+	free(phase);
+	CHECK_STATUS( ret,"Error: Create polyphase coeff Buffer\n");
+
+	size_t winBytes = sizeof(cl_float) * (numIn + R - 1);
+	rs->window[0] = clCreateBuffer(dev->context, CL_MEM_READ_WRITE, winBytes, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create resampler window Buffer\n");
+	rs->window[1] = clCreateBuffer(dev->context, CL_MEM_READ_WRITE, winBytes, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create resampler window Buffer\n");
+	rs->outputBuffer = clCreateBuffer(dev->context, CL_MEM_WRITE_ONLY,
+			sizeof(cl_float) * rs->numOut, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create resampler output Buffer\n");
+
+	if (up == 1)
+	{
+		rs->kernel = clCreateKernel(dev->program, "FIR_decimate", &ret);
+		CHECK_STATUS( ret,"Error: Create kernel. (FIR_decimate)\n");
+		ret = clSetKernelArg(rs->kernel, 3, sizeof(cl_uint), (void *)&numTap);
+		ret |= clSetKernelArg(rs->kernel, 4, sizeof(cl_uint), (void *)&down);
+	}
+	else if (down == 1)
+	{
+		rs->kernel = clCreateKernel(dev->program, "FIR_interpolate", &ret);
+		CHECK_STATUS( ret,"Error: Create kernel. (FIR_interpolate)\n");
+		ret = clSetKernelArg(rs->kernel, 3, sizeof(cl_uint), (void *)&up);
+		ret |= clSetKernelArg(rs->kernel, 4, sizeof(cl_uint), (void *)&R);
+		ret |= clSetKernelArg(rs->kernel, 5, sizeof(cl_uint), (void *)&numIn);
+	}
+	else
+	{
+		rs->kernel = clCreateKernel(dev->program, "FIR_resample", &ret);
+		CHECK_STATUS( ret,"Error: Create kernel. (FIR_resample)\n");
+		ret = clSetKernelArg(rs->kernel, 3, sizeof(cl_uint), (void *)&up);
+		ret |= clSetKernelArg(rs->kernel, 4, sizeof(cl_uint), (void *)&down);
+		ret |= clSetKernelArg(rs->kernel, 5, sizeof(cl_uint), (void *)&R);
+	}
+	ret |= clSetKernelArg(rs->kernel, 0, sizeof(cl_mem), (void *)&rs->outputBuffer);
+	ret |= clSetKernelArg(rs->kernel, 1, sizeof(cl_mem), (void *)&rs->coeffBuffer);
+	CHECK_STATUS( ret,"Error: Set resampler kernel arguments\n");
+
+	return FIRResamplerReset(rs, dev);
+}
+
+/*
+ * \brief Clear the history and the output phase.
+ */
+int FIRResamplerReset(FIRResampler *rs, FIRDevice *dev)
+{
+	cl_int ret = CL_SUCCESS;
+
+	rs->block = 0;
+	rs->first = 0;
+	if (rs->phaseTap > 1)
+	{
+		cl_float *zero = (cl_float *) calloc(rs->phaseTap - 1, sizeof(cl_float));
+		ret = clEnqueueWriteBuffer(dev->queue, rs->window[0], CL_TRUE, 0,
+				sizeof(cl_float) * (rs->phaseTap - 1), zero, 0, NULL, NULL);
+		free(zero);
+	}
+	CHECK_STATUS( ret,"Error: Reset resampler history\n");
+
+	return 0;
+}
+
+/*
+ * \brief Resample one block of numIn samples.  output needs room for
+ * rs->numOut samples; *numOut receives how many this block produced.  If
+ * event is not NULL it receives the kernel event (the caller releases it).
+ */
+int FIRResamplerProcess(FIRResampler *rs, FIRDevice *dev,
+		const cl_float *input, cl_float *output, cl_uint *numOut, cl_event *event)
+{
+	cl_int ret;
+	size_t numStuffed = (size_t)rs->numIn * rs->up;
+	cl_uint count = rs->first < numStuffed ?
+		(cl_uint)((numStuffed - rs->first + rs->down - 1) / rs->down) : 0;
+	cl_mem cur = rs->window[rs->block & 1];
+	cl_mem next = rs->window[(rs->block + 1) & 1];
+
+	ret = clEnqueueWriteBuffer(dev->queue, cur, CL_FALSE,
+			sizeof(cl_float) * (rs->phaseTap - 1), sizeof(cl_float) * rs->numIn,
+			input, 0, NULL, NULL);
+	CHECK_STATUS( ret,"Error: Write resampler input\n");
+
+	// Next block's history is the tail of this window
+	if (rs->phaseTap > 1)
+	{
+		ret = clEnqueueCopyBuffer(dev->queue, cur, next,
+				sizeof(cl_float) * rs->numIn, 0,
+				sizeof(cl_float) * (rs->phaseTap - 1), 0, NULL, NULL);
+		CHECK_STATUS( ret,"Error: Copy resampler history\n");
+	}
+
+	ret = clSetKernelArg(rs->kernel, 2, sizeof(cl_mem), (void *)&cur);
+	if (rs->up == 1)
+	{
+		ret |= clSetKernelArg(rs->kernel, 5, sizeof(cl_uint), (void *)&count);
+		ret |= clSetKernelArg(rs->kernel, 6, sizeof(cl_uint), (void *)&rs->first);
+	}
+	else if (rs->down > 1)
+	{
+		ret |= clSetKernelArg(rs->kernel, 6, sizeof(cl_uint), (void *)&count);
+		ret |= clSetKernelArg(rs->kernel, 7, sizeof(cl_uint), (void *)&rs->first);
+	}
+	CHECK_STATUS( ret,"Error: Set resampler block arguments\n");
+
+	size_t local = 64;
+	size_t numItem = rs->up > 1 && rs->down == 1 ? rs->numIn : count;
+	if (numItem == 0)
+		numItem = 1;
+	size_t localThreads[1] = {local};
+	size_t globalThreads[1] = {(numItem + local - 1) / local * local};
+	ret = clEnqueueNDRangeKernel(dev->queue, rs->kernel, 1, NULL,
+			globalThreads, localThreads, 0, NULL, event);
+	CHECK_STATUS( ret,"Error: Range kernel. (FIR resampler)\n");
+
+	if (count)
+	{
+		ret = clEnqueueReadBuffer(dev->queue, rs->outputBuffer, CL_TRUE, 0,
+				sizeof(cl_float) * count, output, 0, NULL, NULL);
+		CHECK_STATUS( ret,"Error: Read resampler output\n");
+	}
+	else
+		clFinish(dev->queue);
+
+	// Where the next block's first output falls, relative to its start
+	rs->first = (cl_uint)(rs->first + (size_t)count * rs->down - numStuffed);
+	*numOut = count;
+	rs->block++;
+	return 0;
+}
+
+void FIRResamplerRelease(FIRResampler *rs)
+{
+	clReleaseKernel(rs->kernel);
+	clReleaseMemObject(rs->outputBuffer);
+	clReleaseMemObject(rs->window[1]);
+	clReleaseMemObject(rs->window[0]);
+	clReleaseMemObject(rs->coeffBuffer);
+}
+
+/*
+ * \brief Resample numBlocks blocks of numData samples by up/down and check
+ * the stream against cpu_compute on the zero-stuffed input, kept every
+ * down-th sample.  The output count per block varies unless numData*up is
+ * a multiple of down, so the check also covers the phase carried across
+ * blocks.
+ */
+int RunFIRResample(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		cl_uint numBlocks, cl_uint up, cl_uint down)
+{
+	cl_uint i, b;
+	size_t numStream = (size_t)numData * numBlocks;
+
+	cl_float *coeff = (cl_float *) malloc(numTap * sizeof(cl_float));
+	cl_float *stream = (cl_float *) malloc(numStream * sizeof(cl_float));
+	for (i = 0; i < numStream; i++)
+		stream[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+	for (i = 0; i < numTap; i++)
+		coeff[i] = 1.0f * rand() / RAND_MAX / numTap;
+
+	FIRResampler rs;
+	if (FIRResamplerCreate(&rs, dev, up, down, numTap, numData, coeff))
+		return 1;
+	printf("FIR Resampler\n Rate : %u/%u \n Taps per phase : %u \n Blocks : %u\n",
+			rs.up, rs.down, rs.phaseTap, numBlocks);
+
+	size_t numResult = 0;
+	cl_float *result = (cl_float *) malloc((size_t)rs.numOut * numBlocks * sizeof(cl_float));
+	cl_uint minOut = rs.numOut, maxOut = 0;
+	double kernelTime = 0;
+	for (b = 0; b < numBlocks; b++)
+	{
+		cl_event event;
+		cl_uint count;
+		if (FIRResamplerProcess(&rs, dev, stream + (size_t)b * numData,
+					result + numResult, &count, &event))
+			return 1;
+		kernelTime += FIREventTime(event);
+		clReleaseEvent(event);
+		numResult += count;
+		minOut = count < minOut ? count : minOut;
+		maxOut = count > maxOut ? count : maxOut;
+	}
+
+	fprintf(stderr, "\tOutputs per block: %u to %u\n", minOut, maxOut);
+	fprintf(stderr, "\tKernel exec time: %8.2f us per block\n", kernelTime / numBlocks);
+	fprintf(stderr, "\tThroughput: %8.2f Msamples/s in, %8.2f Msamples/s out\n",
+			numStream / kernelTime, numResult / kernelTime);
+
+	// Reference: full-rate filter of the zero-stuffed stream
+	size_t numStuffed = numStream * rs.up;
+	cl_float *stuffed = (cl_float *) calloc(numStuffed, sizeof(cl_float));
+	for (i = 0; i < numStream; i++)
+		stuffed[(size_t)i * rs.up] = stream[i];
+	float *full = cpu_compute(stuffed, coeff, numTap, numStuffed);
+	float *cpu_out = (float *) malloc(numResult * sizeof(float));
+	for (i = 0; i < numResult; i++)
+		cpu_out[i] = full[(size_t)i * rs.down];
+
+	int failed = numResult != (numStuffed + rs.down - 1) / rs.down ||
+		FIRVerify(cpu_out, result, numResult, 1e-4f);
+	printf(failed ? "FIR Fail\n" : "FIR Successful\n");
+
+	FIRResamplerRelease(&rs);
+	free(stuffed);
+	free(full);
+	free(cpu_out);
+	free(result);
+	free(stream);
+	free(coeff);
+	return failed;
+}
@@ -0,0 +1,314 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <CL/cl.h>
+#include "FIR.h"
+
+
+/* Samples the synthetic producer delivers at a time */
+#define FIR_RING_CHUNK 256
+
+/*
+ * \brief Create a ring of at least capacity samples (rounded up to a power
+ * of two so indices wrap with a mask).
+ */
+int FIRRingCreate(FIRRing *ring, size_t capacity)
+{
+	size_t size = 1;
+
+	memset(ring, 0, sizeof(*ring));
+	while (size < capacity)
+		size *= 2;
+	ring->buffer = (cl_float *) malloc(size * sizeof(cl_float));
+	if (!ring->buffer)
+	{
+		printf("Error: allocate ring of %zu samples\n", size);
+		return 1;
+	}
+	ring->mask = size - 1;
+	return 0;
+}
+
+void FIRRingRelease(FIRRing *ring)
+{
+	free(ring->buffer);
+}
+
+/*
+ * \brief Producer side: copy up to n samples in without blocking and return
+ * how many fit.  Only the producer thread may call this.
+ */
+size_t FIRRingWrite(FIRRing *ring, const cl_float *src, size_t n)
+{
+	size_t head = ring->head;
+	size_t size = ring->mask + 1;
+
+	// Re-read the consumer index only when the cached one says "full"
+	if (size - (head - ring->tailCache) < n)
+		ring->tailCache = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	size_t space = size - (head - ring->tailCache);
+	if (n > space)
+		n = space;
+
+	size_t pos = head & ring->mask;
+	size_t first = n < size - pos ? n : size - pos;
+	memcpy(ring->buffer + pos, src, first * sizeof(cl_float));
+	memcpy(ring->buffer, src + first, (n - first) * sizeof(cl_float));
+
+	__atomic_store_n(&ring->head, head + n, __ATOMIC_RELEASE);
+	return n;
+}
+
+/*
+ * \brief Consumer side: copy out up to n samples without blocking and
+ * return how many were available.  Only the consumer thread may call this.
+ */
+size_t FIRRingRead(FIRRing *ring, cl_float *dst, size_t n)
+{
+	size_t tail = ring->tail;
+	size_t size = ring->mask + 1;
+
+	if (ring->headCache - tail < n)
+		ring->headCache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	size_t avail = ring->headCache - tail;
+	if (n > avail)
+		n = avail;
+
+	size_t pos = tail & ring->mask;
+	size_t first = n < size - pos ? n : size - pos;
+	memcpy(dst, ring->buffer + pos, first * sizeof(cl_float));
+	memcpy(dst + first, ring->buffer, (n - first) * sizeof(cl_float));
+
+	__atomic_store_n(&ring->tail, tail + n, __ATOMIC_RELEASE);
+	return n;
+}
+
+/* Samples waiting in the ring, as seen by the consumer */
+size_t FIRRingAvailable(FIRRing *ring)
+{
+	return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - ring->tail;
+}
+
+/* State shared by the producer and the submission thread */
+typedef struct {
+	FIRRing ring;
+	FIRDevice *dev;          /* NULL: filter on the CPU (FIRCpu) */
+	cl_uint numTap;
+	cl_uint numData;
+	const cl_float *coeff;
+	const cl_float *source;  /* samples the producer delivers, in order */
+	size_t numSource;
+	double rate;             /* samples per us, 0 = as fast as possible */
+	int drop;                /* drop on full ring instead of waiting */
+	int done;                /* set by the producer when it has finished */
+	FIRRingStats stats;
+	cl_float *consumed;      /* what the submission thread read, for checking */
+	cl_float *result;
+	double kernelTime;
+	int failed;
+} FIRRingPipeline;
+
+/*
+ * Synthetic live source: delivers the source samples in FIR_RING_CHUNK
+ * chunks at the requested rate.  A full ring either drops the rest of the
+ * chunk (overrun) or makes the producer wait (backpressure).
+ */
+static void *RingProducer(void *arg)
+{
+	FIRRingPipeline *p = (FIRRingPipeline *) arg;
+	size_t sent = 0;
+	double start = WallTime();
+
+	while (sent < p->numSource)
+	{
+		size_t n = p->numSource - sent < FIR_RING_CHUNK ?
+			p->numSource - sent : FIR_RING_CHUNK;
+
+		if (p->rate > 0)
+		{
+			// Wait until this chunk is due
+			double due = start + sent / p->rate;
+			double now = WallTime();
+			if (due > now)
+			{
+				struct timespec ts = {0, (long)((due - now) * 1e3)};
+				nanosleep(&ts, NULL);
+			}
+		}
+
+		size_t done = FIRRingWrite(&p->ring, p->source + sent, n);
+		while (done < n && !p->drop)
+		{
+			p->stats.backpressure++;
+			sched_yield();
+			done += FIRRingWrite(&p->ring, p->source + sent + done, n - done);
+		}
+		p->stats.overrun += n - done;
+		p->stats.produced += n;
+		sent += n;
+	}
+
+	__atomic_store_n(&p->done, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+/*
+ * Submission thread: pulls numData-sample blocks out of the ring and runs
+ * them through the FIR filter with carried history, until the producer is
+ * done and less than a block is left.
+ */
+static void *RingSubmitter(void *arg)
+{
+	FIRRingPipeline *p = (FIRRingPipeline *) arg;
+	FIRBank bank;
+	FIRCpu cpu;
+	cl_uint zero = 0;
+	size_t numRead = 0;
+
+	if (p->dev ? FIRBankCreate(&bank, p->dev, 1, p->numTap, p->numData,
+				p->coeff, 1, &zero) :
+			FIRCpuCreate(&cpu, p->numTap, p->coeff, 0, FIRCpuDetect()))
+	{
+		p->failed = 1;
+		return NULL;
+	}
+
+	for (;;)
+	{
+		size_t avail = FIRRingAvailable(&p->ring);
+		if (avail > p->stats.maxFill)
+			p->stats.maxFill = avail;
+		if (avail < p->numData)
+		{
+			if (__atomic_load_n(&p->done, __ATOMIC_ACQUIRE) &&
+					FIRRingAvailable(&p->ring) < p->numData)
+				break;
+			p->stats.underrun++;
+			sched_yield();
+			continue;
+		}
+
+		cl_float *block = p->consumed + numRead;
+		cl_float *out = p->result + numRead;
+		FIRRingRead(&p->ring, block, p->numData);
+		if (p->dev)
+		{
+			cl_event event;
+			if (FIRBankProcess(&bank, p->dev, block, out, &event))
+			{
+				p->failed = 1;
+				break;
+			}
+			p->kernelTime += FIREventTime(event);
+			clReleaseEvent(event);
+		}
+		else
+			FIRCpuProcess(&cpu, block, out, p->numData);
+		numRead += p->numData;
+		p->stats.blocks++;
+	}
+
+	p->stats.tail = FIRRingAvailable(&p->ring);
+	if (p->dev)
+		FIRBankRelease(&bank);
+	else
+		FIRCpuRelease(&cpu);
+	return NULL;
+}
+
+/*
+ * \brief Load-test the live ingestion path: a synthetic producer thread
+ * feeds numBlocks blocks through the ring to the submission thread.
+ *
+ * rate is in Msamples/s (0 = unthrottled).  dev = NULL filters on the CPU,
+ * so the path can be exercised without an OpenCL device.  Whatever reached
+ * the filter is checked against cpu_compute; without drop nothing may be
+ * lost on the way.
+ */
+int RunFIRRing(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		cl_uint numBlocks, double rate, int drop)
+{
+	FIRRingPipeline p;
+	cl_uint i;
+
+	memset(&p, 0, sizeof(p));
+	p.dev = dev;
+	p.numTap = numTap;
+	p.numData = numData;
+	p.numSource = (size_t)numData * numBlocks;
+	p.rate = rate;
+	p.drop = drop;
+	if (FIRRingCreate(&p.ring, 8 * (size_t)numData))
+		return 1;
+
+	cl_float *coeff = (cl_float *) malloc(numTap * sizeof(cl_float));
+	cl_float *source = (cl_float *) malloc(p.numSource * sizeof(cl_float));
+	p.consumed = (cl_float *) malloc(p.numSource * sizeof(cl_float));
+	p.result = (cl_float *) malloc(p.numSource * sizeof(cl_float));
+	for (i = 0; i < numTap; i++)
+		coeff[i] = 1.0f * rand() / RAND_MAX / numTap;
+	for (i = 0; i < p.numSource; i++)
+		source[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+	p.coeff = coeff;
+	p.source = source;
+
+	printf("FIR Filter (ring ingestion, %s)\n Ring : %zu samples \n Blocks : %u \n Rate : ",
+			dev ? "device" : "CPU", p.ring.mask + 1, numBlocks);
+	if (rate > 0)
+		printf("%.2f Msamples/s, %s when full\n", rate, drop ? "drop" : "wait");
+	else
+		printf("unthrottled, %s when full\n", drop ? "drop" : "wait");
+
+	pthread_t producer, submitter;
+	double start = WallTime();
+	if (pthread_create(&submitter, NULL, RingSubmitter, &p) ||
+			pthread_create(&producer, NULL, RingProducer, &p))
+	{
+		printf("Error: start ring threads\n");
+		return 1;
+	}
+	pthread_join(producer, NULL);
+	pthread_join(submitter, NULL);
+	double time = WallTime() - start;
+
+	FIRRingStats *s = &p.stats;
+	size_t numOut = (size_t)s->blocks * numData;
+	fprintf(stderr, "\tWall time: %8.2f us, %8.2f Msamples/s filtered\n",
+			time, numOut / time);
+	if (dev)
+		fprintf(stderr, "\tKernel exec time: %8.2f us per block\n",
+				s->blocks ? p.kernelTime / s->blocks : 0.0);
+	fprintf(stderr, "\tProduced %lu, filtered %lu, overrun %lu, left in ring %lu samples\n",
+			(unsigned long)s->produced, (unsigned long)numOut,
+			(unsigned long)s->overrun, (unsigned long)s->tail);
+	fprintf(stderr, "\tBackpressure waits %lu, underrun waits %lu, peak fill %lu\n",
+			(unsigned long)s->backpressure, (unsigned long)s->underrun,
+			(unsigned long)s->maxFill);
+
+	int failed = p.failed;
+	if (!failed && !drop && (s->overrun ||
+				memcmp(p.consumed, source, numOut * sizeof(cl_float))))
+	{
+		printf("Samples lost or reordered in the ring\n");
+		failed = 1;
+	}
+	if (!failed && numOut)
+	{
+		float *cpu_out = cpu_compute(p.consumed, coeff, numTap, numOut);
+		failed = FIRVerify(cpu_out, p.result, numOut, 1e-4f);
+		free(cpu_out);
+	}
+	printf(failed ? "FIR Fail\n" : "FIR Successful\n");
+
+	FIRRingRelease(&p.ring);
+	free(coeff);
+	free(source);
+	free(p.consumed);
+	free(p.result);
+	return failed;
+}
@@ -0,0 +1,287 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <CL/cl.h>
+#include "FIR.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+
+/*
+ * \brief Create the filter and spectrogram stages: numTap taps, blocks of
+ * numData samples, frames of N samples every hop samples, Hann window.
+ */
+int FIRStftCreate(FIRStft *st, FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		const cl_float *coeff, cl_uint N, cl_uint hop)
+{
+	cl_int ret;
+	cl_uint zero = 0;
+	cl_uint i;
+
+	memset(st, 0, sizeof(*st));
+	if (!hop || hop > N)
+	{
+		printf("Error: hop size %u must be between 1 and the frame length %u\n", hop, N);
+		return 1;
+	}
+	if (FFTPlanCreate(&st->fft, dev, N))
+		return 1;
+	if (FIRBankCreate(&st->bank, dev, 1, numTap, numData, coeff, 1, &zero))
+		return 1;
+
+	st->N = N;
+	st->hop = hop;
+	st->numBin = N / 2 + 1;
+	st->numData = numData;
+	st->maxFrame = (numData - 1) / hop + 1;
+
+	// Fewer than N samples are ever left pending after the frames are taken
+	size_t sampleBytes = sizeof(cl_float) * (N - 1 + numData);
+	size_t frameBytes = sizeof(cl_float2) * N * st->maxFrame;
+	st->samples[0] = clCreateBuffer(dev->context, CL_MEM_READ_WRITE, sampleBytes, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create STFT sample Buffer\n");
+	st->samples[1] = clCreateBuffer(dev->context, CL_MEM_READ_WRITE, sampleBytes, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create STFT sample Buffer\n");
+	st->frame = clCreateBuffer(dev->context, CL_MEM_READ_WRITE, frameBytes, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create STFT frame Buffer\n");
+	st->scratch = clCreateBuffer(dev->context, CL_MEM_READ_WRITE, frameBytes, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create STFT scratch Buffer\n");
+	st->power = clCreateBuffer(dev->context, CL_MEM_WRITE_ONLY,
+			sizeof(cl_float) * st->numBin * st->maxFrame, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create STFT power Buffer\n");
+
+	cl_float *w = (cl_float *) malloc(N * sizeof(cl_float));
+	for (i = 0; i < N; i++)
+		w[i] = 0.5f - 0.5f * cos(2 * M_PI * i / N);
+	st->window = clCreateBuffer(dev->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			sizeof(cl_float) * N, w, &ret);
+	free(w);
+	CHECK_STATUS( ret,"Error: Create STFT window Buffer\n");
+
+	st->frameKernel = clCreateKernel(dev->program, "FIR_stft_frame", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (FIR_stft_frame)\n");
+	st->powerKernel = clCreateKernel(dev->program, "FIR_stft_power", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (FIR_stft_power)\n");
+
+	ret = clSetKernelArg(st->frameKernel, 1, sizeof(cl_mem), (void *)&st->window);
+	ret |= clSetKernelArg(st->frameKernel, 3, sizeof(cl_uint), (void *)&N);
+	ret |= clSetKernelArg(st->frameKernel, 4, sizeof(cl_uint), (void *)&hop);
+	ret |= clSetKernelArg(st->powerKernel, 1, sizeof(cl_mem), (void *)&st->power);
+	ret |= clSetKernelArg(st->powerKernel, 2, sizeof(cl_uint), (void *)&N);
+	CHECK_STATUS( ret,"Error: Set STFT kernel arguments\n");
+
+	return 0;
+}
+
+static int EnqueueTimed(FIRDevice *dev, cl_kernel kernel, size_t *globalThreads,
+		double *time)
+{
+	cl_event event;
+	cl_int ret = clEnqueueNDRangeKernel(dev->queue, kernel, 2, NULL,
+			globalThreads, NULL, 0, NULL, &event);
+	CHECK_STATUS( ret,"Error: Range kernel. (STFT)\n");
+	if (time)
+		*time += FIREventTime(event);
+	clReleaseEvent(event);
+	return 0;
+}
+
+/*
+ * \brief Filter one block and transform every frame it completes.
+ *
+ * *numFrame receives the number of frames, and power their numBin power
+ * values each (room for maxFrame frames).  The filtered block is appended
+ * to the pending samples on the device and only the power spectra are read
+ * back.  The kernel time of every launch is added to *time when time is
+ * not NULL.
+ */
+int FIRStftProcess(FIRStft *st, FIRDevice *dev, const cl_float *input,
+		cl_float *power, cl_uint *numFrame, double *time)
+{
+	cl_int ret;
+	cl_mem cur = st->samples[st->block & 1];
+	cl_mem next = st->samples[(st->block + 1) & 1];
+	cl_event event;
+
+	if (FIRBankProcess(&st->bank, dev, input, NULL, &event))
+		return 1;
+	if (time)
+		*time += FIREventTime(event);
+	clReleaseEvent(event);
+
+	ret = clEnqueueCopyBuffer(dev->queue, st->bank.outputBuffer, cur, 0,
+			sizeof(cl_float) * st->pending, sizeof(cl_float) * st->numData,
+			0, NULL, NULL);
+	CHECK_STATUS( ret,"Error: Append filtered block\n");
+
+	cl_uint avail = st->pending + st->numData;
+	cl_uint frames = avail >= st->N ? (avail - st->N) / st->hop + 1 : 0;
+	*numFrame = frames;
+
+	if (frames)
+	{
+		size_t frameThreads[2] = {st->N, frames};
+		// FFTEnqueue may have swapped frame and scratch
+		ret = clSetKernelArg(st->frameKernel, 0, sizeof(cl_mem), (void *)&cur);
+		ret |= clSetKernelArg(st->frameKernel, 2, sizeof(cl_mem), (void *)&st->frame);
+		CHECK_STATUS( ret,"Error: Set STFT frame input\n");
+		if (EnqueueTimed(dev, st->frameKernel, frameThreads, time))
+			return 1;
+
+		if (FFTEnqueue(&st->fft, dev, &st->frame, &st->scratch, frames, -1, time))
+			return 1;
+
+		size_t binThreads[2] = {st->numBin, frames};
+		ret = clSetKernelArg(st->powerKernel, 0, sizeof(cl_mem), (void *)&st->frame);
+		CHECK_STATUS( ret,"Error: Set STFT power input\n");
+		if (EnqueueTimed(dev, st->powerKernel, binThreads, time))
+			return 1;
+	}
+
+	// Samples from the next frame start on are kept for the next block
+	cl_uint consumed = frames * st->hop;
+	st->pending = avail - consumed;
+	if (st->pending)
+	{
+		ret = clEnqueueCopyBuffer(dev->queue, cur, next,
+				sizeof(cl_float) * consumed, 0, sizeof(cl_float) * st->pending,
+				0, NULL, NULL);
+		CHECK_STATUS( ret,"Error: Copy pending samples\n");
+	}
+
+	if (frames)
+	{
+		ret = clEnqueueReadBuffer(dev->queue, st->power, CL_TRUE, 0,
+				sizeof(cl_float) * st->numBin * frames, power, 0, NULL, NULL);
+		CHECK_STATUS( ret,"Error: Read STFT power\n");
+	}
+	else
+		clFinish(dev->queue);  // the input upload must be done before returning
+
+	st->block++;
+	return 0;
+}
+
+void FIRStftRelease(FIRStft *st)
+{
+	clReleaseKernel(st->frameKernel);
+	clReleaseKernel(st->powerKernel);
+	clReleaseMemObject(st->power);
+	clReleaseMemObject(st->scratch);
+	clReleaseMemObject(st->frame);
+	clReleaseMemObject(st->window);
+	clReleaseMemObject(st->samples[1]);
+	clReleaseMemObject(st->samples[0]);
+	FIRBankRelease(&st->bank);
+	FFTPlanRelease(&st->fft);
+}
+
+/* In-place radix-2 FFT of N = 2^m complex doubles (re, im interleaved) */
+static void cpu_fft(double *x, cl_uint N)
+{
+	cl_uint i, j, len, k;
+
+	for (i = 1, j = 0; i < N; i++)
+	{
+		cl_uint bit = N >> 1;
+		for (; j & bit; bit >>= 1)
+			j ^= bit;
+		j |= bit;
+		if (i < j)
+		{
+			double t = x[2 * i]; x[2 * i] = x[2 * j]; x[2 * j] = t;
+			t = x[2 * i + 1]; x[2 * i + 1] = x[2 * j + 1]; x[2 * j + 1] = t;
+		}
+	}
+	for (len = 2; len <= N; len *= 2)
+		for (i = 0; i < N; i += len)
+			for (k = 0; k < len / 2; k++)
+			{
+				double c = cos(-2 * M_PI * k / len), s = sin(-2 * M_PI * k / len);
+				double *a = x + 2 * (i + k), *b = x + 2 * (i + k + len / 2);
+				double re = b[0] * c - b[1] * s, im = b[0] * s + b[1] * c;
+				b[0] = a[0] - re;
+				b[1] = a[1] - im;
+				a[0] += re;
+				a[1] += im;
+			}
+}
+
+/*
+ * \brief Spectrogram of numBlocks filtered blocks, checked against the
+ * CPU filter followed by a double-precision FFT of every frame.
+ */
+int RunFIRStft(FIRDevice *dev, cl_uint numTap, cl_uint numData,
+		cl_uint numBlocks, cl_uint N, cl_uint hop)
+{
+	size_t i;
+	cl_uint b, f, k;
+	size_t numStream = (size_t)numData * numBlocks;
+
+	cl_float *stream = (cl_float *) malloc(numStream * sizeof(cl_float));
+	cl_float *coeff = (cl_float *) malloc(numTap * sizeof(cl_float));
+	for (i = 0; i < numStream; i++)
+		stream[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+	for (i = 0; i < numTap; i++)
+		coeff[i] = 1.0f * rand() / RAND_MAX / numTap;
+
+	FIRStft st;
+	if (FIRStftCreate(&st, dev, numTap, numData, coeff, N, hop))
+		return 1;
+	printf("FIR Filter + STFT\n Frame : %u samples, hop %u \n Bins : %u \n Blocks : %u\n",
+			N, hop, st.numBin, numBlocks);
+
+	size_t maxTotal = numStream >= N ? (numStream - N) / hop + 1 : 0;
+	cl_float *spectrogram = (cl_float *) malloc((maxTotal + st.maxFrame) *
+			st.numBin * sizeof(cl_float));
+	size_t numFrame = 0;
+	double time = 0;
+	for (b = 0; b < numBlocks; b++)
+	{
+		cl_uint frames;
+		if (FIRStftProcess(&st, dev, stream + (size_t)b * numData,
+					spectrogram + numFrame * st.numBin, &frames, &time))
+			return 1;
+		numFrame += frames;
+	}
+	FIRStftRelease(&st);
+
+	fprintf(stderr, "\tKernel exec time: %8.2f us per block\n", time / numBlocks);
+	fprintf(stderr, "\tThroughput: %8.2f Msamples/s, %zu frames\n",
+			numStream / time, numFrame);
+	fprintf(stderr, "\tRead back: %zu bytes of spectra instead of %zu of samples\n",
+			numFrame * st.numBin * sizeof(cl_float), numStream * sizeof(cl_float));
+
+	// Reference: CPU filter, then window and FFT every frame in double
+	int failed = numFrame != maxTotal;
+	if (failed)
+		printf("Expected %zu frames, got %zu\n", maxTotal, numFrame);
+	float *filtered = cpu_compute(stream, coeff, numTap, numStream);
+	float *ref = (float *) malloc(maxTotal * st.numBin * sizeof(float));
+	double *x = (double *) malloc(2 * N * sizeof(double));
+	for (f = 0; f < maxTotal; f++)
+	{
+		for (k = 0; k < N; k++)
+		{
+			x[2 * k] = filtered[(size_t)f * hop + k] * (0.5 - 0.5 * cos(2 * M_PI * k / N));
+			x[2 * k + 1] = 0;
+		}
+		cpu_fft(x, N);
+		for (k = 0; k < st.numBin; k++)
+			ref[(size_t)f * st.numBin + k] = x[2 * k] * x[2 * k] + x[2 * k + 1] * x[2 * k + 1];
+	}
+	if (!failed)
+		failed = FIRVerify(ref, spectrogram, maxTotal * st.numBin, 1e-4f);
+	printf(failed ? "FIR Fail\n" : "FIR Successful\n");
+
+	free(x);
+	free(ref);
+	free(filtered);
+	free(spectrogram);
+	free(stream);
+	free(coeff);
+	return failed;
+}
@@ -0,0 +1,312 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdbool.h>
+#include <CL/cl.h>
+#include "FIR.h"
+
+
+const char *FIRVariantName[FIR_NUM_VARIANT] = {
+	"direct",
+	"local",
+	"blocked4",
+	"blocked8",
+	"blocked16",
+	"symmetric",
+	"fft",
+};
+
+int FIRIsSymmetric(const cl_float *coeff, cl_uint numTap)
+{
+	cl_uint i;
+
+	for (i = 0; i < numTap / 2; i++)
+		if (coeff[i] != coeff[numTap - 1 - i])
+			return 0;
+	return 1;
+}
+
+/*
+ * \brief Filter one block of numData samples with the given kernel variant.
+ *
+ * The history is zero, so the result matches cpu_compute.  The kernel runs
+ * numIter times; the average kernel time in microseconds goes to *time.
+ */
+int FIRRunVariant(FIRDevice *dev, FIRVariant variant, cl_uint numTap,
+		cl_uint numData, const cl_float *coeff, const cl_float *input,
+		cl_float *output, int numIter, double *time)
+{
+	cl_int ret;
+	size_t local = 64;
+	size_t globalThreads[1];
+	size_t localThreads[1] = {local};
+	cl_kernel kernel = NULL;
+	int i;
+
+	if (variant == FIR_VARIANT_FFT)
+		return FIRFFTRunBlock(dev, numTap, numData, coeff, input, output,
+				numIter, time);
+
+	// The symmetric kernel only needs the first half of the taps
+	cl_uint numCoeff = numTap;
+	if (variant == FIR_VARIANT_SYMMETRIC)
+	{
+		if (!FIRIsSymmetric(coeff, numTap))
+		{
+			printf("Error: symmetric kernel needs mirrored taps\n");
+			return 1;
+		}
+		numCoeff = (numTap + 1) / 2;
+	}
+
+	cl_mem outputBuffer = clCreateBuffer(dev->context, CL_MEM_WRITE_ONLY,
+			sizeof(cl_float) * numData, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create output Buffer\n");
+	cl_mem coeffBuffer = clCreateBuffer(dev->context,
+			CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			sizeof(cl_float) * numCoeff, (void *)coeff, &ret);
+	CHECK_STATUS( ret,"Error: Create coeff buffer Buffer\n");
+	cl_mem tempInputBuffer = clCreateBuffer(dev->context, CL_MEM_READ_ONLY,
+			sizeof(cl_float) * (numData+numTap-1), NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create temp input Buffer\n");
+
+	// Zero history followed by the block
+	cl_float *history = (cl_float *) calloc(numTap, sizeof(cl_float));
+	ret = CL_SUCCESS;
+	if (numTap > 1)
+		ret = clEnqueueWriteBuffer(dev->queue, tempInputBuffer, CL_TRUE, 0,
+				(numTap-1) * sizeof(cl_float), history, 0, NULL, NULL);
+	ret |= clEnqueueWriteBuffer(dev->queue, tempInputBuffer, CL_TRUE,
+			(numTap-1) * sizeof(cl_float), numData * sizeof(cl_float),
+			input, 0, NULL, NULL);
+	free(history);
+	CHECK_STATUS( ret,"Error: Write temp input Buffer\n");
+
+	switch (variant)
+	{
+	case FIR_VARIANT_DIRECT:
+		// One work-item per output, numData must be a multiple of local
+		kernel = clCreateKernel(dev->program, "FIR", &ret);
+		CHECK_STATUS( ret,"Error: Create kernel. (FIR)\n");
+		ret = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&outputBuffer);
+		ret |= clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&coeffBuffer);
+		ret |= clSetKernelArg(kernel, 2, sizeof(cl_mem), (void *)&tempInputBuffer);
+		ret |= clSetKernelArg(kernel, 3, sizeof(cl_uint), (void *)&numTap);
+		CHECK_STATUS( ret,"Error: Set kernel arguments (FIR)\n");
+		if (numData % local)
+		{
+			printf("Error: direct kernel needs numData to be a multiple of %zu\n", local);
+			return 1;
+		}
+		globalThreads[0] = numData;
+		break;
+
+	case FIR_VARIANT_LOCAL:
+	{
+		cl_ulong localMem = 0;
+		cl_ulong constMem = 0;
+		clGetDeviceInfo(dev->device, CL_DEVICE_LOCAL_MEM_SIZE,
+				sizeof(cl_ulong), &localMem, NULL);
+		clGetDeviceInfo(dev->device, CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE,
+				sizeof(cl_ulong), &constMem, NULL);
+
+		// Stage the whole (local + numTap - 1) window when it fits in
+		// half of the local memory, otherwise tile the taps
+		cl_uint tapTile = numTap;
+		cl_ulong maxWindow = localMem / 2 / sizeof(cl_float);
+		if (local + tapTile - 1 > maxWindow)
+			tapTile = maxWindow - local + 1;
+
+		bool useConstant = numTap * sizeof(cl_float) <= constMem;
+		kernel = clCreateKernel(dev->program,
+				useConstant ? "FIR_local" : "FIR_local_global", &ret);
+		CHECK_STATUS( ret,"Error: Create kernel. (FIR_local)\n");
+		ret = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&outputBuffer);
+		ret |= clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&coeffBuffer);
+		ret |= clSetKernelArg(kernel, 2, sizeof(cl_mem), (void *)&tempInputBuffer);
+		ret |= clSetKernelArg(kernel, 3, (local + tapTile - 1) * sizeof(cl_float), NULL);
+		ret |= clSetKernelArg(kernel, 4, sizeof(cl_uint), (void *)&numTap);
+		ret |= clSetKernelArg(kernel, 5, sizeof(cl_uint), (void *)&numData);
+		ret |= clSetKernelArg(kernel, 6, sizeof(cl_uint), (void *)&tapTile);
+		CHECK_STATUS( ret,"Error: Set kernel arguments (FIR_local)\n");
+		globalThreads[0] = (numData + local - 1) / local * local;
+		break;
+	}
+
+	case FIR_VARIANT_BLOCKED4:
+	case FIR_VARIANT_BLOCKED8:
+	case FIR_VARIANT_BLOCKED16:
+	{
+		// Each work-item produces numOut consecutive outputs
+		cl_uint numOut = 4 << (variant - FIR_VARIANT_BLOCKED4);
+		char name[32];
+		sprintf(name, "FIR_blocked%u", numOut);
+		kernel = clCreateKernel(dev->program, name, &ret);
+		CHECK_STATUS( ret,"Error: Create kernel. (FIR_blocked)\n");
+		ret = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&outputBuffer);
+		ret |= clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&coeffBuffer);
+		ret |= clSetKernelArg(kernel, 2, sizeof(cl_mem), (void *)&tempInputBuffer);
+		ret |= clSetKernelArg(kernel, 3, sizeof(cl_uint), (void *)&numTap);
+		ret |= clSetKernelArg(kernel, 4, sizeof(cl_uint), (void *)&numData);
+		CHECK_STATUS( ret,"Error: Set kernel arguments (FIR_blocked)\n");
+		size_t numItem = (numData + numOut - 1) / numOut;
+		globalThreads[0] = (numItem + local - 1) / local * local;
+		break;
+	}
+
+	case FIR_VARIANT_SYMMETRIC:
+		kernel = clCreateKernel(dev->program, "FIR_symmetric", &ret);
+		CHECK_STATUS( ret,"Error: Create kernel. (FIR_symmetric)\n");
+		ret = clSetKernelArg(kernel, 0, sizeof(cl_mem), (void *)&outputBuffer);
+		ret |= clSetKernelArg(kernel, 1, sizeof(cl_mem), (void *)&coeffBuffer);
+		ret |= clSetKernelArg(kernel, 2, sizeof(cl_mem), (void *)&tempInputBuffer);
+		ret |= clSetKernelArg(kernel, 3, sizeof(cl_uint), (void *)&numTap);
+		ret |= clSetKernelArg(kernel, 4, sizeof(cl_uint), (void *)&numData);
+		CHECK_STATUS( ret,"Error: Set kernel arguments (FIR_symmetric)\n");
+		globalThreads[0] = (numData + local - 1) / local * local;
+		break;
+
+	default:
+		printf("Error: unknown FIR variant %d\n", variant);
+		return 1;
+	}
+
+	*time = 0;
+	for (i = 0; i < numIter; i++)
+	{
+		cl_event event;
+		ret = clEnqueueNDRangeKernel(dev->queue, kernel, 1, NULL,
+				globalThreads, localThreads, 0, NULL, &event);
+		CHECK_STATUS( ret,"Error: Range kernel. (FIR variant)\n");
+		*time += FIREventTime(event);
+		clReleaseEvent(event);
+	}
+	*time /= numIter;
+
+	ret = clEnqueueReadBuffer(dev->queue, outputBuffer, CL_TRUE, 0,
+			numData * sizeof(cl_float), output, 0, NULL, NULL);
+	CHECK_STATUS( ret,"Error: Read output Buffer\n");
+
+	clReleaseKernel(kernel);
+	clReleaseMemObject(outputBuffer);
+	clReleaseMemObject(coeffBuffer);
+	clReleaseMemObject(tempInputBuffer);
+	return 0;
+}
+
+/* Random taps, mirrored about the centre if symmetric */
+static void RandomTaps(cl_float *coeff, cl_uint numTap, int symmetric)
+{
+	cl_uint i;
+
+	for (i = 0; i < numTap; i++)
+		coeff[i] = 1.0f * rand() / RAND_MAX / numTap;
+	if (symmetric)
+		for (i = 0; i < numTap / 2; i++)
+			coeff[numTap - 1 - i] = coeff[i];
+}
+
+/*
+ * \brief Run one variant, check it against cpu_compute and compare its
+ * kernel time with the direct kernel.
+ *
+ * The taps are mirrored if symmetric.  FIR_VARIANT_AUTO lets
+ * FIRSelectVariant choose for these taps.
+ */
+int RunFIRVariant(FIRDevice *dev, FIRVariant variant, cl_uint numTap,
+		cl_uint numData, int symmetric)
+{
+	cl_uint i;
+	double time, directTime;
+
+	cl_float *input = (cl_float *) malloc(numData * sizeof(cl_float));
+	cl_float *output = (cl_float *) malloc(numData * sizeof(cl_float));
+	cl_float *coeff = (cl_float *) malloc(numTap * sizeof(cl_float));
+	for (i = 0; i < numData; i++)
+		input[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+	RandomTaps(coeff, numTap, symmetric);
+
+	if (variant == FIR_VARIANT_AUTO)
+	{
+		variant = FIRSelectVariant(dev, numTap, numData, coeff);
+		printf("Selected %s convolution\n", FIRVariantName[variant]);
+	}
+
+	printf("FIR Filter (%s kernel)\n", FIRVariantName[variant]);
+	if (FIRRunVariant(dev, variant, numTap, numData, coeff, input, output,
+				5, &time))
+		return 1;
+	fprintf(stderr, "\tKernel exec time: %8.2f us\n", time);
+
+	float *cpu_out = cpu_compute(input, coeff, numTap, numData);
+	int failed = FIRVerify(cpu_out, output, numData, 1e-4f);
+	printf(failed ? "FIR Fail\n" : "FIR Successful\n");
+
+	if (variant != FIR_VARIANT_DIRECT && numData % 64 == 0 &&
+			!FIRRunVariant(dev, FIR_VARIANT_DIRECT, numTap, numData,
+				coeff, input, output, 5, &directTime))
+		fprintf(stderr, "\tDirect kernel:    %8.2f us (%.2fx)\n",
+				directTime, directTime / time);
+
+	free(cpu_out);
+	free(input);
+	free(output);
+	free(coeff);
+	return failed;
+}
+
+/*
+ * \brief Time every variant for tap counts 8, 16, ... up to maxTap.
+ * The taps are symmetric so that every variant applies.
+ */
+int RunFIRBench(FIRDevice *dev, cl_uint maxTap, cl_uint numData)
+{
+	cl_uint numTap, i;
+	int v;
+
+	if (numData % 64)
+		numData = (numData + 63) / 64 * 64;
+
+	cl_float *input = (cl_float *) malloc(numData * sizeof(cl_float));
+	cl_float *output = (cl_float *) malloc(numData * sizeof(cl_float));
+	cl_float *coeff = (cl_float *) malloc(maxTap * sizeof(cl_float));
+	for (i = 0; i < numData; i++)
+		input[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+
+	printf("FIR kernel benchmark, %u samples, kernel time in us\n", numData);
+	printf("%8s", "numTap");
+	for (v = 0; v < FIR_NUM_VARIANT; v++)
+		printf(" %10s", FIRVariantName[v]);
+	printf("\n");
+
+	int failed = 0;
+	for (numTap = 8; numTap <= maxTap; numTap *= 2)
+	{
+		RandomTaps(coeff, numTap, 1);
+		float *cpu_out = cpu_compute(input, coeff, numTap, numData);
+
+		printf("%8u", numTap);
+		for (v = 0; v < FIR_NUM_VARIANT; v++)
+		{
+			double time;
+			if (FIRRunVariant(dev, v, numTap, numData, coeff, input,
+						output, 5, &time))
+				return 1;
+			if (FIRVerify(cpu_out, output, numData, 1e-4f))
+			{
+				printf(" %10s", "FAIL");
+				failed = 1;
+			}
+			else
+				printf(" %10.2f", time);
+		}
+		printf("\n");
+		free(cpu_out);
+	}
+
+	free(input);
+	free(output);
+	free(coeff);
+	return failed;
+}
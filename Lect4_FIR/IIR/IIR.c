@@ -0,0 +1,428 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <string.h>
+#include <CL/cl.h>
+#include <math.h>
+#define CHECK_STATUS( status, message )   \
+		if(status != CL_SUCCESS) \
+		{ \
+			printf( message); \
+			printf( "\n" ); \
+			return 1; \
+		}
+
+
+/** Define custom constants*/
+#define MAX_SOURCE_SIZE (0x100000)
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/*
+ * Samples a work item filters serially, the largest scan work group, and
+ * the most scan levels (each one divides the chunk count by the group size)
+ */
+#define CHUNK_LEN 16
+#define MAX_SCAN_GROUP 256
+#define MAX_SCAN_LEVEL 16
+
+cl_uint numStage = 0;
+cl_uint numData = 0;
+cl_uint numChannel = 1;
+cl_uint numBlocks = 1;
+cl_float* input = NULL;
+cl_float* output = NULL;
+cl_float* coeff = NULL;
+
+
+void design_lowpass(float *coeff, unsigned int numStage);
+double* cpu_compute(float *input, float *coeff, unsigned int numStage,
+		unsigned int numChannel, unsigned int numTotal);
+
+double event_time(cl_event event)
+{
+	cl_ulong t_start = 0;
+	cl_ulong t_end = 0;
+
+	clWaitForEvents(1, &event);
+	clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START,
+			sizeof(cl_ulong), &t_start, NULL);
+	clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END,
+			sizeof(cl_ulong), &t_end, NULL);
+	clReleaseEvent(event);
+
+	return (t_end - t_start) / 1e3;
+}
+
+int main(int argc , char** argv) {
+
+	/** Define Custom Variables */
+	cl_uint i, ch, b, s;
+
+	if (argc < 3)
+	{
+		printf(" Usage : ./IIR <numStages> <numData> [numChannels] [numBlocks]\n");
+		printf("   numData samples per channel per block, numStages biquads in cascade\n");
+		exit(0);
+	}
+	numStage = atoi(argv[1]);
+	numData = atoi(argv[2]);
+	if (argc > 3)
+		numChannel = atoi(argv[3]);
+	if (argc > 4)
+		numBlocks = atoi(argv[4]);
+
+	/* The chunk count grows with numData; the scan recurses over groups */
+	cl_uint chunkLen = CHUNK_LEN;
+	cl_uint numChunk = (numData + chunkLen - 1) / chunkLen;
+
+	/** Channel-major streams: input[ch * numTotal + t] */
+	size_t numTotal = (size_t)numData * numBlocks;
+	input = (cl_float *) malloc(numTotal * numChannel * sizeof(cl_float));
+	output = (cl_float *) malloc(numTotal * numChannel * sizeof(cl_float));
+	coeff = (cl_float *) malloc(5 * numStage * sizeof(cl_float));
+	cl_float *block = (cl_float *) malloc(numData * numChannel * sizeof(cl_float));
+	cl_float *state = (cl_float *) calloc(4 * numStage * numChannel, sizeof(cl_float));
+
+	for (i = 0; i < numTotal * numChannel; i++)
+		input[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+	design_lowpass(coeff, numStage);
+
+	// Load the kernel source code into the array source_str
+	FILE *fp;
+	char *source_str;
+	size_t source_size;
+
+	fp = fopen("IIR.cl", "r");
+	if (!fp) {
+		fprintf(stderr, "Failed to load kernel.\n");
+		exit(1);
+	}
+	source_str = (char*)malloc(MAX_SOURCE_SIZE);
+	source_size = fread( source_str, 1, MAX_SOURCE_SIZE, fp);
+	fclose( fp );
+
+	// Get platform and device information
+	cl_platform_id platform_id = NULL;
+	cl_device_id device_id = NULL;
+	cl_uint ret_num_devices;
+	cl_uint ret_num_platforms;
+	cl_int ret = clGetPlatformIDs(1, &platform_id, &ret_num_platforms);
+	CHECK_STATUS( ret,"Error: Get Platform IDs\n");
+	ret = clGetDeviceIDs( platform_id, CL_DEVICE_TYPE_ALL, 1,
+			&device_id, &ret_num_devices);
+	CHECK_STATUS( ret,"Error: Get Device IDs\n");
+
+	size_t maxGroup = 0;
+	clGetDeviceInfo(device_id, CL_DEVICE_MAX_WORK_GROUP_SIZE,
+			sizeof(size_t), &maxGroup, NULL);
+	size_t scanSize = 1;
+	while (scanSize * 2 <= maxGroup && scanSize * 2 <= MAX_SCAN_GROUP)
+		scanSize *= 2;
+	if (scanSize < 2)
+	{
+		printf("Error: work groups of %zu cannot scan\n", maxGroup);
+		return 1;
+	}
+
+	/*
+	 * Scan level l scans count[l] elements step[l] samples apart, in groups
+	 * of scanSize, into one total per group; the totals are the elements of
+	 * level l+1.  Level 0 is the block start state and the chunk end states.
+	 */
+	cl_uint numLevel = 0;
+	cl_uint count[MAX_SCAN_LEVEL], numGroup[MAX_SCAN_LEVEL], step[MAX_SCAN_LEVEL];
+	count[0] = numChunk + 1;
+	step[0] = chunkLen;
+	do
+	{
+		if (numLevel == MAX_SCAN_LEVEL)
+		{
+			printf("Error: %u chunks need more than %d scan levels\n", numChunk, MAX_SCAN_LEVEL);
+			return 1;
+		}
+		numGroup[numLevel] = (count[numLevel] + scanSize - 1) / scanSize;
+		if (numGroup[numLevel] > 1)
+		{
+			count[numLevel + 1] = numGroup[numLevel];
+			step[numLevel + 1] = step[numLevel] * scanSize;
+		}
+	} while (numGroup[numLevel++] > 1);
+
+	printf("IIR Filter\n Biquads : %u \n Data Samples : %u x %u channels \n Blocks : %u \n Chunks : %u x %u samples, %u scan level%s of %zu\n",
+			numStage, numData, numChannel, numBlocks, numChunk, chunkLen,
+			numLevel, numLevel > 1 ? "s" : "", scanSize);
+
+	// Create an OpenCL context
+	cl_context context = clCreateContext( NULL, 1, &device_id, NULL, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create Context\n");
+
+	// Create a command queue
+	cl_command_queue command_queue = clCreateCommandQueue(context, device_id,
+			CL_QUEUE_PROFILING_ENABLE, &ret);
+	CHECK_STATUS( ret,"Error: Create Command Queue\n");
+
+	// Create memory buffers on the device
+	size_t blockBytes = sizeof(cl_float) * numData * numChannel;
+	cl_mem inputBuffer = clCreateBuffer(context, CL_MEM_READ_ONLY, blockBytes, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create input Buffer\n");
+	cl_mem stageBuffer[2];
+	for (i = 0; i < 2; i++)
+	{
+		stageBuffer[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, blockBytes, NULL, &ret);
+		CHECK_STATUS( ret,"Error: Create stage Buffer\n");
+	}
+	cl_mem chunkBuffer = clCreateBuffer(context, CL_MEM_READ_WRITE,
+			sizeof(cl_float2) * (numChunk + 1) * numChannel, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create chunk state Buffer\n");
+	cl_mem sumBuffer[MAX_SCAN_LEVEL];
+	for (i = 0; i < numLevel; i++)
+	{
+		sumBuffer[i] = clCreateBuffer(context, CL_MEM_READ_WRITE,
+				sizeof(cl_float2) * numGroup[i] * numChannel, NULL, &ret);
+		CHECK_STATUS( ret,"Error: Create scan sum Buffer\n");
+	}
+	cl_mem coeffBuffer = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			sizeof(cl_float) * 5 * numStage, coeff, &ret);
+	CHECK_STATUS( ret,"Error: Create coeff Buffer\n");
+	cl_mem stateBuffer = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR,
+			sizeof(cl_float4) * numStage * numChannel, state, &ret);
+	CHECK_STATUS( ret,"Error: Create state Buffer\n");
+
+	// Create a program from the kernel source
+	cl_program program = clCreateProgramWithSource(context, 1,
+			(const char **)&source_str, (const size_t *)&source_size, &ret);
+	CHECK_STATUS( ret,"Error: Create Program\n");
+
+	// Build the program
+	ret = clBuildProgram(program, 1, &device_id, NULL, NULL, NULL);
+	if (ret != CL_SUCCESS)
+	{
+		size_t len;
+		char *log;
+		clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, 0, NULL, &len);
+		log = (char *) malloc(len);
+		clGetProgramBuildInfo(program, device_id, CL_PROGRAM_BUILD_LOG, len, log, NULL);
+		printf("%s\n", log);
+		free(log);
+	}
+	CHECK_STATUS( ret,"Error: Build Program\n");
+
+	// Create the OpenCL kernels
+	cl_kernel chunkKernel = clCreateKernel(program, "IIR_chunk", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (IIR_chunk)\n");
+	cl_kernel scanKernel = clCreateKernel(program, "IIR_scan", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (IIR_scan)\n");
+	cl_kernel addKernel = clCreateKernel(program, "IIR_scan_add", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (IIR_scan_add)\n");
+	cl_kernel correctKernel = clCreateKernel(program, "IIR_correct", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (IIR_correct)\n");
+
+	ret = clSetKernelArg(chunkKernel, 3, sizeof(cl_mem), (void *)&coeffBuffer);
+	ret |= clSetKernelArg(chunkKernel, 4, sizeof(cl_mem), (void *)&stateBuffer);
+	ret |= clSetKernelArg(chunkKernel, 6, sizeof(cl_uint), (void *)&numStage);
+	ret |= clSetKernelArg(chunkKernel, 7, sizeof(cl_uint), (void *)&numData);
+	ret |= clSetKernelArg(chunkKernel, 8, sizeof(cl_uint), (void *)&chunkLen);
+	ret |= clSetKernelArg(scanKernel, 2, sizeof(cl_mem), (void *)&coeffBuffer);
+	ret |= clSetKernelArg(scanKernel, 3, sizeof(cl_float2) * scanSize, NULL);
+	ret |= clSetKernelArg(addKernel, 2, sizeof(cl_mem), (void *)&coeffBuffer);
+	ret |= clSetKernelArg(chunkKernel, 2, sizeof(cl_mem), (void *)&chunkBuffer);
+	ret |= clSetKernelArg(correctKernel, 2, sizeof(cl_mem), (void *)&chunkBuffer);
+	ret |= clSetKernelArg(correctKernel, 3, sizeof(cl_mem), (void *)&coeffBuffer);
+	ret |= clSetKernelArg(correctKernel, 4, sizeof(cl_mem), (void *)&stateBuffer);
+	ret |= clSetKernelArg(correctKernel, 6, sizeof(cl_uint), (void *)&numStage);
+	ret |= clSetKernelArg(correctKernel, 7, sizeof(cl_uint), (void *)&numData);
+	ret |= clSetKernelArg(correctKernel, 8, sizeof(cl_uint), (void *)&chunkLen);
+	CHECK_STATUS( ret,"Error: Set kernel arguments\n");
+
+	size_t chunkGroup = scanSize < 64 ? scanSize : 64;
+	size_t chunkLocal[2] = {chunkGroup, 1};
+	size_t chunkGlobal[2] = {(numChunk + chunkGroup - 1) / chunkGroup * chunkGroup, numChannel};
+	size_t scanLocal[2] = {scanSize, 1};
+
+	double kernelTime = 0;
+	cl_event event;
+	cl_mem result = stageBuffer[0];
+	for (b = 0; b < numBlocks; b++)
+	{
+		for (ch = 0; ch < numChannel; ch++)
+			memcpy(block + ch * numData, input + ch * numTotal + (size_t)b * numData,
+					numData * sizeof(cl_float));
+		ret = clEnqueueWriteBuffer(command_queue, inputBuffer, CL_FALSE, 0,
+				blockBytes, block, 0, NULL, NULL);
+		CHECK_STATUS( ret,"Error: Write input Buffer\n");
+
+		// Stage s reads the output of stage s-1, ping-ponging between buffers
+		cl_mem src = inputBuffer;
+		for (s = 0; s < numStage; s++)
+		{
+			cl_mem dst = stageBuffer[s & 1];
+
+			ret = clSetKernelArg(chunkKernel, 0, sizeof(cl_mem), (void *)&src);
+			ret |= clSetKernelArg(chunkKernel, 1, sizeof(cl_mem), (void *)&dst);
+			ret |= clSetKernelArg(chunkKernel, 5, sizeof(cl_uint), (void *)&s);
+			ret |= clSetKernelArg(scanKernel, 4, sizeof(cl_uint), (void *)&s);
+			ret |= clSetKernelArg(addKernel, 3, sizeof(cl_uint), (void *)&s);
+			ret |= clSetKernelArg(correctKernel, 0, sizeof(cl_mem), (void *)&dst);
+			ret |= clSetKernelArg(correctKernel, 1, sizeof(cl_mem), (void *)&src);
+			ret |= clSetKernelArg(correctKernel, 5, sizeof(cl_uint), (void *)&s);
+			CHECK_STATUS( ret,"Error: Set stage arguments\n");
+
+			ret = clEnqueueNDRangeKernel(command_queue, chunkKernel, 2, NULL,
+					chunkGlobal, chunkLocal, 0, NULL, &event);
+			CHECK_STATUS( ret,"Error: Range kernel. (IIR_chunk)\n");
+			kernelTime += event_time(event);
+
+			// Scan up the levels, then carry the group totals back down
+			cl_uint l;
+			for (l = 0; l < numLevel; l++)
+			{
+				cl_mem data = l ? sumBuffer[l - 1] : chunkBuffer;
+				size_t scanGlobal[2] = {numGroup[l] * scanSize, numChannel};
+				ret = clSetKernelArg(scanKernel, 0, sizeof(cl_mem), (void *)&data);
+				ret |= clSetKernelArg(scanKernel, 1, sizeof(cl_mem), (void *)&sumBuffer[l]);
+				ret |= clSetKernelArg(scanKernel, 5, sizeof(cl_uint), (void *)&count[l]);
+				ret |= clSetKernelArg(scanKernel, 6, sizeof(cl_uint), (void *)&step[l]);
+				CHECK_STATUS( ret,"Error: Set scan arguments\n");
+				ret = clEnqueueNDRangeKernel(command_queue, scanKernel, 2, NULL,
+						scanGlobal, scanLocal, 0, NULL, &event);
+				CHECK_STATUS( ret,"Error: Range kernel. (IIR_scan)\n");
+				kernelTime += event_time(event);
+			}
+			for (l = numLevel - 1; l-- > 0; )
+			{
+				cl_mem data = l ? sumBuffer[l - 1] : chunkBuffer;
+				size_t scanGlobal[2] = {numGroup[l] * scanSize, numChannel};
+				ret = clSetKernelArg(addKernel, 0, sizeof(cl_mem), (void *)&data);
+				ret |= clSetKernelArg(addKernel, 1, sizeof(cl_mem), (void *)&sumBuffer[l]);
+				ret |= clSetKernelArg(addKernel, 4, sizeof(cl_uint), (void *)&count[l]);
+				ret |= clSetKernelArg(addKernel, 5, sizeof(cl_uint), (void *)&step[l]);
+				CHECK_STATUS( ret,"Error: Set scan arguments\n");
+				ret = clEnqueueNDRangeKernel(command_queue, addKernel, 2, NULL,
+						scanGlobal, scanLocal, 0, NULL, &event);
+				CHECK_STATUS( ret,"Error: Range kernel. (IIR_scan_add)\n");
+				kernelTime += event_time(event);
+			}
+
+			ret = clEnqueueNDRangeKernel(command_queue, correctKernel, 2, NULL,
+					chunkGlobal, chunkLocal, 0, NULL, &event);
+			CHECK_STATUS( ret,"Error: Range kernel. (IIR_correct)\n");
+			kernelTime += event_time(event);
+
+			src = dst;
+		}
+		result = src;
+
+		ret = clEnqueueReadBuffer(command_queue, result, CL_TRUE, 0,
+				blockBytes, block, 0, NULL, NULL);
+		CHECK_STATUS( ret,"Error: Read output Buffer\n");
+		for (ch = 0; ch < numChannel; ch++)
+			memcpy(output + ch * numTotal + (size_t)b * numData, block + ch * numData,
+					numData * sizeof(cl_float));
+	}
+
+	fprintf(stderr, "\tKernel exec time: %8.2f us per block\n", kernelTime / numBlocks);
+	fprintf(stderr, "\tThroughput: %8.2f Msamples/s\n",
+			1.0 * numTotal * numChannel / kernelTime);
+
+	// Compare with the serial cascade, relative to the largest output
+	double *cpu_out = cpu_compute(input, coeff, numStage, numChannel, numTotal);
+	double scale = 0, err = 0;
+	for (i = 0; i < numTotal * numChannel; i++)
+	{
+		if (fabs(cpu_out[i]) > scale)
+			scale = fabs(cpu_out[i]);
+		if (fabs(cpu_out[i] - output[i]) > err)
+			err = fabs(cpu_out[i] - output[i]);
+	}
+	fprintf(stderr, "\tMax error: %g (relative %g)\n", err, scale ? err / scale : err);
+	if (!(err <= 1e-3 * (scale ? scale : 1)))
+		printf("IIR Fail\n");
+	else
+		printf("IIR Successful\n");
+
+	ret = clFlush(command_queue);
+	ret = clFinish(command_queue);
+	ret = clReleaseKernel(chunkKernel);
+	ret = clReleaseKernel(scanKernel);
+	ret = clReleaseKernel(addKernel);
+	ret = clReleaseKernel(correctKernel);
+	ret = clReleaseProgram(program);
+	ret = clReleaseMemObject(inputBuffer);
+	ret = clReleaseMemObject(stageBuffer[0]);
+	ret = clReleaseMemObject(stageBuffer[1]);
+	ret = clReleaseMemObject(chunkBuffer);
+	for (i = 0; i < numLevel; i++)
+		ret = clReleaseMemObject(sumBuffer[i]);
+	ret = clReleaseMemObject(coeffBuffer);
+	ret = clReleaseMemObject(stateBuffer);
+	ret = clReleaseCommandQueue(command_queue);
+	ret = clReleaseContext(context);
+
+	free(source_str);
+	free(cpu_out);
+	free(input);
+	free(output);
+	free(coeff);
+	free(block);
+	free(state);
+	return 0;
+}
+
+/*
+ * \brief Butterworth-style lowpass sections (RBJ cookbook), cutoffs spread
+ * between 0.05 and 0.2 of the sample rate.  a0 is normalized to 1.
+ */
+void design_lowpass(float *coeff, unsigned int numStage)
+{
+	unsigned int s;
+
+	for (s = 0; s < numStage; s++)
+	{
+		double fc = 0.05 + 0.15 * s / (numStage > 1 ? numStage - 1 : 1);
+		double w = 2 * M_PI * fc;
+		double alpha = sin(w) / (2 * 0.7071);
+		double a0 = 1 + alpha;
+
+		coeff[5 * s + 0] = (1 - cos(w)) / 2 / a0;
+		coeff[5 * s + 1] = (1 - cos(w)) / a0;
+		coeff[5 * s + 2] = (1 - cos(w)) / 2 / a0;
+		coeff[5 * s + 3] = -2 * cos(w) / a0;
+		coeff[5 * s + 4] = (1 - alpha) / a0;
+	}
+}
+
+/*
+ * \brief Serial cascade in double precision, one sample at a time.
+ */
+double* cpu_compute(float *input, float *coeff, unsigned int numStage,
+		unsigned int numChannel, unsigned int numTotal)
+{
+	double *out_cpu = (double *) malloc((size_t)numTotal * numChannel * sizeof(double));
+
+	for (unsigned int ch = 0; ch < numChannel; ch++)
+	{
+		double *y = out_cpu + (size_t)ch * numTotal;
+		for (unsigned int n = 0; n < numTotal; n++)
+			y[n] = input[(size_t)ch * numTotal + n];
+
+		for (unsigned int s = 0; s < numStage; s++)
+		{
+			float *k = coeff + 5 * s;
+			double x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+			for (unsigned int n = 0; n < numTotal; n++)
+			{
+				double xn = y[n];
+				double yn = k[0] * xn + k[1] * x1 + k[2] * x2 - k[3] * y1 - k[4] * y2;
+				x2 = x1;
+				x1 = xn;
+				y2 = y1;
+				y1 = yn;
+				y[n] = yn;
+			}
+		}
+	}
+
+	return out_cpu;
+}
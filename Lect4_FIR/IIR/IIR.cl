@@ -0,0 +1,212 @@
+/*
+ * Cascaded biquad IIR filter, parallel along time and across channels
+ *
+ * Stage s computes
+ *     y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+ * coeff holds (b0, b1, b2, a1, a2) for every stage.  The recursive state
+ * (y[n-1], y[n-2]) advances as z[n] = A z[n-1] + (v[n], 0) with
+ * A = [ -a1 -a2 ; 1 0 ], so each stage is run as
+ *   IIR_chunk    every chunk of chunkLen samples is filtered from zero
+ *                state, giving its zero-state output and end state
+ *   IIR_scan     a parallel prefix over the chunks propagates the true
+ *   IIR_scan_add end state of every chunk: end(c) = A^chunkLen end(c-1) + zs(c),
+ *                one IIR_scan per level and IIR_scan_add on the way back
+ *                when the chunks do not fit in one work group
+ *   IIR_correct  every chunk adds the response to its start state
+ * dim 1 is the channel; data is channel-major, numData samples per channel.
+ * chunkState holds numChunk + 1 entries per channel: the start state of the
+ * block, then the end state of every chunk, so entry c is the start state
+ * of chunk c.  state holds (x[-1], x[-2], y[-1], y[-2]) of every channel
+ * and stage and carries them from block to block.
+ */
+
+/* 2x2 matrices as float4 (m00, m01, m10, m11) */
+float4 mat_mul( float4 m, float4 n )
+{
+    return (float4)( m.x * n.x + m.y * n.z, m.x * n.y + m.y * n.w,
+                     m.z * n.x + m.w * n.z, m.z * n.y + m.w * n.w );
+}
+
+float2 mat_vec( float4 m, float2 v )
+{
+    return (float2)( m.x * v.x + m.y * v.y, m.z * v.x + m.w * v.y );
+}
+
+/* A^n by repeated squaring */
+float4 mat_pow( float4 a, uint n )
+{
+    float4 r = (float4)( 1.0f, 0.0f, 0.0f, 1.0f );
+
+    while( n )
+    {
+        if( n & 1 )
+            r = mat_mul( r, a );
+        a = mat_mul( a, a );
+        n >>= 1;
+    }
+    return r;
+}
+
+__kernel void IIR_chunk( __global const float * input,
+                         __global float * output,
+                         __global float2 * chunkState,  /* numChannel x (numChunk + 1) */
+                         __global const float * coeff,
+                         __global const float4 * state,
+                         uint stage,
+                         uint numStage,
+                         uint numData,
+                         uint chunkLen ){
+
+    uint c = get_global_id(0);
+    uint ch = get_global_id(1);
+    uint numChunk = ( numData + chunkLen - 1 ) / chunkLen;
+
+    if( c >= numChunk )
+        return;
+
+    __global const float * x = input + ch * numData;
+    __global float * y = output + ch * numData;
+    __global const float * k = coeff + stage * 5;
+    float b0 = k[0], b1 = k[1], b2 = k[2], a1 = k[3], a2 = k[4];
+
+    uint n0 = c * chunkLen;
+    uint n1 = min( n0 + chunkLen, numData );
+
+    /* Input history comes from the previous chunk or the previous block */
+    float4 st = state[ch * numStage + stage];
+    float x1 = n0 >= 1 ? x[n0 - 1] : st.x;
+    float x2 = n0 >= 2 ? x[n0 - 2] : ( n0 == 1 ? st.x : st.y );
+    float y1 = 0.0f, y2 = 0.0f;
+    uint n;
+
+    for( n=n0; n<n1; n++ )
+    {
+        float xn = x[n];
+        float yn = b0 * xn + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+        y[n] = yn;
+        x2 = x1;
+        x1 = xn;
+        y2 = y1;
+        y1 = yn;
+    }
+    chunkState[ch * ( numChunk + 1 ) + c + 1] = (float2)( y1, y2 );
+    if( c == 0 )
+        chunkState[ch * ( numChunk + 1 )] = st.zw;
+}
+
+/*
+ * Inclusive scan of the count elements of every channel in data, step
+ * samples apart, one group of elements per work group: on return each
+ * element holds its end state as if the group started from zero state, and
+ * sums one total per group and channel for the next level.  Local size is
+ * a power of two.
+ */
+__kernel void IIR_scan( __global float2 * data,
+                        __global float2 * sums,
+                        __global const float * coeff,
+                        __local float2 * scan,
+                        uint stage,
+                        uint count,
+                        uint step ){
+
+    uint i = get_global_id(0);
+    uint c = get_local_id(0);
+    uint ch = get_global_id(1);
+    uint size = get_local_size(0);
+
+    __global const float * k = coeff + stage * 5;
+    float4 A = (float4)( -k[3], -k[4], 1.0f, 0.0f );
+    float4 M = mat_pow( A, step );
+
+    scan[c] = i < count ? data[ch * count + i] : (float2)( 0.0f, 0.0f );
+    barrier( CLK_LOCAL_MEM_FENCE );
+
+    /* Hillis-Steele: after the round of distance d, scan[c] covers 2d elements */
+    uint d;
+    for( d=1; d<size; d*=2 )
+    {
+        float2 add = c >= d ? mat_vec( M, scan[c - d] ) : (float2)( 0.0f, 0.0f );
+        barrier( CLK_LOCAL_MEM_FENCE );
+        scan[c] += add;
+        barrier( CLK_LOCAL_MEM_FENCE );
+        M = mat_mul( M, M );
+    }
+
+    if( i < count )
+        data[ch * count + i] = scan[c];
+    if( c == size - 1 )
+        sums[ch * get_num_groups(0) + get_group_id(0)] = scan[c];
+}
+
+/*
+ * sums holds the scanned totals of the groups of IIR_scan: carry the end
+ * state of the groups before into every element of the group.
+ */
+__kernel void IIR_scan_add( __global float2 * data,
+                            __global const float2 * sums,
+                            __global const float * coeff,
+                            uint stage,
+                            uint count,
+                            uint step ){
+
+    uint i = get_global_id(0);
+    uint ch = get_global_id(1);
+    uint g = get_group_id(0);
+
+    if( g == 0 || i >= count )
+        return;
+
+    __global const float * k = coeff + stage * 5;
+    float4 A = (float4)( -k[3], -k[4], 1.0f, 0.0f );
+    float4 M = mat_pow( A, step * ( get_local_id(0) + 1 ) );
+
+    data[ch * count + i] += mat_vec( M, sums[ch * get_num_groups(0) + g - 1] );
+}
+
+/*
+ * Adds the response to the start state of every chunk; the last chunk then
+ * also saves the state of the block.
+ */
+__kernel void IIR_correct( __global float * output,
+                           __global const float * input,
+                           __global const float2 * chunkState,
+                           __global const float * coeff,
+                           __global float4 * state,
+                           uint stage,
+                           uint numStage,
+                           uint numData,
+                           uint chunkLen ){
+
+    uint c = get_global_id(0);
+    uint ch = get_global_id(1);
+    uint numChunk = ( numData + chunkLen - 1 ) / chunkLen;
+
+    if( c >= numChunk )
+        return;
+
+    __global float * y = output + ch * numData;
+    __global const float * k = coeff + stage * 5;
+    float a1 = k[3], a2 = k[4];
+
+    uint n0 = c * chunkLen;
+    uint n1 = min( n0 + chunkLen, numData );
+    float2 t = chunkState[ch * ( numChunk + 1 ) + c];
+    float2 last = t;
+    uint n;
+
+    for( n=n0; n<n1; n++ )
+    {
+        t = (float2)( -a1 * t.x - a2 * t.y, t.x );
+        y[n] += t.x;
+        last = (float2)( y[n], last.x );
+    }
+
+    if( c == numChunk - 1 )
+    {
+        __global const float * x = input + ch * numData;
+        float4 st = state[ch * numStage + stage];
+        float x1 = numData >= 1 ? x[numData - 1] : st.x;
+        float x2 = numData >= 2 ? x[numData - 2] : st.x;
+        state[ch * numStage + stage] = (float4)( x1, x2, last.x, last.y );
+    }
+}
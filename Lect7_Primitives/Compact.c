@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <CL/cl.h>
+#include "Prim.h"
+
+/*
+ * \brief Build Compact.cl for elements of type and the given predicate
+ * (NULL keeps the non-zero ones), and allocate the tile counts and their
+ * scan for up to maxN elements.  The predicate goes into the build options,
+ * so it must not contain spaces.
+ */
+int PrimCompactCreate(PrimCompact *c, PrimDevice *dev, PrimType type,
+		const char *predicate, cl_uint maxN)
+{
+	cl_int ret;
+	char options[256];
+
+	memset(c, 0, sizeof(*c));
+	c->type = type;
+	c->maxN = maxN;
+	c->local = PrimLocalSize(dev, 128);
+	c->tileLen = PRIM_COMPACT_ITEMS * c->local;
+
+	if (predicate && (strchr(predicate, ' ') ||
+				strlen(predicate) > sizeof(options) - 64))
+	{
+		printf("Error: predicate \"%s\" has spaces or is too long\n", predicate);
+		return 1;
+	}
+	sprintf(options, "%s -D COMPACT_ITEMS=%d%s%s",
+			type == PRIM_INT ? "-D T_INT" : "-D T_FLOAT", PRIM_COMPACT_ITEMS,
+			predicate ? " -D PREDICATE=" : "", predicate ? predicate : "");
+	if (PrimBuildProgram(dev, "Compact.cl", options, &c->program))
+		return 1;
+
+	cl_uint numTile = (maxN + c->tileLen - 1) / c->tileLen;
+	if (numTile == 0)
+		numTile = 1;
+	if (PrimScanCreate(&c->scan, dev, PRIM_INT, numTile))
+		return 1;
+
+	c->count = clCreateBuffer(dev->context, CL_MEM_READ_WRITE,
+			sizeof(cl_uint) * numTile, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create tile count Buffer\n");
+	c->end = clCreateBuffer(dev->context, CL_MEM_READ_WRITE,
+			sizeof(cl_uint) * numTile, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create tile end Buffer\n");
+
+	c->countKernel = clCreateKernel(c->program, "Compact_count", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (Compact_count)\n");
+	c->scatterKernel = clCreateKernel(c->program, "Compact_scatter", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (Compact_scatter)\n");
+	c->flagsKernel = clCreateKernel(c->program, "Compact_flags", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (Compact_flags)\n");
+
+	size_t elem = type == PRIM_INT ? sizeof(cl_int) : sizeof(cl_float);
+	ret = clSetKernelArg(c->countKernel, 2, sizeof(cl_mem), (void *)&c->count);
+	ret |= clSetKernelArg(c->countKernel, 3, sizeof(cl_uint), NULL);
+	ret |= clSetKernelArg(c->scatterKernel, 2, sizeof(cl_mem), (void *)&c->end);
+	ret |= clSetKernelArg(c->scatterKernel, 4, elem * c->tileLen, NULL);
+	ret |= clSetKernelArg(c->scatterKernel, 5, sizeof(cl_uint) * c->local, NULL);
+	CHECK_STATUS( ret,"Error: Set kernel arguments (Compact)\n");
+
+	return 0;
+}
+
+/*
+ * \brief Queue the compaction of the first n (<= maxN) elements of in into
+ * out, which needs room for all n.  If count is not NULL it receives the
+ * number of survivors, read back after the scatter; on the device it is
+ * the last used entry of c->end.  If time is not NULL it receives the
+ * kernel time of every launch in us, which waits for each of them.
+ */
+int PrimCompactEnqueue(PrimCompact *c, PrimDevice *dev, cl_mem in, cl_uint n,
+		cl_mem out, cl_uint *count, double *time)
+{
+	cl_int ret;
+	cl_event event[2];
+	double scanTime;
+
+	if (time)
+		*time = 0;
+	if (count)
+		*count = 0;
+	if (n == 0)
+		return 0;
+	if (n > c->maxN)
+	{
+		printf("Error: compaction of %u elements, created for %u\n", n, c->maxN);
+		return 1;
+	}
+
+	cl_uint numTile = (n + c->tileLen - 1) / c->tileLen;
+	size_t globalThreads[1] = {numTile * c->local};
+	size_t localThreads[1] = {c->local};
+
+	ret = clSetKernelArg(c->countKernel, 0, sizeof(cl_mem), (void *)&in);
+	ret |= clSetKernelArg(c->countKernel, 1, sizeof(cl_uint), (void *)&n);
+	CHECK_STATUS( ret,"Error: Set count arguments\n");
+	ret = clEnqueueNDRangeKernel(dev->queue, c->countKernel, 1, NULL,
+			globalThreads, localThreads, 0, NULL, time ? &event[0] : NULL);
+	CHECK_STATUS( ret,"Error: Range kernel. (Compact_count)\n");
+
+	if (PrimScanEnqueue(&c->scan, dev, c->count, c->end, numTile, 1,
+				time ? &scanTime : NULL))
+		return 1;
+
+	ret = clSetKernelArg(c->scatterKernel, 0, sizeof(cl_mem), (void *)&in);
+	ret |= clSetKernelArg(c->scatterKernel, 1, sizeof(cl_uint), (void *)&n);
+	ret |= clSetKernelArg(c->scatterKernel, 3, sizeof(cl_mem), (void *)&out);
+	CHECK_STATUS( ret,"Error: Set scatter arguments\n");
+	ret = clEnqueueNDRangeKernel(dev->queue, c->scatterKernel, 1, NULL,
+			globalThreads, localThreads, 0, NULL, time ? &event[1] : NULL);
+	CHECK_STATUS( ret,"Error: Range kernel. (Compact_scatter)\n");
+
+	if (time)
+	{
+		*time = PrimEventTime(event[0]) + scanTime + PrimEventTime(event[1]);
+		clReleaseEvent(event[0]);
+		clReleaseEvent(event[1]);
+	}
+
+	if (count)
+	{
+		ret = clEnqueueReadBuffer(dev->queue, c->end, CL_TRUE,
+				sizeof(cl_uint) * (numTile - 1), sizeof(cl_uint), count, 0, NULL, NULL);
+		CHECK_STATUS( ret,"Error: Read compaction count\n");
+	}
+	return 0;
+}
+
+void PrimCompactRelease(PrimCompact *c)
+{
+	clReleaseKernel(c->flagsKernel);
+	clReleaseKernel(c->scatterKernel);
+	clReleaseKernel(c->countKernel);
+	clReleaseMemObject(c->end);
+	clReleaseMemObject(c->count);
+	PrimScanRelease(&c->scan);
+	clReleaseProgram(c->program);
+}
+
+
+/* Predicates from sparse to dense on the test data of each type */
+static const char *CompactPredicate[PRIM_NUM_TYPE][3] = {
+	{"x>0.999f", "x>0.9f", "x>0.5f"},
+	{"(x&1023)==0", "(x&7)==0", "(x&1)==0"},
+};
+
+static int KeepFloat999(const void *x) { return *(const cl_float *) x > 0.999f; }
+static int KeepFloat9(const void *x) { return *(const cl_float *) x > 0.9f; }
+static int KeepFloat5(const void *x) { return *(const cl_float *) x > 0.5f; }
+static int KeepInt1023(const void *x) { return (*(const cl_int *) x & 1023) == 0; }
+static int KeepInt7(const void *x) { return (*(const cl_int *) x & 7) == 0; }
+static int KeepInt1(const void *x) { return (*(const cl_int *) x & 1) == 0; }
+
+/* The same predicates on the host, so the check does not trust the device */
+static int (*const CompactHostPredicate[PRIM_NUM_TYPE][3])(const void *) = {
+	{KeepFloat999, KeepFloat9, KeepFloat5},
+	{KeepInt1023, KeepInt7, KeepInt1},
+};
+
+/*
+ * \brief Compact n random elements (floats in [0, 1), non-negative ints)
+ * with the given predicate, or a sparse, a 10% and a 50% one if it is NULL.
+ * The result is checked against a CPU filter of the input: the built-in
+ * predicates are evaluated on the host, a user-supplied one (which only
+ * the OpenCL compiler can parse) by the device's Compact_flags.  The time
+ * to get the survivors to the host is compared with reading back the
+ * whole input and, for the built-in predicates, filtering it there.
+ */
+int RunPrimCompact(PrimDevice *dev, cl_uint n, PrimType type,
+		const char *predicate)
+{
+	cl_int ret;
+	cl_uint i;
+	int p;
+	const int numIter = 5;
+	int failed = 0;
+	const char **predList = CompactPredicate[type];
+	int numPred = 3;
+
+	if (predicate)
+	{
+		predList = &predicate;
+		numPred = 1;
+	}
+
+	size_t elem = type == PRIM_INT ? sizeof(cl_int) : sizeof(cl_float);
+	size_t bytes = elem * (n ? n : 1);
+	void *in = malloc(bytes);
+	void *out = malloc(bytes);
+	void *ref = malloc(bytes);
+	cl_uchar *flags = (cl_uchar *) malloc(n ? n : 1);
+
+	for (i = 0; i < n; i++)
+	{
+		if (type == PRIM_INT)
+			((cl_int *) in)[i] = rand();
+		else
+			((cl_float *) in)[i] = (cl_float) rand() / ((cl_float) RAND_MAX + 1);
+	}
+
+	cl_mem inBuffer = clCreateBuffer(dev->context, CL_MEM_READ_ONLY, bytes, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create input Buffer\n");
+	cl_mem outBuffer = clCreateBuffer(dev->context, CL_MEM_READ_WRITE, bytes, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create output Buffer\n");
+	cl_mem flagBuffer = clCreateBuffer(dev->context, CL_MEM_WRITE_ONLY, n ? n : 1, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create flag Buffer\n");
+	ret = clEnqueueWriteBuffer(dev->queue, inBuffer, CL_TRUE, 0, elem * n, in,
+			0, NULL, NULL);
+	CHECK_STATUS( ret,"Error: Write compaction input\n");
+
+	printf("Compaction\n Elements : %u %s\n", n, PrimTypeName[type]);
+
+	// The baseline: every element comes back, then the host filters it
+	double readAll = WallTime();
+	ret = clEnqueueReadBuffer(dev->queue, inBuffer, CL_TRUE, 0, elem * n, out,
+			0, NULL, NULL);
+	CHECK_STATUS( ret,"Error: Read compaction input\n");
+	readAll = WallTime() - readAll;
+
+	for (p = 0; p < numPred; p++)
+	{
+		PrimCompact c;
+		if (PrimCompactCreate(&c, dev, type, predList[p], n))
+			return 1;
+
+		// The reference keeps the elements the predicate holds for, on the
+		// host for the built-in ones, else as the device flags them
+		size_t globalThreads[1] = {(n + c.local - 1) / c.local * c.local};
+		size_t localThreads[1] = {c.local};
+		cl_uint refCount = 0;
+		double filter = 0;
+		if (!predicate)
+		{
+			// Also the host filter of the baseline, on the data it read back
+			filter = WallTime();
+			for (i = 0; i < n; i++)
+				if (CompactHostPredicate[type][p]((char *) in + elem * i))
+					memcpy((char *) ref + elem * refCount++, (char *) in + elem * i, elem);
+			filter = WallTime() - filter;
+		}
+		else if (n)
+		{
+			ret = clSetKernelArg(c.flagsKernel, 0, sizeof(cl_mem), (void *)&inBuffer);
+			ret |= clSetKernelArg(c.flagsKernel, 1, sizeof(cl_uint), (void *)&n);
+			ret |= clSetKernelArg(c.flagsKernel, 2, sizeof(cl_mem), (void *)&flagBuffer);
+			CHECK_STATUS( ret,"Error: Set flag arguments\n");
+			ret = clEnqueueNDRangeKernel(dev->queue, c.flagsKernel, 1, NULL,
+					globalThreads, localThreads, 0, NULL, NULL);
+			CHECK_STATUS( ret,"Error: Range kernel. (Compact_flags)\n");
+			ret = clEnqueueReadBuffer(dev->queue, flagBuffer, CL_TRUE, 0, n, flags,
+					0, NULL, NULL);
+			CHECK_STATUS( ret,"Error: Read flags\n");
+			for (i = 0; i < n; i++)
+				if (flags[i])
+					memcpy((char *) ref + elem * refCount++, (char *) in + elem * i, elem);
+		}
+
+		double time, total = 0, host = 0;
+		cl_uint count = 0;
+		int iter;
+		for (iter = 0; iter <= numIter; iter++)
+		{
+			if (PrimCompactEnqueue(&c, dev, inBuffer, n, outBuffer, &count, &time))
+				return 1;
+
+			// Compaction, its count and the survivors, as the host sees it
+			double start = WallTime();
+			if (PrimCompactEnqueue(&c, dev, inBuffer, n, outBuffer, &count, NULL))
+				return 1;
+			if (count)
+			{
+				ret = clEnqueueReadBuffer(dev->queue, outBuffer, CL_TRUE, 0,
+						elem * count, out, 0, NULL, NULL);
+				CHECK_STATUS( ret,"Error: Read survivors\n");
+			}
+			// The first run is a warm-up
+			if (iter)
+			{
+				total += time;
+				host += WallTime() - start;
+			}
+		}
+
+		int bad = count != refCount || memcmp(out, ref, elem * count) != 0;
+		failed |= bad;
+		fprintf(stderr, "\t%-12s %10u kept (%6.2f%%) %10.2f us %8.2f Melem/s   "
+				"to host %10.2f us, %s %10.2f us%s\n",
+				predList[p], count, n ? 100.0 * count / n : 0.0,
+				total / numIter, total > 0 ? n / (total / numIter) : 0.0, host / numIter,
+				predicate ? "read all (no filter)" : "read all + filter", readAll + filter,
+				bad ? "  MISMATCH" : "");
+		PrimCompactRelease(&c);
+	}
+	printf(failed ? "Compaction Fail\n" : "Compaction Successful\n");
+
+	clReleaseMemObject(flagBuffer);
+	clReleaseMemObject(outBuffer);
+	clReleaseMemObject(inBuffer);
+	free(flags);
+	free(ref);
+	free(out);
+	free(in);
+	return failed;
+}
@@ -0,0 +1,112 @@
+/*
+ * Stream compaction: keep the elements x for which PREDICATE holds, in
+ * their input order.  Specialised at build time:
+ *   -D T_FLOAT | -D T_INT      element type
+ *   -D PREDICATE=expr          condition on x, e.g. -D PREDICATE=x>0.5f
+ *   -D COMPACT_ITEMS=k         elements per work-item (at most 32)
+ *
+ * Each work-item packs the predicate of its k elements into a bit mask,
+ * a ballot, and counts survivors with popcount.  Compact_count leaves one
+ * count per tile of k * local elements; after an inclusive scan of the
+ * counts, Compact_scatter writes each tile's survivors from the end of the
+ * tile before it.
+ */
+
+#ifdef T_INT
+#define T int
+#else
+#define T float
+#endif
+
+#ifndef PREDICATE
+#define PREDICATE x != 0
+#endif
+
+uint keep(T x)
+{
+    return (PREDICATE) ? 1 : 0;
+}
+
+__kernel void Compact_count(__global const T *in,
+                            const uint n,
+                            __global uint *count,
+                            __local uint *total)
+{
+    uint lid = get_local_id(0);
+    uint lsize = get_local_size(0);
+    uint base = get_group_id(0) * COMPACT_ITEMS * lsize;
+
+    if (lid == 0)
+        *total = 0;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Coalesced: element k of every work-item is one contiguous row
+    uint mask = 0;
+    for (uint k = 0; k < COMPACT_ITEMS; k++)
+    {
+        uint i = base + k * lsize + lid;
+        if (i < n && keep(in[i]))
+            mask |= 1u << k;
+    }
+    atomic_add(total, popcount(mask));
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (lid == 0)
+        count[get_group_id(0)] = *total;
+}
+
+/*
+ * end[g] is the number of survivors in tiles 0..g.  Local arrays: tile
+ * holds the tile's elements, offset one entry per work-item.
+ */
+__kernel void Compact_scatter(__global const T *in,
+                              const uint n,
+                              __global const uint *end,
+                              __global T *out,
+                              __local T *tile,
+                              __local uint *offset)
+{
+    uint lid = get_local_id(0);
+    uint lsize = get_local_size(0);
+    uint len = COMPACT_ITEMS * lsize;
+    uint base = get_group_id(0) * len;
+
+    for (uint i = lid; i < len; i += lsize)
+        if (base + i < n)
+            tile[i] = in[base + i];
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // This work-item's consecutive elements, in input order
+    uint first = lid * COMPACT_ITEMS;
+    uint mask = 0;
+    for (uint k = 0; k < COMPACT_ITEMS; k++)
+        if (base + first + k < n && keep(tile[first + k]))
+            mask |= 1u << k;
+    uint cnt = popcount(mask);
+
+    // Inclusive scan of the counts over the work-group
+    offset[lid] = cnt;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for (uint s = 1; s < lsize; s <<= 1)
+    {
+        uint t = lid >= s ? offset[lid - s] : 0;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        offset[lid] += t;
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    uint dst = (get_group_id(0) ? end[get_group_id(0) - 1] : 0) + offset[lid] - cnt;
+    for (uint k = 0; k < COMPACT_ITEMS; k++)
+        if (mask & (1u << k))
+            out[dst++] = tile[first + k];
+}
+
+/* The predicate of every element, for checking a compaction on the host */
+__kernel void Compact_flags(__global const T *in,
+                            const uint n,
+                            __global uchar *flags)
+{
+    uint i = get_global_id(0);
+    if (i < n)
+        flags[i] = keep(in[i]);
+}
@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <CL/cl.h>
+#include "Prim.h"
+
+/* Work-groups per compute unit of the counting kernel, for each slice */
+#define HIST_GROUPS_PER_CU 4
+
+/* Sub-histogram copies the automatic choice slices the bins for */
+#define HIST_MIN_COPIES 2
+
+/* Every slice reads all the data; past this many use global atomics */
+#define HIST_MAX_SLICES 64
+
+/*
+ * \brief Build Histogram.cl for numBins bins.  The bins are sliced so that
+ * numCopies local sub-histograms of a slice fit in local memory; with
+ * numCopies = 0 the slices are sized for HIST_MIN_COPIES copies and then
+ * get as many as fit (up to PRIM_HIST_MAX_COPIES and one per work-item).
+ * If the slices would be more than HIST_MAX_SLICES the histogram uses
+ * global atomics.
+ */
+int PrimHistogramCreate(PrimHistogram *h, PrimDevice *dev, cl_uint numBins,
+		cl_uint numCopies)
+{
+	cl_int ret;
+
+	memset(h, 0, sizeof(*h));
+	h->numBins = numBins;
+	h->local = PrimLocalSize(dev, 256);
+	h->numGroup = dev->numCU * HIST_GROUPS_PER_CU;
+
+	cl_ulong words = dev->localMem / sizeof(cl_uint);
+	cl_uint want = numCopies ? numCopies : HIST_MIN_COPIES;
+	if (want > h->local)
+		want = h->local;
+	cl_ulong maxSlice = words / want > 1 ? words / want - 1 : 0;
+	cl_ulong numSlice = maxSlice ? (numBins + maxSlice - 1) / maxSlice : 0;
+	if (numSlice && numSlice <= HIST_MAX_SLICES)
+	{
+		h->numSlice = numSlice;
+		h->sliceBins = (numBins + numSlice - 1) / numSlice;
+		h->copyStride = h->sliceBins + 1;
+
+		cl_ulong fit = words / h->copyStride;
+		if (numCopies == 0)
+			numCopies = PRIM_HIST_MAX_COPIES;
+		if (numCopies > h->local)
+			numCopies = h->local;
+		h->numCopies = numCopies < fit ? numCopies : fit;
+	}
+
+	if (PrimBuildProgram(dev, "Histogram.cl", "", &h->program))
+		return 1;
+
+	if (h->numCopies)
+	{
+		h->partial = clCreateBuffer(dev->context, CL_MEM_READ_WRITE,
+				sizeof(cl_uint) * h->numGroup * numBins, NULL, &ret);
+		CHECK_STATUS( ret,"Error: Create partial histogram Buffer\n");
+
+		h->count = clCreateKernel(h->program, "Histogram_local", &ret);
+		CHECK_STATUS( ret,"Error: Create kernel. (Histogram_local)\n");
+		h->merge = clCreateKernel(h->program, "Histogram_merge", &ret);
+		CHECK_STATUS( ret,"Error: Create kernel. (Histogram_merge)\n");
+
+		cl_uint numPartial = h->numGroup;
+		ret = clSetKernelArg(h->count, 2, sizeof(cl_uint), (void *)&numBins);
+		ret |= clSetKernelArg(h->count, 3, sizeof(cl_uint), (void *)&h->sliceBins);
+		ret |= clSetKernelArg(h->count, 4, sizeof(cl_uint), (void *)&h->numCopies);
+		ret |= clSetKernelArg(h->count, 5, sizeof(cl_uint), (void *)&h->copyStride);
+		ret |= clSetKernelArg(h->count, 6, sizeof(cl_mem), (void *)&h->partial);
+		ret |= clSetKernelArg(h->count, 7,
+				sizeof(cl_uint) * h->numCopies * h->copyStride, NULL);
+		ret |= clSetKernelArg(h->merge, 0, sizeof(cl_mem), (void *)&h->partial);
+		ret |= clSetKernelArg(h->merge, 1, sizeof(cl_uint), (void *)&numPartial);
+		ret |= clSetKernelArg(h->merge, 2, sizeof(cl_uint), (void *)&numBins);
+		CHECK_STATUS( ret,"Error: Set kernel arguments (Histogram_local)\n");
+	}
+	else
+	{
+		h->count = clCreateKernel(h->program, "Histogram_global", &ret);
+		CHECK_STATUS( ret,"Error: Create kernel. (Histogram_global)\n");
+		ret = clSetKernelArg(h->count, 2, sizeof(cl_uint), (void *)&numBins);
+		CHECK_STATUS( ret,"Error: Set kernel arguments (Histogram_global)\n");
+	}
+
+	return 0;
+}
+
+/*
+ * \brief Queue the histogram of the n bin indices of data into hist
+ * (numBins counters, overwritten).  If time is not NULL it receives the
+ * time of every command in us, which waits for them.
+ */
+int PrimHistogramEnqueue(PrimHistogram *h, PrimDevice *dev, cl_mem data,
+		cl_uint n, cl_mem hist, double *time)
+{
+	cl_int ret;
+	cl_event event[2];
+
+	ret = clSetKernelArg(h->count, 0, sizeof(cl_mem), (void *)&data);
+	ret |= clSetKernelArg(h->count, 1, sizeof(cl_uint), (void *)&n);
+	CHECK_STATUS( ret,"Error: Set histogram arguments\n");
+
+	size_t globalThreads[2] = {h->numGroup * h->local, h->numSlice};
+	size_t localThreads[2] = {h->local, 1};
+	if (h->numCopies)
+	{
+		// Dimension 1 picks the bin slice a group counts
+		ret = clEnqueueNDRangeKernel(dev->queue, h->count, 2, NULL,
+				globalThreads, localThreads, 0, NULL, time ? &event[0] : NULL);
+		CHECK_STATUS( ret,"Error: Range kernel. (Histogram_local)\n");
+
+		ret = clSetKernelArg(h->merge, 3, sizeof(cl_mem), (void *)&hist);
+		CHECK_STATUS( ret,"Error: Set merge arguments\n");
+		size_t mergeThreads[1] = {(h->numBins + h->local - 1) / h->local * h->local};
+		ret = clEnqueueNDRangeKernel(dev->queue, h->merge, 1, NULL,
+				mergeThreads, localThreads, 0, NULL, time ? &event[1] : NULL);
+		CHECK_STATUS( ret,"Error: Range kernel. (Histogram_merge)\n");
+	}
+	else
+	{
+		const cl_uint zero = 0;
+		ret = clEnqueueFillBuffer(dev->queue, hist, &zero, sizeof(zero), 0,
+				sizeof(cl_uint) * h->numBins, 0, NULL, time ? &event[0] : NULL);
+		CHECK_STATUS( ret,"Error: Clear histogram\n");
+
+		ret = clSetKernelArg(h->count, 3, sizeof(cl_mem), (void *)&hist);
+		CHECK_STATUS( ret,"Error: Set histogram arguments\n");
+		ret = clEnqueueNDRangeKernel(dev->queue, h->count, 1, NULL,
+				globalThreads, localThreads, 0, NULL, time ? &event[1] : NULL);
+		CHECK_STATUS( ret,"Error: Range kernel. (Histogram_global)\n");
+	}
+
+	if (time)
+	{
+		*time = PrimEventTime(event[0]) + PrimEventTime(event[1]);
+		clReleaseEvent(event[0]);
+		clReleaseEvent(event[1]);
+	}
+	return 0;
+}
+
+void PrimHistogramRelease(PrimHistogram *h)
+{
+	if (h->numCopies)
+	{
+		clReleaseKernel(h->merge);
+		clReleaseMemObject(h->partial);
+	}
+	clReleaseKernel(h->count);
+	clReleaseProgram(h->program);
+}
+
+/*
+ * \brief Histogram n indices into numBins bins (256, 4096 and 65536 if
+ * numBins is 0), spread uniformly and with 90% in one bin, with the
+ * automatic number of sub-histogram copies and, for comparison, with one.
+ * Every result must equal the CPU count exactly.
+ */
+int RunPrimHistogram(PrimDevice *dev, cl_uint n, cl_uint numBins)
+{
+	cl_int ret;
+	cl_uint i;
+	int b, skew, c;
+	const int numIter = 5;
+	int failed = 0;
+	cl_uint binList[3] = {256, 4096, 65536};
+	int numBinList = 3;
+
+	if (numBins)
+	{
+		binList[0] = numBins;
+		numBinList = 1;
+	}
+
+	size_t bytes = sizeof(cl_uint) * (n ? n : 1);
+	cl_uint *data = (cl_uint *) malloc(bytes);
+	cl_mem dataBuffer = clCreateBuffer(dev->context, CL_MEM_READ_ONLY, bytes, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create data Buffer\n");
+
+	printf("Histogram\n Elements : %u \n Local memory : %lu bytes\n", n,
+			(unsigned long) dev->localMem);
+	for (b = 0; b < numBinList; b++)
+	{
+		cl_uint bins = binList[b];
+		cl_uint *hist = (cl_uint *) malloc(sizeof(cl_uint) * bins);
+		cl_uint *ref = (cl_uint *) malloc(sizeof(cl_uint) * bins);
+		cl_mem histBuffer = clCreateBuffer(dev->context, CL_MEM_READ_WRITE,
+				sizeof(cl_uint) * bins, NULL, &ret);
+		CHECK_STATUS( ret,"Error: Create histogram Buffer\n");
+
+		for (skew = 0; skew < 2; skew++)
+		{
+			memset(ref, 0, sizeof(cl_uint) * bins);
+			for (i = 0; i < n; i++)
+			{
+				data[i] = skew && rand() % 10 ? bins / 2 : (cl_uint) rand() % bins;
+				ref[data[i]]++;
+			}
+			ret = clEnqueueWriteBuffer(dev->queue, dataBuffer, CL_TRUE, 0,
+					sizeof(cl_uint) * n, data, 0, NULL, NULL);
+			CHECK_STATUS( ret,"Error: Write histogram data\n");
+
+			// Automatic copies, then a single copy unless that is the same
+			cl_uint copies[2] = {0, 1};
+			cl_uint slices = 0;
+			for (c = 0; c < 2; c++)
+			{
+				PrimHistogram h;
+				if (PrimHistogramCreate(&h, dev, bins, copies[c]))
+					return 1;
+				if (c && h.numCopies == copies[0] && h.numSlice == slices)
+				{
+					PrimHistogramRelease(&h);
+					break;
+				}
+				copies[0] = h.numCopies;
+				slices = h.numSlice;
+
+				double time, total = 0;
+				int iter;
+				for (iter = 0; iter <= numIter; iter++)
+				{
+					if (PrimHistogramEnqueue(&h, dev, dataBuffer, n, histBuffer, &time))
+						return 1;
+					// The first run is a warm-up
+					if (iter)
+						total += time;
+				}
+				ret = clEnqueueReadBuffer(dev->queue, histBuffer, CL_TRUE, 0,
+						sizeof(cl_uint) * bins, hist, 0, NULL, NULL);
+				CHECK_STATUS( ret,"Error: Read histogram\n");
+
+				int bad = memcmp(hist, ref, sizeof(cl_uint) * bins) != 0;
+				failed |= bad;
+				char how[48];
+				if (h.numCopies)
+					sprintf(how, "%2u local cop%s x %2u slice%s", h.numCopies,
+							h.numCopies > 1 ? "ies" : "y ", h.numSlice,
+							h.numSlice > 1 ? "s" : "");
+				else
+					sprintf(how, "global atomics");
+				fprintf(stderr, "\t%6u bins %-7s %-27s %10.2f us %8.2f Melem/s%s\n",
+						bins, skew ? "skewed" : "uniform", how, total / numIter,
+						n / (total / numIter), bad ? "  MISMATCH" : "");
+				PrimHistogramRelease(&h);
+			}
+		}
+
+		clReleaseMemObject(histBuffer);
+		free(ref);
+		free(hist);
+	}
+	printf(failed ? "Histogram Fail\n" : "Histogram Successful\n");
+
+	clReleaseMemObject(dataBuffer);
+	free(data);
+	return failed;
+}
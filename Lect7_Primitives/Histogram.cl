@@ -0,0 +1,80 @@
+/*
+ * Histogram of uint bin indices; indices >= numBins are not counted.
+ *
+ * Histogram_local runs on a 2-D range: dimension 1 cuts the bins into
+ * slices of sliceBins, and each work-group counts only the indices in its
+ * slice, so a slice's sub-histograms fit in local memory however many bins
+ * there are.  A group holds numCopies sub-histograms of its slice,
+ * copyStride apart, with work-item i counting into copy i % numCopies, so
+ * few work-items contend for one local counter.  Each group folds its
+ * copies into its slice of its own row of partial, and Histogram_merge
+ * sums the rows.  Histogram_global is the last resort when there would be
+ * too many slices: global atomics straight into the result.
+ */
+
+__kernel void Histogram_local(__global const uint *data,
+                              const uint n,
+                              const uint numBins,
+                              const uint sliceBins,
+                              const uint numCopies,
+                              const uint copyStride,
+                              __global uint *partial,
+                              __local uint *sub)
+{
+    uint lid = get_local_id(0);
+    uint lsize = get_local_size(0);
+    uint first = get_group_id(1) * sliceBins;
+    uint count = min(sliceBins, numBins - first);
+
+    for (uint i = lid; i < numCopies * copyStride; i += lsize)
+        sub[i] = 0;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Indices below first wrap around and fail the test too
+    __local uint *mine = sub + (lid % numCopies) * copyStride;
+    for (uint i = get_global_id(0); i < n; i += get_global_size(0))
+    {
+        uint bin = data[i] - first;
+        if (bin < count)
+            atomic_inc(&mine[bin]);
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    __global uint *row = partial + get_group_id(0) * numBins + first;
+    for (uint bin = lid; bin < count; bin += lsize)
+    {
+        uint sum = 0;
+        for (uint c = 0; c < numCopies; c++)
+            sum += sub[c * copyStride + bin];
+        row[bin] = sum;
+    }
+}
+
+__kernel void Histogram_merge(__global const uint *partial,
+                              const uint numPartial,
+                              const uint numBins,
+                              __global uint *hist)
+{
+    uint bin = get_global_id(0);
+    if (bin >= numBins)
+        return;
+
+    uint sum = 0;
+    for (uint p = 0; p < numPartial; p++)
+        sum += partial[p * numBins + bin];
+    hist[bin] = sum;
+}
+
+/* hist must be zero beforehand */
+__kernel void Histogram_global(__global const uint *data,
+                               const uint n,
+                               const uint numBins,
+                               __global uint *hist)
+{
+    for (uint i = get_global_id(0); i < n; i += get_global_size(0))
+    {
+        uint bin = data[i];
+        if (bin < numBins)
+            atomic_inc(&hist[bin]);
+    }
+}
@@ -0,0 +1,180 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <CL/cl.h>
+#include "Prim.h"
+
+
+const char *PrimTypeName[PRIM_NUM_TYPE] = {"float", "int"};
+
+int main(int argc , char** argv) {
+
+	if (argc < 3)
+	{
+		printf(" Usage : ./prim <mode> <n> [options]\n");
+		printf("   reduce <n> [float|int] [sum|min|max|dot|argmax]\n");
+		printf("                           reduction to one value, every operation if none is given\n");
+		printf("   scan <n> [float|int] [numThreads]\n");
+		printf("                           inclusive and exclusive prefix sum, against a threaded CPU scan\n");
+		printf("   radix <n> [keys|pairs]  radix sort of 32-bit keys (and values), n/64 to n elements\n");
+		printf("   histogram <n> [numBins] 256, 4096 and 65536 bins if none is given\n");
+		printf("   compact <n> [float|int] [predicate]\n");
+		printf("                           keep the x for which predicate holds, e.g. x>0.5f (no spaces)\n");
+		exit(0);
+	}
+	cl_uint n = atoi(argv[2]);
+	PrimType type = argc > 3 && !strcmp(argv[3], "int") ? PRIM_INT : PRIM_FLOAT;
+
+	PrimDevice dev;
+	if (PrimDeviceInit(&dev))
+		return 1;
+
+	int ret = 1;
+	if (!strcmp(argv[1], "reduce"))
+	{
+		PrimReduceOp op = PRIM_NUM_REDUCE;
+		if (argc > 4)
+			for (op = 0; op < PRIM_NUM_REDUCE; op++)
+				if (!strcmp(argv[4], PrimReduceName[op]))
+					break;
+		ret = RunPrimReduce(&dev, n, type, op);
+	}
+	else if (!strcmp(argv[1], "scan"))
+	{
+		int numThread = argc > 4 ? atoi(argv[4]) : 0;
+		ret = RunPrimScan(&dev, n, type, numThread);
+	}
+	else if (!strcmp(argv[1], "radix"))
+	{
+		int withValues = argc > 3 && !strcmp(argv[3], "pairs");
+		ret = RunPrimRadixSort(&dev, n, withValues);
+	}
+	else if (!strcmp(argv[1], "histogram"))
+	{
+		cl_uint numBins = argc > 3 ? atoi(argv[3]) : 0;
+		ret = RunPrimHistogram(&dev, n, numBins);
+	}
+	else if (!strcmp(argv[1], "compact"))
+	{
+		const char *predicate = argc > 4 ? argv[4] : NULL;
+		ret = RunPrimCompact(&dev, n, type, predicate);
+	}
+	else
+		printf("Unknown mode %s\n", argv[1]);
+
+	PrimDeviceRelease(&dev);
+	return ret;
+}
+
+/*
+ * \brief Context and profiling queue on the first device of the first
+ * platform.
+ */
+int PrimDeviceInit(PrimDevice *dev)
+{
+	cl_int ret;
+	cl_platform_id platform_id = NULL;
+	cl_uint ret_num_platforms;
+	ret = clGetPlatformIDs(1, &platform_id, &ret_num_platforms);
+	CHECK_STATUS( ret,"Error: Get Platform IDs\n");
+	ret = clGetDeviceIDs(platform_id, CL_DEVICE_TYPE_ALL, 1, &dev->device, NULL);
+	CHECK_STATUS( ret,"Error: Get Device IDs\n");
+
+	char name[128];
+	clGetDeviceInfo(dev->device, CL_DEVICE_NAME, sizeof(name), name, NULL);
+	clGetDeviceInfo(dev->device, CL_DEVICE_MAX_COMPUTE_UNITS, sizeof(cl_uint),
+			&dev->numCU, NULL);
+	clGetDeviceInfo(dev->device, CL_DEVICE_MAX_WORK_GROUP_SIZE, sizeof(size_t),
+			&dev->maxLocal, NULL);
+	clGetDeviceInfo(dev->device, CL_DEVICE_LOCAL_MEM_SIZE, sizeof(cl_ulong),
+			&dev->localMem, NULL);
+	printf("\tDevice: %s, %u compute units\n", name, dev->numCU);
+
+	dev->context = clCreateContext(NULL, 1, &dev->device, NULL, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create Context\n");
+	dev->queue = clCreateCommandQueue(dev->context, dev->device,
+			CL_QUEUE_PROFILING_ENABLE, &ret);
+	CHECK_STATUS( ret,"Error: Create Command Queue\n");
+
+	return 0;
+}
+
+void PrimDeviceRelease(PrimDevice *dev)
+{
+	clFlush(dev->queue);
+	clFinish(dev->queue);
+	clReleaseCommandQueue(dev->queue);
+	clReleaseContext(dev->context);
+}
+
+/*
+ * \brief Build the kernels of file with the given -D options.  The build
+ * log is printed if the build fails.
+ */
+int PrimBuildProgram(PrimDevice *dev, const char *file, const char *options,
+		cl_program *program)
+{
+	cl_int ret;
+
+	FILE *fp = fopen(file, "r");
+	if (!fp) {
+		fprintf(stderr, "Failed to load kernel %s.\n", file);
+		exit(1);
+	}
+	char *source_str = (char*)malloc(MAX_SOURCE_SIZE);
+	size_t source_size = fread(source_str, 1, MAX_SOURCE_SIZE, fp);
+	fclose(fp);
+
+	*program = clCreateProgramWithSource(dev->context, 1,
+			(const char **)&source_str, &source_size, &ret);
+	free(source_str);
+	CHECK_STATUS( ret,"Error: Create Program\n");
+
+	ret = clBuildProgram(*program, 1, &dev->device, options, NULL, NULL);
+	if (ret != CL_SUCCESS)
+	{
+		size_t ret_val_size;
+		clGetProgramBuildInfo(*program, dev->device, CL_PROGRAM_BUILD_LOG,
+				0, NULL, &ret_val_size);
+		char *build_log = (char *)malloc(ret_val_size + 1);
+		clGetProgramBuildInfo(*program, dev->device, CL_PROGRAM_BUILD_LOG,
+				ret_val_size + 1, build_log, NULL);
+		build_log[ret_val_size] = '\0';
+		printf("Build log of %s (%s):\n %s...\n", file, options, build_log);
+		free(build_log);
+	}
+	CHECK_STATUS( ret,"Error: Build Program\n");
+
+	return 0;
+}
+
+size_t PrimLocalSize(PrimDevice *dev, size_t want)
+{
+	size_t local = 1;
+	while (local * 2 <= want && local * 2 <= dev->maxLocal)
+		local *= 2;
+	return local;
+}
+
+double PrimEventTime(cl_event event)
+{
+	cl_ulong t_start = 0;
+	cl_ulong t_end = 0;
+
+	clWaitForEvents(1, &event);
+	clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START,
+			sizeof(cl_ulong), &t_start, NULL);
+	clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END,
+			sizeof(cl_ulong), &t_end, NULL);
+
+	return (t_end - t_start) / 1e3;
+}
+
+double WallTime(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
@@ -0,0 +1,215 @@
+#ifndef _PRIM_H_
+#define _PRIM_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <CL/cl.h>
+
+#define CHECK_STATUS( status, message )   \
+		if(status != CL_SUCCESS) \
+		{ \
+			printf( message); \
+			printf( "\n" ); \
+			return 1; \
+		}
+
+/** Define custom constants*/
+#define MAX_SOURCE_SIZE (0x100000)
+
+/*
+ * One device with its context and profiling queue.  Every primitive builds
+ * its own program from its .cl file, specialised with -D options.
+ */
+typedef struct {
+	cl_device_id device;
+	cl_context context;
+	cl_command_queue queue;
+	cl_uint numCU;
+	size_t maxLocal;         /* CL_DEVICE_MAX_WORK_GROUP_SIZE */
+	cl_ulong localMem;       /* CL_DEVICE_LOCAL_MEM_SIZE */
+} PrimDevice;
+
+int PrimDeviceInit(PrimDevice *dev);
+void PrimDeviceRelease(PrimDevice *dev);
+int PrimBuildProgram(PrimDevice *dev, const char *file, const char *options,
+		cl_program *program);
+
+/* Largest power of two work-group size up to want that the device allows */
+size_t PrimLocalSize(PrimDevice *dev, size_t want);
+
+/* Kernel execution time of a profiled event, in microseconds */
+double PrimEventTime(cl_event event);
+
+/* Host wall-clock time, in microseconds */
+double WallTime(void);
+
+/* Element types of the primitives */
+typedef enum {
+	PRIM_FLOAT,
+	PRIM_INT,
+	PRIM_NUM_TYPE
+} PrimType;
+
+extern const char *PrimTypeName[PRIM_NUM_TYPE];
+
+
+/*
+ * Reduction of n elements to one value (Reduce.cl).  Every work-item first
+ * accumulates a grid-stride slice on its own, each group combines its
+ * work-items in a local-memory tree into one partial, and a single group
+ * reduces the partials the same way, so only the result is read back.
+ */
+typedef enum {
+	PRIM_REDUCE_SUM,
+	PRIM_REDUCE_MIN,
+	PRIM_REDUCE_MAX,
+	PRIM_REDUCE_DOT,         /* sum of a[i] * b[i] */
+	PRIM_REDUCE_ARGMAX,      /* largest value and its first index */
+	PRIM_NUM_REDUCE
+} PrimReduceOp;
+
+extern const char *PrimReduceName[PRIM_NUM_REDUCE];
+
+typedef struct {
+	PrimType type;
+	PrimReduceOp op;
+	size_t local;
+	size_t maxGroup;         /* groups of the first pass, at most */
+	cl_program program;
+	cl_kernel first;
+	cl_kernel final;
+	cl_mem partial;          /* one value per group, the result ends in [0] */
+	cl_mem partialIndex;     /* argmax: index of each partial value */
+} PrimReduce;
+
+int PrimReduceCreate(PrimReduce *r, PrimDevice *dev, PrimType type,
+		PrimReduceOp op);
+int PrimReduceProcess(PrimReduce *r, PrimDevice *dev, cl_mem a, cl_mem b,
+		cl_uint n, void *value, cl_uint *index, double *time);
+void PrimReduceRelease(PrimReduce *r);
+int RunPrimReduce(PrimDevice *dev, cl_uint n, PrimType type, PrimReduceOp op);
+
+
+/*
+ * Inclusive or exclusive prefix sum of up to maxN elements (Scan.cl).
+ * Blocks of 2 * local elements are scanned in local memory; their totals
+ * are scanned the same way one level up, recursively, and added back.
+ */
+#define PRIM_SCAN_MAX_LEVEL 8
+
+typedef struct {
+	PrimType type;
+	cl_uint maxN;
+	size_t local;
+	cl_uint blockLen;        /* elements per group, 2 * local */
+	cl_uint numLevel;
+	cl_mem level[PRIM_SCAN_MAX_LEVEL];   /* block sums of each level */
+	cl_program program;
+	cl_kernel block;
+	cl_kernel add;
+} PrimScan;
+
+int PrimScanCreate(PrimScan *s, PrimDevice *dev, PrimType type, cl_uint maxN);
+int PrimScanEnqueue(PrimScan *s, PrimDevice *dev, cl_mem in, cl_mem out,
+		cl_uint n, int inclusive, double *time);
+void PrimScanRelease(PrimScan *s);
+void cpu_scan(PrimType type, int inclusive, const void *in, void *out,
+		cl_uint n, int numThread);
+int RunPrimScan(PrimDevice *dev, cl_uint n, PrimType type, int numThread);
+
+
+/*
+ * LSD radix sort of up to maxN 32-bit unsigned keys, optionally with a
+ * 32-bit value each (RadixSort.cl).  Every pass sorts stably by the next
+ * PRIM_RADIX_BITS bits: tile histograms in local memory, an exclusive
+ * PrimScan of the digit counts, and a scatter in input order.
+ */
+#define PRIM_RADIX_BITS 4
+#define PRIM_RADIX_ITEMS 4
+
+typedef struct {
+	cl_uint maxN;
+	int withValues;
+	size_t local;
+	cl_uint tileLen;         /* elements per group, PRIM_RADIX_ITEMS * local */
+	PrimScan scan;
+	cl_mem count;            /* digit-major tile histograms, then their offsets */
+	cl_mem keyTemp;          /* the other half of the ping-pong of each pass */
+	cl_mem valTemp;
+	cl_program program;
+	cl_kernel countKernel;
+	cl_kernel scatterKernel;
+} PrimRadixSort;
+
+int PrimRadixSortCreate(PrimRadixSort *rs, PrimDevice *dev, cl_uint maxN,
+		int withValues);
+int PrimRadixSortEnqueue(PrimRadixSort *rs, PrimDevice *dev, cl_mem key,
+		cl_mem value, cl_uint n, double *time);
+void PrimRadixSortRelease(PrimRadixSort *rs);
+int RunPrimRadixSort(PrimDevice *dev, cl_uint n, int withValues);
+
+
+/*
+ * Histogram of numBins bins over uint bin indices (Histogram.cl).  The bin
+ * range is cut into numSlice slices that fit in local memory, and a 2-D
+ * range of work-groups x slices lets every group count its slice into
+ * numCopies private copies with local atomics; the groups' counts are
+ * merged on the device.  Only if the slices would need to reread the data
+ * too often do work-items use global atomics.
+ */
+#define PRIM_HIST_MAX_COPIES 32
+
+typedef struct {
+	cl_uint numBins;
+	cl_uint numCopies;       /* sub-histograms per group, 0 for global atomics */
+	cl_uint numSlice;        /* bin slices, one per index of dimension 1 */
+	cl_uint sliceBins;       /* bins per slice, the last may have fewer */
+	cl_uint copyStride;      /* sliceBins + 1, so copies start on different banks */
+	size_t local;
+	size_t numGroup;         /* work-groups per slice */
+	cl_program program;
+	cl_kernel count;         /* Histogram_local or Histogram_global */
+	cl_kernel merge;
+	cl_mem partial;          /* one row of numBins per group */
+} PrimHistogram;
+
+int PrimHistogramCreate(PrimHistogram *h, PrimDevice *dev, cl_uint numBins,
+		cl_uint numCopies);
+int PrimHistogramEnqueue(PrimHistogram *h, PrimDevice *dev, cl_mem data,
+		cl_uint n, cl_mem hist, double *time);
+void PrimHistogramRelease(PrimHistogram *h);
+int RunPrimHistogram(PrimDevice *dev, cl_uint n, cl_uint numBins);
+
+
+/*
+ * Stream compaction (Compact.cl): the elements x of an array for which a
+ * predicate, an OpenCL C expression in x built in with -D, holds, packed
+ * in their input order, and their count.  Each tile of PRIM_COMPACT_ITEMS
+ * * local elements is counted with per-work-item ballots, an inclusive
+ * PrimScan of the counts places the tiles, and a scatter writes them.
+ */
+#define PRIM_COMPACT_ITEMS 8
+
+typedef struct {
+	PrimType type;
+	cl_uint maxN;
+	size_t local;
+	cl_uint tileLen;         /* elements per group, PRIM_COMPACT_ITEMS * local */
+	PrimScan scan;
+	cl_mem count;            /* survivors per tile */
+	cl_mem end;              /* their inclusive scan, the last is the total */
+	cl_program program;
+	cl_kernel countKernel;
+	cl_kernel scatterKernel;
+	cl_kernel flagsKernel;
+} PrimCompact;
+
+int PrimCompactCreate(PrimCompact *c, PrimDevice *dev, PrimType type,
+		const char *predicate, cl_uint maxN);
+int PrimCompactEnqueue(PrimCompact *c, PrimDevice *dev, cl_mem in, cl_uint n,
+		cl_mem out, cl_uint *count, double *time);
+void PrimCompactRelease(PrimCompact *c);
+int RunPrimCompact(PrimDevice *dev, cl_uint n, PrimType type,
+		const char *predicate);
+
+#endif
@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <CL/cl.h>
+#include "Prim.h"
+
+/*
+ * \brief Build RadixSort.cl and allocate the digit counts, their scan and
+ * the temporary key (and value) buffer for up to maxN elements.
+ */
+int PrimRadixSortCreate(PrimRadixSort *rs, PrimDevice *dev, cl_uint maxN,
+		int withValues)
+{
+	cl_int ret;
+	char options[128];
+
+	memset(rs, 0, sizeof(*rs));
+	rs->maxN = maxN;
+	rs->withValues = withValues;
+	rs->local = PrimLocalSize(dev, 128);
+	rs->tileLen = PRIM_RADIX_ITEMS * rs->local;
+
+	sprintf(options, "-D RADIX_BITS=%d -D RADIX_ITEMS=%d%s", PRIM_RADIX_BITS,
+			PRIM_RADIX_ITEMS, withValues ? " -D RADIX_VALUES" : "");
+	if (PrimBuildProgram(dev, "RadixSort.cl", options, &rs->program))
+		return 1;
+
+	cl_uint numTile = (maxN + rs->tileLen - 1) / rs->tileLen;
+	cl_uint numCount = (1 << PRIM_RADIX_BITS) * (numTile ? numTile : 1);
+	if (PrimScanCreate(&rs->scan, dev, PRIM_INT, numCount))
+		return 1;
+
+	rs->count = clCreateBuffer(dev->context, CL_MEM_READ_WRITE,
+			sizeof(cl_uint) * numCount, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create digit count Buffer\n");
+	rs->keyTemp = clCreateBuffer(dev->context, CL_MEM_READ_WRITE,
+			sizeof(cl_uint) * (maxN ? maxN : 1), NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create temp key Buffer\n");
+	// Without values the kernel never touches this one, but needs an argument
+	rs->valTemp = clCreateBuffer(dev->context, CL_MEM_READ_WRITE,
+			sizeof(cl_uint) * (withValues && maxN ? maxN : 1), NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create temp value Buffer\n");
+
+	rs->countKernel = clCreateKernel(rs->program, "Radix_count", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (Radix_count)\n");
+	rs->scatterKernel = clCreateKernel(rs->program, "Radix_scatter", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (Radix_scatter)\n");
+
+	ret = clSetKernelArg(rs->countKernel, 3, sizeof(cl_mem), (void *)&rs->count);
+	ret |= clSetKernelArg(rs->countKernel, 4, sizeof(cl_uint) << PRIM_RADIX_BITS, NULL);
+	ret |= clSetKernelArg(rs->scatterKernel, 6, sizeof(cl_mem), (void *)&rs->count);
+	ret |= clSetKernelArg(rs->scatterKernel, 7, sizeof(cl_uint) * rs->tileLen, NULL);
+	ret |= clSetKernelArg(rs->scatterKernel, 8,
+			sizeof(cl_uint) * (withValues ? rs->tileLen : 1), NULL);
+	ret |= clSetKernelArg(rs->scatterKernel, 9,
+			(sizeof(cl_uint) << PRIM_RADIX_BITS) * rs->local, NULL);
+	ret |= clSetKernelArg(rs->scatterKernel, 10, sizeof(cl_uint) * rs->local, NULL);
+	CHECK_STATUS( ret,"Error: Set kernel arguments (Radix)\n");
+
+	return 0;
+}
+
+/*
+ * \brief Queue the sort of the first n (<= maxN) keys of key, and of the
+ * values of value along with them (value is ignored without values).  The
+ * pass count is even, so the result ends in key / value.  If time is not
+ * NULL it receives the kernel time of every launch in us, which waits for
+ * each of them.
+ */
+int PrimRadixSortEnqueue(PrimRadixSort *rs, PrimDevice *dev, cl_mem key,
+		cl_mem value, cl_uint n, double *time)
+{
+	cl_int ret;
+	cl_uint shift;
+	cl_mem keyBuf[2] = {key, rs->keyTemp};
+	cl_mem valBuf[2] = {rs->withValues ? value : rs->valTemp, rs->valTemp};
+	double scanTime;
+
+	if (time)
+		*time = 0;
+	if (n == 0)
+		return 0;
+	if (n > rs->maxN)
+	{
+		printf("Error: sort of %u keys, created for %u\n", n, rs->maxN);
+		return 1;
+	}
+
+	cl_uint numTile = (n + rs->tileLen - 1) / rs->tileLen;
+	size_t globalThreads[1] = {numTile * rs->local};
+	size_t localThreads[1] = {rs->local};
+	for (shift = 0; shift < 32; shift += PRIM_RADIX_BITS)
+	{
+		int src = (shift / PRIM_RADIX_BITS) & 1;
+		cl_event event[2];
+
+		ret = clSetKernelArg(rs->countKernel, 0, sizeof(cl_mem), (void *)&keyBuf[src]);
+		ret |= clSetKernelArg(rs->countKernel, 1, sizeof(cl_uint), (void *)&n);
+		ret |= clSetKernelArg(rs->countKernel, 2, sizeof(cl_uint), (void *)&shift);
+		CHECK_STATUS( ret,"Error: Set count arguments\n");
+		ret = clEnqueueNDRangeKernel(dev->queue, rs->countKernel, 1, NULL,
+				globalThreads, localThreads, 0, NULL, time ? &event[0] : NULL);
+		CHECK_STATUS( ret,"Error: Range kernel. (Radix_count)\n");
+
+		if (PrimScanEnqueue(&rs->scan, dev, rs->count, rs->count,
+					numTile << PRIM_RADIX_BITS, 0, time ? &scanTime : NULL))
+			return 1;
+
+		ret = clSetKernelArg(rs->scatterKernel, 0, sizeof(cl_mem), (void *)&keyBuf[src]);
+		ret |= clSetKernelArg(rs->scatterKernel, 1, sizeof(cl_mem), (void *)&keyBuf[!src]);
+		ret |= clSetKernelArg(rs->scatterKernel, 2, sizeof(cl_mem), (void *)&valBuf[src]);
+		ret |= clSetKernelArg(rs->scatterKernel, 3, sizeof(cl_mem), (void *)&valBuf[!src]);
+		ret |= clSetKernelArg(rs->scatterKernel, 4, sizeof(cl_uint), (void *)&n);
+		ret |= clSetKernelArg(rs->scatterKernel, 5, sizeof(cl_uint), (void *)&shift);
+		CHECK_STATUS( ret,"Error: Set scatter arguments\n");
+		ret = clEnqueueNDRangeKernel(dev->queue, rs->scatterKernel, 1, NULL,
+				globalThreads, localThreads, 0, NULL, time ? &event[1] : NULL);
+		CHECK_STATUS( ret,"Error: Range kernel. (Radix_scatter)\n");
+
+		if (time)
+		{
+			*time += PrimEventTime(event[0]) + scanTime + PrimEventTime(event[1]);
+			clReleaseEvent(event[0]);
+			clReleaseEvent(event[1]);
+		}
+	}
+
+	return 0;
+}
+
+void PrimRadixSortRelease(PrimRadixSort *rs)
+{
+	clReleaseKernel(rs->scatterKernel);
+	clReleaseKernel(rs->countKernel);
+	clReleaseMemObject(rs->valTemp);
+	clReleaseMemObject(rs->keyTemp);
+	clReleaseMemObject(rs->count);
+	PrimScanRelease(&rs->scan);
+	clReleaseProgram(rs->program);
+}
+
+
+/* A key and its input position, the reference order of a stable sort */
+typedef struct {
+	cl_uint key;
+	cl_uint index;
+} RadixPair;
+
+static int ComparePair(const void *a, const void *b)
+{
+	const RadixPair *x = (const RadixPair *) a;
+	const RadixPair *y = (const RadixPair *) b;
+	if (x->key != y->key)
+		return x->key < y->key ? -1 : 1;
+	return x->index < y->index ? -1 : x->index > y->index;
+}
+
+static int CompareKey(const void *a, const void *b)
+{
+	cl_uint x = *(const cl_uint *) a;
+	cl_uint y = *(const cl_uint *) b;
+	return x < y ? -1 : x > y;
+}
+
+static const char *RadixDistName[] = {
+	"uniform", "8-bit", "sorted", "reverse", "constant",
+};
+
+static cl_uint RadixKey(int dist, cl_uint i, cl_uint n)
+{
+	switch (dist)
+	{
+	case 0: return ((cl_uint) rand() << 16) ^ (cl_uint) rand();
+	case 1: return rand() & 0xFF;
+	case 2: return i;
+	case 3: return n - i;
+	default: return 0x5A5A5A5A;
+	}
+}
+
+/*
+ * \brief Sort n/64, n/8 and n keys of each distribution (with their input
+ * positions as values if withValues) and compare with qsort: keys only
+ * against the sorted keys, pairs against a sort by (key, position), which
+ * is what a stable sort must give.
+ */
+int RunPrimRadixSort(PrimDevice *dev, cl_uint n, int withValues)
+{
+	cl_int ret;
+	cl_uint i;
+	int d, z;
+	int failed = 0;
+	const int numDist = sizeof(RadixDistName) / sizeof(RadixDistName[0]);
+	cl_uint size[3] = {n / 64, n / 8, n};
+
+	size_t bytes = sizeof(cl_uint) * (n ? n : 1);
+	cl_uint *key = (cl_uint *) malloc(bytes);
+	cl_uint *value = (cl_uint *) malloc(bytes);
+	cl_uint *ref = (cl_uint *) malloc(bytes);
+	RadixPair *pair = (RadixPair *) malloc(sizeof(RadixPair) * (n ? n : 1));
+
+	cl_mem keyBuffer = clCreateBuffer(dev->context, CL_MEM_READ_WRITE, bytes, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create key Buffer\n");
+	cl_mem valBuffer = clCreateBuffer(dev->context, CL_MEM_READ_WRITE, bytes, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create value Buffer\n");
+
+	PrimRadixSort rs;
+	if (PrimRadixSortCreate(&rs, dev, n, withValues))
+		return 1;
+	printf("Radix sort\n Elements : %s \n Digit : %d bits, %u keys per tile\n",
+			withValues ? "32-bit key + 32-bit value" : "32-bit key",
+			PRIM_RADIX_BITS, rs.tileLen);
+
+	for (z = 0; z < 3; z++)
+	{
+		cl_uint m = size[z];
+		if (m == 0 || (z && m == size[z - 1]))
+			continue;
+		for (d = 0; d < numDist; d++)
+		{
+			for (i = 0; i < m; i++)
+			{
+				key[i] = RadixKey(d, i, m);
+				value[i] = i;
+				pair[i].key = key[i];
+				pair[i].index = i;
+			}
+			ret = clEnqueueWriteBuffer(dev->queue, keyBuffer, CL_FALSE, 0,
+					sizeof(cl_uint) * m, key, 0, NULL, NULL);
+			ret |= clEnqueueWriteBuffer(dev->queue, valBuffer, CL_TRUE, 0,
+					sizeof(cl_uint) * m, value, 0, NULL, NULL);
+			CHECK_STATUS( ret,"Error: Write keys\n");
+
+			double time;
+			if (PrimRadixSortEnqueue(&rs, dev, keyBuffer, valBuffer, m, &time))
+				return 1;
+			ret = clEnqueueReadBuffer(dev->queue, keyBuffer, CL_FALSE, 0,
+					sizeof(cl_uint) * m, key, 0, NULL, NULL);
+			ret |= clEnqueueReadBuffer(dev->queue, valBuffer, CL_TRUE, 0,
+					sizeof(cl_uint) * m, value, 0, NULL, NULL);
+			CHECK_STATUS( ret,"Error: Read keys\n");
+
+			// The reference sort, timed on the same keys
+			double cpuTime = WallTime();
+			if (withValues)
+				qsort(pair, m, sizeof(RadixPair), ComparePair);
+			else
+			{
+				for (i = 0; i < m; i++)
+					ref[i] = pair[i].key;
+				qsort(ref, m, sizeof(cl_uint), CompareKey);
+			}
+			cpuTime = WallTime() - cpuTime;
+
+			int bad = 0;
+			for (i = 0; i < m && !bad; i++)
+			{
+				if (withValues)
+					bad = key[i] != pair[i].key || value[i] != pair[i].index;
+				else
+					bad = key[i] != ref[i];
+				if (bad)
+					printf("Mismatch at %u of %u (%s)\n", i, m, RadixDistName[d]);
+			}
+			failed |= bad;
+
+			fprintf(stderr, "\t%-8s %10u keys %12.2f us %8.2f Mkeys/s   qsort %8.2f Mkeys/s\n",
+					RadixDistName[d], m, time, m / time, m / cpuTime);
+		}
+	}
+	printf(failed ? "Radix sort Fail\n" : "Radix sort Successful\n");
+
+	PrimRadixSortRelease(&rs);
+	clReleaseMemObject(valBuffer);
+	clReleaseMemObject(keyBuffer);
+	free(pair);
+	free(ref);
+	free(value);
+	free(key);
+	return failed;
+}
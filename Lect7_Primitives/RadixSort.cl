@@ -0,0 +1,121 @@
+/*
+ * One pass of an LSD radix sort of 32-bit unsigned keys, specialised at
+ * build time:
+ *   -D RADIX_BITS=b        bits per digit
+ *   -D RADIX_ITEMS=k       elements per work-item, a tile is k * local
+ *   -D RADIX_VALUES        carry a 32-bit value along with each key
+ *
+ * Radix_count writes each tile's digit histogram digit-major,
+ * count[digit * numGroups + group], so an exclusive scan of count gives
+ * every (digit, tile) its first output position.  Radix_scatter then
+ * moves the tile's elements there in their input order, which keeps the
+ * sort stable.
+ */
+
+#define RADIX (1 << RADIX_BITS)
+#define DIGIT(key, shift) (((key) >> (shift)) & (RADIX - 1))
+
+__kernel void Radix_count(__global const uint *key,
+                          const uint n,
+                          const uint shift,
+                          __global uint *count,
+                          __local uint *hist)
+{
+    uint lid = get_local_id(0);
+    uint tile = RADIX_ITEMS * get_local_size(0);
+    uint base = get_group_id(0) * tile;
+
+    for (uint d = lid; d < RADIX; d += get_local_size(0))
+        hist[d] = 0;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (uint i = lid; i < tile; i += get_local_size(0))
+        if (base + i < n)
+            atomic_inc(&hist[DIGIT(key[base + i], shift)]);
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (uint d = lid; d < RADIX; d += get_local_size(0))
+        count[d * get_num_groups(0) + get_group_id(0)] = hist[d];
+}
+
+/*
+ * offset is count after its exclusive scan.  Local arrays: lkey and lval
+ * hold the tile, rank RADIX * local counters laid out [digit][work-item],
+ * total one entry per work-item.
+ */
+__kernel void Radix_scatter(__global const uint *keyIn,
+                            __global uint *keyOut,
+                            __global const uint *valIn,
+                            __global uint *valOut,
+                            const uint n,
+                            const uint shift,
+                            __global const uint *offset,
+                            __local uint *lkey,
+                            __local uint *lval,
+                            __local uint *rank,
+                            __local uint *total)
+{
+    uint lid = get_local_id(0);
+    uint lsize = get_local_size(0);
+    uint tile = RADIX_ITEMS * lsize;
+    uint base = get_group_id(0) * tile;
+
+    // Coalesced load of the tile
+    for (uint i = lid; i < tile; i += lsize)
+    {
+        lkey[i] = base + i < n ? keyIn[base + i] : 0;
+#ifdef RADIX_VALUES
+        lval[i] = base + i < n ? valIn[base + i] : 0;
+#endif
+    }
+    for (uint d = 0; d < RADIX; d++)
+        rank[d * lsize + lid] = 0;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Each work-item owns RADIX_ITEMS consecutive elements of the tile
+    uint first = lid * RADIX_ITEMS;
+    uint valid = base + first < n ? min((uint)RADIX_ITEMS, n - base - first) : 0;
+    for (uint k = 0; k < valid; k++)
+        rank[DIGIT(lkey[first + k], shift) * lsize + lid]++;
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // Exclusive scan of rank as one flat array: sequential over RADIX
+    // entries per work-item, then across the work-items' totals
+    uint sum = 0;
+    for (uint j = 0; j < RADIX; j++)
+        sum += rank[lid * RADIX + j];
+    total[lid] = sum;
+    barrier(CLK_LOCAL_MEM_FENCE);
+    for (uint s = 1; s < lsize; s <<= 1)
+    {
+        uint t = lid >= s ? total[lid - s] : 0;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        total[lid] += t;
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+    uint acc = total[lid] - sum;
+    for (uint j = 0; j < RADIX; j++)
+    {
+        uint c = rank[lid * RADIX + j];
+        rank[lid * RADIX + j] = acc;
+        acc += c;
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    // rank[d][lid] - rank[d][0] elements of digit d come before this
+    // work-item's in the tile
+    for (uint k = 0; k < valid; k++)
+    {
+        uint key = lkey[first + k];
+        uint d = DIGIT(key, shift);
+        uint dst = offset[d * get_num_groups(0) + get_group_id(0)] +
+            rank[d * lsize + lid] - rank[d * lsize];
+        for (uint j = 0; j < k; j++)
+            dst += DIGIT(lkey[first + j], shift) == d;
+
+        keyOut[dst] = key;
+#ifdef RADIX_VALUES
+        valOut[dst] = lval[first + k];
+#endif
+    }
+}
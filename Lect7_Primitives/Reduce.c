@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <CL/cl.h>
+#include "Prim.h"
+
+const char *PrimReduceName[PRIM_NUM_REDUCE] = {
+	"sum",
+	"min",
+	"max",
+	"dot",
+	"argmax",
+};
+
+static const char *ReduceDefine[PRIM_NUM_REDUCE] = {
+	"-D REDUCE_SUM",
+	"-D REDUCE_MIN",
+	"-D REDUCE_MAX",
+	"-D REDUCE_DOT",
+	"-D REDUCE_ARGMAX",
+};
+
+/* Work-groups per compute unit in the first pass */
+#define REDUCE_GROUPS_PER_CU 8
+
+/*
+ * \brief Build Reduce.cl for one element type and operation.
+ */
+int PrimReduceCreate(PrimReduce *r, PrimDevice *dev, PrimType type,
+		PrimReduceOp op)
+{
+	cl_int ret;
+	char options[128];
+
+	memset(r, 0, sizeof(*r));
+	r->type = type;
+	r->op = op;
+	r->local = PrimLocalSize(dev, 256);
+	r->maxGroup = dev->numCU * REDUCE_GROUPS_PER_CU;
+
+	sprintf(options, "%s %s", type == PRIM_INT ? "-D T_INT" : "-D T_FLOAT",
+			ReduceDefine[op]);
+	if (PrimBuildProgram(dev, "Reduce.cl", options, &r->program))
+		return 1;
+
+	r->partial = clCreateBuffer(dev->context, CL_MEM_READ_WRITE,
+			sizeof(cl_float) * r->maxGroup, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create partial Buffer\n");
+	r->partialIndex = clCreateBuffer(dev->context, CL_MEM_READ_WRITE,
+			sizeof(cl_uint) * r->maxGroup, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create partial index Buffer\n");
+
+	r->first = clCreateKernel(r->program, "Reduce_first", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (Reduce_first)\n");
+	r->final = clCreateKernel(r->program, "Reduce_final", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (Reduce_final)\n");
+
+	// Both element types are 4 bytes
+	ret = clSetKernelArg(r->first, 3, sizeof(cl_mem), (void *)&r->partial);
+	ret |= clSetKernelArg(r->first, 4, sizeof(cl_mem), (void *)&r->partialIndex);
+	ret |= clSetKernelArg(r->first, 5, sizeof(cl_float) * r->local, NULL);
+	ret |= clSetKernelArg(r->first, 6, sizeof(cl_uint) * r->local, NULL);
+	ret |= clSetKernelArg(r->final, 0, sizeof(cl_mem), (void *)&r->partial);
+	ret |= clSetKernelArg(r->final, 1, sizeof(cl_mem), (void *)&r->partialIndex);
+	ret |= clSetKernelArg(r->final, 3, sizeof(cl_float) * r->local, NULL);
+	ret |= clSetKernelArg(r->final, 4, sizeof(cl_uint) * r->local, NULL);
+	CHECK_STATUS( ret,"Error: Set kernel arguments (Reduce)\n");
+
+	return 0;
+}
+
+/*
+ * \brief Reduce the n elements of a (dot: of a[i] * b[i], b is unused
+ * otherwise) and read back the one result into value (a cl_float or
+ * cl_int) and, for argmax, its index.  time, if not NULL, receives the
+ * kernel time of both passes in us.
+ */
+int PrimReduceProcess(PrimReduce *r, PrimDevice *dev, cl_mem a, cl_mem b,
+		cl_uint n, void *value, cl_uint *index, double *time)
+{
+	cl_int ret;
+	cl_event event[2];
+
+	size_t numGroup = (n + r->local - 1) / r->local;
+	if (numGroup > r->maxGroup)
+		numGroup = r->maxGroup;
+	if (numGroup == 0)
+		numGroup = 1;
+	cl_uint numPartial = numGroup;
+
+	ret = clSetKernelArg(r->first, 0, sizeof(cl_mem), (void *)&a);
+	ret |= clSetKernelArg(r->first, 1, sizeof(cl_mem), (void *)&b);
+	ret |= clSetKernelArg(r->first, 2, sizeof(cl_uint), (void *)&n);
+	ret |= clSetKernelArg(r->final, 2, sizeof(cl_uint), (void *)&numPartial);
+	CHECK_STATUS( ret,"Error: Set reduce arguments\n");
+
+	size_t globalThreads[1] = {numGroup * r->local};
+	size_t localThreads[1] = {r->local};
+	ret = clEnqueueNDRangeKernel(dev->queue, r->first, 1, NULL,
+			globalThreads, localThreads, 0, NULL, &event[0]);
+	CHECK_STATUS( ret,"Error: Range kernel. (Reduce_first)\n");
+	ret = clEnqueueNDRangeKernel(dev->queue, r->final, 1, NULL,
+			localThreads, localThreads, 0, NULL, &event[1]);
+	CHECK_STATUS( ret,"Error: Range kernel. (Reduce_final)\n");
+
+	ret = clEnqueueReadBuffer(dev->queue, r->partial, CL_TRUE, 0,
+			sizeof(cl_float), value, 0, NULL, NULL);
+	CHECK_STATUS( ret,"Error: Read reduce result\n");
+	if (r->op == PRIM_REDUCE_ARGMAX)
+	{
+		ret = clEnqueueReadBuffer(dev->queue, r->partialIndex, CL_TRUE, 0,
+				sizeof(cl_uint), index, 0, NULL, NULL);
+		CHECK_STATUS( ret,"Error: Read reduce index\n");
+	}
+
+	if (time)
+		*time = PrimEventTime(event[0]) + PrimEventTime(event[1]);
+	clReleaseEvent(event[0]);
+	clReleaseEvent(event[1]);
+	return 0;
+}
+
+void PrimReduceRelease(PrimReduce *r)
+{
+	clReleaseKernel(r->final);
+	clReleaseKernel(r->first);
+	clReleaseMemObject(r->partialIndex);
+	clReleaseMemObject(r->partial);
+	clReleaseProgram(r->program);
+}
+
+/*
+ * \brief Reference reduction in double, exact for the int inputs of
+ * RunPrimReduce.  scale receives the sum of the magnitudes of the terms,
+ * for the rounding tolerance of float sum and dot.
+ */
+static void cpu_reduce(PrimType type, PrimReduceOp op, const void *a,
+		const void *b, cl_uint n, double *value, cl_uint *index, double *scale)
+{
+	cl_uint i;
+	double lowest = type == PRIM_INT ? INT32_MIN : -INFINITY;
+	double highest = type == PRIM_INT ? INT32_MAX : INFINITY;
+	double acc = op == PRIM_REDUCE_MIN ? highest :
+		op == PRIM_REDUCE_SUM || op == PRIM_REDUCE_DOT ? 0 : lowest;
+
+	*index = UINT32_MAX;
+	*scale = 0;
+	for (i = 0; i < n; i++)
+	{
+		double x = type == PRIM_INT ? ((const cl_int *) a)[i] : ((const cl_float *) a)[i];
+		double y = type == PRIM_INT ? ((const cl_int *) b)[i] : ((const cl_float *) b)[i];
+		switch (op)
+		{
+		case PRIM_REDUCE_SUM:
+			acc += x;
+			*scale += fabs(x);
+			break;
+		case PRIM_REDUCE_DOT:
+			// Rounded to float, as the device multiplies
+			x = type == PRIM_INT ? x * y : (float) x * (float) y;
+			acc += x;
+			*scale += fabs(x);
+			break;
+		case PRIM_REDUCE_MIN:
+			if (x < acc)
+				acc = x;
+			break;
+		default:
+			// First occurrence of the largest value
+			if (x > acc || *index == UINT32_MAX)
+			{
+				acc = x;
+				*index = i;
+			}
+			break;
+		}
+	}
+	*value = acc;
+}
+
+/*
+ * \brief Time each operation (or only op) on n random elements of type and
+ * check it against cpu_reduce: exactly, except float sum and dot within
+ * the rounding of the terms' magnitudes.
+ */
+int RunPrimReduce(PrimDevice *dev, cl_uint n, PrimType type, PrimReduceOp op)
+{
+	cl_int ret;
+	cl_uint i;
+	int o, iter;
+	const int numIter = 10;
+	int failed = 0;
+
+	// Both element types are 4 bytes
+	size_t size = sizeof(cl_float) * (n ? n : 1);
+	void *a = malloc(size);
+	void *b = malloc(size);
+	for (i = 0; i < n; i++)
+	{
+		if (type == PRIM_INT)
+		{
+			((cl_int *) a)[i] = rand() % 201 - 100;
+			((cl_int *) b)[i] = rand() % 201 - 100;
+		}
+		else
+		{
+			((cl_float *) a)[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+			((cl_float *) b)[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+		}
+	}
+
+	cl_mem aBuffer = clCreateBuffer(dev->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			size, a, &ret);
+	CHECK_STATUS( ret,"Error: Create a Buffer\n");
+	cl_mem bBuffer = clCreateBuffer(dev->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			size, b, &ret);
+	CHECK_STATUS( ret,"Error: Create b Buffer\n");
+
+	printf("Reduction\n Type : %s \n Elements : %u\n", PrimTypeName[type], n);
+	for (o = 0; o < PRIM_NUM_REDUCE; o++)
+	{
+		if (op != PRIM_NUM_REDUCE && o != op)
+			continue;
+
+		PrimReduce r;
+		if (PrimReduceCreate(&r, dev, type, o))
+			return 1;
+
+		union { cl_float f; cl_int i; } value;
+		cl_uint index = 0;
+		double time, total = 0;
+		for (iter = 0; iter <= numIter; iter++)
+		{
+			if (PrimReduceProcess(&r, dev, aBuffer, bBuffer, n, &value, &index, &time))
+				return 1;
+			// The first run is a warm-up
+			if (iter)
+				total += time;
+		}
+		PrimReduceRelease(&r);
+
+		double ref, scale;
+		cl_uint refIndex;
+		cpu_reduce(type, o, a, b, n, &ref, &refIndex, &scale);
+		double got = type == PRIM_INT ? value.i : value.f;
+		int bad = o == PRIM_REDUCE_ARGMAX && index != refIndex;
+		if (type == PRIM_FLOAT && (o == PRIM_REDUCE_SUM || o == PRIM_REDUCE_DOT))
+			bad |= !(fabs(got - ref) <= 1e-5 * scale + 1e-30);
+		else
+			bad |= got != ref;
+		failed |= bad;
+
+		double bytes = sizeof(cl_float) * (double) n * (o == PRIM_REDUCE_DOT ? 2 : 1);
+		fprintf(stderr, "\t%-7s %8.2f us  %8.2f GB/s  result %.9g", PrimReduceName[o],
+				total / numIter, bytes / (total / numIter) / 1e3, got);
+		if (o == PRIM_REDUCE_ARGMAX)
+			fprintf(stderr, " at %u", index);
+		fprintf(stderr, bad ? "  (expected %.9g)\n" : "\n", ref);
+	}
+	printf(failed ? "Reduce Fail\n" : "Reduce Successful\n");
+
+	clReleaseMemObject(bBuffer);
+	clReleaseMemObject(aBuffer);
+	free(b);
+	free(a);
+	return failed;
+}
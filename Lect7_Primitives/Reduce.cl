@@ -0,0 +1,128 @@
+/*
+ * Reduction to one value, specialised at build time:
+ *   -D T_FLOAT | -D T_INT      element type
+ *   -D REDUCE_SUM | REDUCE_MIN | REDUCE_MAX | REDUCE_DOT | REDUCE_ARGMAX
+ *
+ * Reduce_first leaves one partial per work-group, Reduce_final runs as a
+ * single work-group over the partials and leaves the result in partial[0]
+ * (and its index in partialIndex[0] for argmax).  Work-group sizes are
+ * powers of two.
+ */
+
+#ifdef T_INT
+#define T int
+#define T_LOWEST INT_MIN
+#define T_HIGHEST INT_MAX
+#else
+#define T float
+#define T_LOWEST (-INFINITY)
+#define T_HIGHEST INFINITY
+#endif
+
+#if defined(REDUCE_MIN)
+#define IDENTITY T_HIGHEST
+#define COMBINE(x, y) min(x, y)
+#elif defined(REDUCE_MAX) || defined(REDUCE_ARGMAX)
+#define IDENTITY T_LOWEST
+#define COMBINE(x, y) max(x, y)
+#else
+#define IDENTITY ((T)0)
+#define COMBINE(x, y) ((x) + (y))
+#endif
+
+#ifdef REDUCE_ARGMAX
+/* Ties go to the lower index, as with a sequential scan */
+#define TAKE(acc, accIndex, v, i) \
+    if ((v) > (acc) || ((v) == (acc) && (i) < (accIndex))) { acc = (v); accIndex = (i); }
+#else
+#define TAKE(acc, accIndex, v, i) acc = COMBINE(acc, v)
+#endif
+
+/*
+ * Combine the (acc, accIndex) of every work-item of the group with a tree
+ * in local memory; the group's result ends in lval[0] / lidx[0].
+ */
+void group_reduce(T acc, uint accIndex, __local T *lval, __local uint *lidx)
+{
+    uint lid = get_local_id(0);
+
+    lval[lid] = acc;
+#ifdef REDUCE_ARGMAX
+    lidx[lid] = accIndex;
+#endif
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for (uint s = get_local_size(0) / 2; s > 0; s >>= 1)
+    {
+        if (lid < s)
+        {
+            TAKE(acc, accIndex, lval[lid + s], lidx[lid + s]);
+            lval[lid] = acc;
+#ifdef REDUCE_ARGMAX
+            lidx[lid] = accIndex;
+#endif
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+}
+
+__kernel void Reduce_first(__global const T *a,
+                           __global const T *b,
+                           const uint n,
+                           __global T *partial,
+                           __global uint *partialIndex,
+                           __local T *lval,
+                           __local uint *lidx)
+{
+    T acc = IDENTITY;
+    uint accIndex = UINT_MAX;
+
+    // Sequential over a grid-stride slice, so the tree only sees one value
+    // per work-item
+    for (uint i = get_global_id(0); i < n; i += get_global_size(0))
+    {
+#ifdef REDUCE_DOT
+        acc += a[i] * b[i];
+#else
+        TAKE(acc, accIndex, a[i], i);
+#endif
+    }
+
+    group_reduce(acc, accIndex, lval, lidx);
+    if (get_local_id(0) == 0)
+    {
+        partial[get_group_id(0)] = lval[0];
+#ifdef REDUCE_ARGMAX
+        partialIndex[get_group_id(0)] = lidx[0];
+#endif
+    }
+}
+
+__kernel void Reduce_final(__global T *partial,
+                           __global uint *partialIndex,
+                           const uint numPartial,
+                           __local T *lval,
+                           __local uint *lidx)
+{
+    T acc = IDENTITY;
+    uint accIndex = UINT_MAX;
+
+    for (uint i = get_local_id(0); i < numPartial; i += get_local_size(0))
+    {
+#ifdef REDUCE_ARGMAX
+        TAKE(acc, accIndex, partial[i], partialIndex[i]);
+#else
+        TAKE(acc, accIndex, partial[i], i);
+#endif
+    }
+
+    // Every partial has been read before the tree's first barrier
+    group_reduce(acc, accIndex, lval, lidx);
+    if (get_local_id(0) == 0)
+    {
+        partial[0] = lval[0];
+#ifdef REDUCE_ARGMAX
+        partialIndex[0] = lidx[0];
+#endif
+    }
+}
@@ -0,0 +1,355 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <CL/cl.h>
+#include "Prim.h"
+
+/*
+ * \brief Build Scan.cl for one element type and allocate the block sums of
+ * every level for arrays of up to maxN elements.
+ */
+int PrimScanCreate(PrimScan *s, PrimDevice *dev, PrimType type, cl_uint maxN)
+{
+	cl_int ret;
+
+	memset(s, 0, sizeof(*s));
+	s->type = type;
+	s->maxN = maxN;
+	s->local = PrimLocalSize(dev, 256);
+	s->blockLen = 2 * s->local;
+
+	if (PrimBuildProgram(dev, "Scan.cl", type == PRIM_INT ? "-D T_INT" : "-D T_FLOAT",
+				&s->program))
+		return 1;
+
+	// Level l holds one sum per block of level l-1 (of the input for l = 0)
+	cl_uint n = maxN;
+	do
+	{
+		if (s->numLevel == PRIM_SCAN_MAX_LEVEL)
+		{
+			printf("Error: %u elements need too many scan levels\n", maxN);
+			return 1;
+		}
+		n = (n + s->blockLen - 1) / s->blockLen;
+		s->level[s->numLevel] = clCreateBuffer(dev->context, CL_MEM_READ_WRITE,
+				sizeof(cl_float) * (n ? n : 1), NULL, &ret);
+		CHECK_STATUS( ret,"Error: Create block sum Buffer\n");
+		s->numLevel++;
+	} while (n > 1);
+
+	s->block = clCreateKernel(s->program, "Scan_block", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (Scan_block)\n");
+	s->add = clCreateKernel(s->program, "Scan_add", &ret);
+	CHECK_STATUS( ret,"Error: Create kernel. (Scan_add)\n");
+
+	// Both element types are 4 bytes
+	cl_uint pad = s->blockLen + (s->blockLen >> 5);
+	ret = clSetKernelArg(s->block, 5, sizeof(cl_float) * pad, NULL);
+	CHECK_STATUS( ret,"Error: Set kernel arguments (Scan_block)\n");
+
+	return 0;
+}
+
+/* Kernel time of event added to *time (if time is not NULL), event released */
+static void ScanEventTime(cl_event event, double *time)
+{
+	if (time)
+	{
+		*time += PrimEventTime(event);
+		clReleaseEvent(event);
+	}
+}
+
+/*
+ * Scan n elements of in into out at level l: the block sums go to
+ * s->level[l], get an exclusive scan of their own, and are added back.
+ */
+static int ScanLevel(PrimScan *s, PrimDevice *dev, cl_mem in, cl_mem out,
+		cl_uint n, cl_uint inclusive, cl_uint l, double *time)
+{
+	cl_int ret;
+	cl_event event = NULL;
+	cl_uint numBlock = (n + s->blockLen - 1) / s->blockLen;
+
+	ret = clSetKernelArg(s->block, 0, sizeof(cl_mem), (void *)&in);
+	ret |= clSetKernelArg(s->block, 1, sizeof(cl_mem), (void *)&out);
+	ret |= clSetKernelArg(s->block, 2, sizeof(cl_mem), (void *)&s->level[l]);
+	ret |= clSetKernelArg(s->block, 3, sizeof(cl_uint), (void *)&n);
+	ret |= clSetKernelArg(s->block, 4, sizeof(cl_uint), (void *)&inclusive);
+	CHECK_STATUS( ret,"Error: Set scan arguments\n");
+
+	size_t globalThreads[1] = {numBlock * s->local};
+	size_t localThreads[1] = {s->local};
+	ret = clEnqueueNDRangeKernel(dev->queue, s->block, 1, NULL,
+			globalThreads, localThreads, 0, NULL, time ? &event : NULL);
+	CHECK_STATUS( ret,"Error: Range kernel. (Scan_block)\n");
+	ScanEventTime(event, time);
+
+	if (numBlock == 1)
+		return 0;
+
+	if (ScanLevel(s, dev, s->level[l], s->level[l], numBlock, 0, l + 1, time))
+		return 1;
+
+	ret = clSetKernelArg(s->add, 0, sizeof(cl_mem), (void *)&out);
+	ret |= clSetKernelArg(s->add, 1, sizeof(cl_mem), (void *)&s->level[l]);
+	ret |= clSetKernelArg(s->add, 2, sizeof(cl_uint), (void *)&n);
+	CHECK_STATUS( ret,"Error: Set scan add arguments\n");
+	ret = clEnqueueNDRangeKernel(dev->queue, s->add, 1, NULL,
+			globalThreads, localThreads, 0, NULL, time ? &event : NULL);
+	CHECK_STATUS( ret,"Error: Range kernel. (Scan_add)\n");
+	ScanEventTime(event, time);
+
+	return 0;
+}
+
+/*
+ * \brief Queue the scan of the first n (<= maxN) elements of in into out;
+ * out may be in.  Does not wait unless time is not NULL, in which case it
+ * receives the kernel time of every launch in us.
+ */
+int PrimScanEnqueue(PrimScan *s, PrimDevice *dev, cl_mem in, cl_mem out,
+		cl_uint n, int inclusive, double *time)
+{
+	if (time)
+		*time = 0;
+	if (n == 0)
+		return 0;
+	if (n > s->maxN)
+	{
+		printf("Error: scan of %u elements, created for %u\n", n, s->maxN);
+		return 1;
+	}
+	return ScanLevel(s, dev, in, out, n, inclusive != 0, 0, time);
+}
+
+void PrimScanRelease(PrimScan *s)
+{
+	cl_uint l;
+
+	clReleaseKernel(s->add);
+	clReleaseKernel(s->block);
+	for (l = 0; l < s->numLevel; l++)
+		clReleaseMemObject(s->level[l]);
+	clReleaseProgram(s->program);
+}
+
+
+/* Below this many elements per thread cpu_scan stays on one thread */
+#define SCAN_CPU_MIN_CHUNK 65536
+
+typedef struct {
+	PrimType type;
+	int inclusive;
+	const void *in;
+	void *out;
+	size_t count;
+	int pass;                /* 0: total of the chunk, 1: scan from offset */
+	double total;            /* float */
+	uint32_t itotal;         /* int, wrapping like the device */
+	double offset;
+	uint32_t ioffset;
+} ScanChunk;
+
+static void *ScanWorker(void *arg)
+{
+	ScanChunk *c = (ScanChunk *) arg;
+	size_t i;
+
+	if (c->type == PRIM_INT)
+	{
+		const cl_int *in = (const cl_int *) c->in;
+		cl_int *out = (cl_int *) c->out;
+		uint32_t acc = c->pass ? c->ioffset : 0;
+		for (i = 0; i < c->count; i++)
+		{
+			uint32_t x = (uint32_t) in[i];
+			if (c->pass)
+				out[i] = (cl_int) (c->inclusive ? acc + x : acc);
+			acc += x;
+		}
+		c->itotal = acc;
+	}
+	else
+	{
+		const cl_float *in = (const cl_float *) c->in;
+		cl_float *out = (cl_float *) c->out;
+		double acc = c->pass ? c->offset : 0;
+		for (i = 0; i < c->count; i++)
+		{
+			double x = in[i];
+			if (c->pass)
+				out[i] = (cl_float) (c->inclusive ? acc + x : acc);
+			acc += x;
+		}
+		c->total = acc;
+	}
+	return NULL;
+}
+
+/* Run ScanWorker on every chunk, the calling thread taking the first */
+static void ScanRunThreads(ScanChunk *chunk, int numThread)
+{
+	pthread_t *thread = (pthread_t *) malloc(numThread * sizeof(pthread_t));
+	int *started = (int *) calloc(numThread, sizeof(int));
+	int t;
+
+	for (t = 1; t < numThread; t++)
+		started[t] = !pthread_create(&thread[t], NULL, ScanWorker, &chunk[t]);
+	for (t = 0; t < numThread; t++)
+		if (!started[t])
+			ScanWorker(&chunk[t]);
+	for (t = 1; t < numThread; t++)
+		if (started[t])
+			pthread_join(thread[t], NULL);
+	free(thread);
+	free(started);
+}
+
+/*
+ * \brief Reference scan on numThread threads (0: every online CPU): each
+ * thread totals its chunk, the totals are scanned, and each thread scans
+ * its chunk from its offset.  Float is accumulated in double, int wraps
+ * like the device.
+ */
+void cpu_scan(PrimType type, int inclusive, const void *in, void *out,
+		cl_uint n, int numThread)
+{
+	int t;
+
+	if (numThread <= 0)
+		numThread = sysconf(_SC_NPROCESSORS_ONLN);
+	if (numThread <= 0)
+		numThread = 1;
+	if (n / SCAN_CPU_MIN_CHUNK < (cl_uint) numThread)
+		numThread = n / SCAN_CPU_MIN_CHUNK > 0 ? n / SCAN_CPU_MIN_CHUNK : 1;
+
+	ScanChunk *chunk = (ScanChunk *) calloc(numThread, sizeof(ScanChunk));
+	size_t per = ((size_t) n + numThread - 1) / numThread;
+	for (t = 0; t < numThread; t++)
+	{
+		size_t first = t * per < n ? t * per : n;
+		chunk[t].type = type;
+		chunk[t].inclusive = inclusive;
+		chunk[t].in = (const cl_float *) in + first;
+		chunk[t].out = (cl_float *) out + first;
+		chunk[t].count = first + per < n ? per : n - first;
+	}
+
+	// One thread needs no totals pass
+	if (numThread > 1)
+		ScanRunThreads(chunk, numThread);
+	for (t = 1; t < numThread; t++)
+	{
+		chunk[t].offset = chunk[t - 1].offset + chunk[t - 1].total;
+		chunk[t].ioffset = chunk[t - 1].ioffset + chunk[t - 1].itotal;
+	}
+	for (t = 0; t < numThread; t++)
+		chunk[t].pass = 1;
+	ScanRunThreads(chunk, numThread);
+	free(chunk);
+}
+
+/*
+ * \brief Inclusive and exclusive scan of n random elements on the device
+ * and with cpu_scan, compared exactly (int) or within the rounding of the
+ * running sum of magnitudes (float), with the throughput of both.
+ */
+int RunPrimScan(PrimDevice *dev, cl_uint n, PrimType type, int numThread)
+{
+	cl_int ret;
+	cl_uint i;
+	int inclusive, iter;
+	const int numIter = 10;
+	int failed = 0;
+
+	// Both element types are 4 bytes
+	size_t size = sizeof(cl_float) * (n ? n : 1);
+	void *in = malloc(size);
+	void *result = malloc(size);
+	void *ref = malloc(size);
+	for (i = 0; i < n; i++)
+	{
+		if (type == PRIM_INT)
+			((cl_int *) in)[i] = rand() % 16;
+		else
+			((cl_float *) in)[i] = 2.0f * rand() / RAND_MAX - 1.0f;
+	}
+
+	cl_mem inBuffer = clCreateBuffer(dev->context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+			size, in, &ret);
+	CHECK_STATUS( ret,"Error: Create scan input Buffer\n");
+	cl_mem outBuffer = clCreateBuffer(dev->context, CL_MEM_READ_WRITE, size, NULL, &ret);
+	CHECK_STATUS( ret,"Error: Create scan output Buffer\n");
+
+	PrimScan s;
+	if (PrimScanCreate(&s, dev, type, n))
+		return 1;
+	printf("Scan\n Type : %s \n Elements : %u \n Levels : %u\n",
+			PrimTypeName[type], n, s.numLevel);
+
+	for (inclusive = 1; inclusive >= 0; inclusive--)
+	{
+		double time, total = 0;
+		for (iter = 0; iter <= numIter; iter++)
+		{
+			if (PrimScanEnqueue(&s, dev, inBuffer, outBuffer, n, inclusive, &time))
+				return 1;
+			// The first run is a warm-up
+			if (iter)
+				total += time;
+		}
+		if (n)
+		{
+			ret = clEnqueueReadBuffer(dev->queue, outBuffer, CL_TRUE, 0, size,
+					result, 0, NULL, NULL);
+			CHECK_STATUS( ret,"Error: Read scan output\n");
+		}
+
+		cpu_scan(type, inclusive, in, ref, n, numThread);
+		double cpuTime = WallTime();
+		for (iter = 0; iter < numIter; iter++)
+			cpu_scan(type, inclusive, in, ref, n, numThread);
+		cpuTime = (WallTime() - cpuTime) / numIter;
+
+		int bad = 0;
+		if (type == PRIM_INT)
+			bad = memcmp(result, ref, sizeof(cl_int) * n) != 0;
+		else
+		{
+			double scale = 0;
+			for (i = 0; i < n && !bad; i++)
+			{
+				scale += fabs(((cl_float *) in)[i]);
+				float got = ((cl_float *) result)[i];
+				float want = ((cl_float *) ref)[i];
+				if (!(fabs(got - want) <= 1e-5 * scale + 1e-6))
+				{
+					printf("Mismatch at %u: %f (expected %f)\n", i, got, want);
+					bad = 1;
+				}
+			}
+		}
+		failed |= bad;
+
+		fprintf(stderr, "\t%s: device %8.2f us %8.2f Melem/s, CPU %8.2f us %8.2f Melem/s%s\n",
+				inclusive ? "inclusive" : "exclusive", total / numIter,
+				total > 0 ? n / (total / numIter) : 0, cpuTime, n / cpuTime,
+				bad ? "  MISMATCH" : "");
+	}
+	printf(failed ? "Scan Fail\n" : "Scan Successful\n");
+
+	PrimScanRelease(&s);
+	clReleaseMemObject(outBuffer);
+	clReleaseMemObject(inBuffer);
+	free(ref);
+	free(result);
+	free(in);
+	return failed;
+}
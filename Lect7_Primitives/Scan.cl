@@ -0,0 +1,98 @@
+/*
+ * Prefix sum, specialised at build time with -D T_FLOAT | -D T_INT.
+ *
+ * Scan_block scans blocks of 2 * local elements with the work-efficient
+ * up-sweep / down-sweep in local memory and leaves each block's total in
+ * blockSum.  Once the block sums are scanned (exclusively, by the same
+ * kernels one level up), Scan_add adds each block's offset to its
+ * elements.  Work-group sizes are powers of two.
+ */
+
+#ifdef T_INT
+#define T int
+#else
+#define T float
+#endif
+
+/* Padding of the local array, so the sweeps' strided accesses spread over
+   the banks */
+#define LOG_NUM_BANKS 5
+#define PAD(i) ((i) + ((i) >> LOG_NUM_BANKS))
+
+/*
+ * out may be in: each group reads its whole block before writing it.
+ * tmp holds PAD(2 * local) elements.
+ */
+__kernel void Scan_block(__global const T *in,
+                         __global T *out,
+                         __global T *blockSum,
+                         const uint n,
+                         const uint inclusive,
+                         __local T *tmp)
+{
+    uint lid = get_local_id(0);
+    uint m = 2 * get_local_size(0);
+    uint base = get_group_id(0) * m;
+    uint ai = lid;
+    uint bi = lid + get_local_size(0);
+
+    T a = base + ai < n ? in[base + ai] : 0;
+    T b = base + bi < n ? in[base + bi] : 0;
+    tmp[PAD(ai)] = a;
+    tmp[PAD(bi)] = b;
+
+    // Up-sweep: each level adds pairs offset apart, the total ends in m-1
+    uint offset = 1;
+    for (uint d = m >> 1; d > 0; d >>= 1)
+    {
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if (lid < d)
+        {
+            uint i = offset * (2 * lid + 1) - 1;
+            uint j = offset * (2 * lid + 2) - 1;
+            tmp[PAD(j)] += tmp[PAD(i)];
+        }
+        offset *= 2;
+    }
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+    if (lid == 0)
+    {
+        blockSum[get_group_id(0)] = tmp[PAD(m - 1)];
+        tmp[PAD(m - 1)] = 0;
+    }
+
+    // Down-sweep: pass each prefix to the right child, left sum added
+    for (uint d = 1; d < m; d *= 2)
+    {
+        offset >>= 1;
+        barrier(CLK_LOCAL_MEM_FENCE);
+        if (lid < d)
+        {
+            uint i = offset * (2 * lid + 1) - 1;
+            uint j = offset * (2 * lid + 2) - 1;
+            T t = tmp[PAD(i)];
+            tmp[PAD(i)] = tmp[PAD(j)];
+            tmp[PAD(j)] += t;
+        }
+    }
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if (base + ai < n)
+        out[base + ai] = inclusive ? tmp[PAD(ai)] + a : tmp[PAD(ai)];
+    if (base + bi < n)
+        out[base + bi] = inclusive ? tmp[PAD(bi)] + b : tmp[PAD(bi)];
+}
+
+__kernel void Scan_add(__global T *out,
+                       __global const T *blockOffset,
+                       const uint n)
+{
+    uint i = get_group_id(0) * 2 * get_local_size(0) + get_local_id(0);
+    T offset = blockOffset[get_group_id(0)];
+
+    if (i < n)
+        out[i] += offset;
+    if (i + get_local_size(0) < n)
+        out[i + get_local_size(0)] += offset;
+}